@@ -1,5 +1,8 @@
 gcc client.c NSC.c -lws2_32 -o client
 gcc server.c NSC.c -lws2_32 -o server
+gcc echoServer.c NSC.c -lws2_32 -o echoServer
+gcc replay.c NSC.c -lws2_32 -o replay
+gcc reliableTest.c NSC.c -lws2_32 -o reliableTest
 
 start "Server" server.exe
 timeout 1
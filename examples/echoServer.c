@@ -0,0 +1,71 @@
+#include "NSC.h"
+
+/*
+Name : Echo Server
+This server sends every message it receives back to its sender, in TCP or UDP, over IPv4, IPv6 or a UNIX domain socket.
+It is the target of the load generator (loadgen.c) but can be used with any NSC client.
+Usage : echoServer [tcp|udp] [4|6|unix] [port] [capture] (unix : listens on /tmp/nsc-echo.sock, tcp for a stream socket, udp for a datagram one)
+With a capture file, the received traffic is recorded in it, to be replayed by replay.c.
+To accept thousands of connections, compile it (with NSC.c) using -DMaxClients=<n> and raise the file descriptors limit (ulimit -n).
+*/
+
+#include <signal.h>
+
+static volatile sig_atomic_t running = 1;
+
+// Ctrl+C stops the server cleanly (the capture file is completed by closeServer)
+static void stopServer(int signal) {
+    (void)signal;
+    running = 0;
+}
+
+int main(int argc, char** argv) {
+    #if defined (_WIN32)
+        startup();
+    #endif
+
+    // Server's Configuration (must match the clients)
+    int usedConnType = (argc > 1 && !strcmp(argv[1], "udp")) ? UDP : TCP;
+    int usedIpType = (argc > 2 && !strcmp(argv[2], "6")) ? IPv6 : (argc > 2 && !strcmp(argv[2], "unix")) ? UNIX : IPv4;
+    int port = (argc > 3) ? atoi(argv[3]) : 25565;
+    const char* address = usedIpType == IPv4 ? "127.0.0.1" : (usedIpType == IPv6) ? "::1" : "/tmp/nsc-echo.sock";
+
+    // Create the server
+    Server* server = createServer(address, port, usedConnType, usedIpType);
+    if (server == NULL) {
+        printf("Error creating the server\n");
+        return 1;
+    }
+    printf("Echo server listening on %s port %d (%s, max %d clients)\n", address, port, usedConnType == TCP ? "TCP" : "UDP", MaxClients);
+    if (argc > 4) {
+        if (usedConnType == UDP) enableUdpSessions(server, 10000); // The datagrams of each peer are replayed by one client
+        if (nscRecordStart(server, argv[4], 0) != 0) {
+            printf("Error creating the capture file %s\n", argv[4]);
+            return 1;
+        }
+        printf("Recording the traffic in %s\n", argv[4]);
+    }
+
+    signal(SIGINT, stopServer);
+    while (running) {
+        ServerEventsList* events = serverListen(server);
+        for (int i = 0; i < events->numEvents; i++) {
+            ServerEvent* event = &events->events[i];
+            if (event->type == DataReceived) {
+                // Echo the data back to its sender, after what its connection already has queued (UDP without sessions : no connection)
+                Client* connection = getConnection(server, event->connId);
+                if (connection != NULL) sendClientMessage(connection, event->data, event->dataSize);
+                else if (usedConnType == UDP) sendMessage(&event->socket, event->data, event->dataSize, usedConnType, usedIpType, &event->sin);
+            }
+        }
+        nscFreeServerEvents(events); // Frees the received data too
+    }
+
+    closeServer(server);
+
+    #if defined (_WIN32)
+        cleanup();
+    #endif
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include "NSC.h"
+
+/*
+Name : Same-Host Transports Benchmark
+This tool compares the transports NSC offers between two processes of the same machine :
+loopback TCP, UNIX domain socket, and shared-memory rings (woken by doorbells, or pure spin).
+It forks an echo server, then measures :
+    - the latency : one message at a time (ping-pong), one-way latency = round trip / 2, in percentiles
+    - the throughput : messages streamed back to back while the echoes are read, in messages and MB per second
+Both processes use the same NSC calls (serverListen / sendClientMessage, clientListen), only the options change.
+Linux only (fork, UNIX domain sockets, memfd).
+
+Usage : ipcBench [tcp|unix|shm|spin] [messages] [size]
+    tcp  : loopback TCP (TCP_NODELAY)
+    unix : UNIX domain stream socket
+    shm  : shared-memory rings, the sleeping side is woken by a doorbell on the UNIX socket
+    spin : shared-memory rings, both sides spin (pure spin mode, two busy cores)
+    messages : number of messages of each measurement (default : 100000)
+    size     : size of the messages in bytes (default : 64)
+
+Example :
+    gcc ipcBench.c NSC.c -o ipcBench && for t in tcp unix shm spin; do ./ipcBench $t; done
+*/
+
+#include <sys/wait.h>
+#include <signal.h>
+
+#define BENCH_PORT 25570
+#define BENCH_PATH "/tmp/nsc-bench.sock"
+#define WINDOW 64 // Messages in flight during the throughput measurement
+
+static int compareLatencies(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Echo server, run by the child process until it is killed
+static void runServer(int ipType, const NSC_Options* options) {
+    Server* server = createServerEx(ipType == UNIX ? BENCH_PATH : "127.0.0.1", BENCH_PORT, TCP, ipType, options);
+    if (server == NULL) exit(1);
+    while (1) {
+        ServerEventsList* events = serverListen(server);
+        for (int i = 0; i < events->numEvents; i++) {
+            ServerEvent* event = &events->events[i];
+            if (event->type == DataReceived) {
+                Client* connection = getConnection(server, event->connId);
+                if (connection != NULL) sendClientMessage(connection, event->data, event->dataSize);
+            }
+        }
+        nscFreeServerEvents(events);
+    }
+}
+
+// Read the client's events, returns the number of messages received (-1 if disconnected)
+static int receive(Client* client) {
+    int received = 0;
+    ClientEventsList* events = clientListen(client);
+    for (int i = 0; i < events->numEvents; i++) {
+        if (events->events[i].type == DataReceived) {
+            received++;
+        }
+        else if (events->events[i].type == Disconnection) {
+            received = -1;
+        }
+    }
+    nscFreeClientEvents(events);
+    return received;
+}
+
+int main(int argc, char** argv) {
+    const char* transport = (argc > 1) ? argv[1] : "shm";
+    int numMessages = (argc > 2) ? atoi(argv[2]) : 100000;
+    int size = (argc > 3) ? atoi(argv[3]) : 64;
+    if (numMessages <= 0 || size <= 0 || size > BufferSize - 4) {
+        fprintf(stderr, "Usage : %s [tcp|unix|shm|spin] [messages] [size (1 to %d)]\n", argv[0], BufferSize - 4);
+        return 1;
+    }
+
+    NSC_Options options;
+    memset(&options, 0, sizeof(options));
+    int ipType = UNIX;
+    if (!strcmp(transport, "tcp")) {
+        ipType = IPv4;
+        options.noDelay = 1;
+        options.reuseAddress = 1;
+    }
+    else if (!strcmp(transport, "shm")) {
+        options.sharedMemory = 1 << 20;
+        options.ringSpin = 50; // Spin 50 us before sleeping
+    }
+    else if (!strcmp(transport, "spin")) {
+        options.sharedMemory = 1 << 20;
+        options.ringSpin = -1;
+    }
+    else if (strcmp(transport, "unix") != 0) {
+        fprintf(stderr, "Unknown transport : %s\n", transport);
+        return 1;
+    }
+
+    pid_t server = fork();
+    if (server == 0) {
+        runServer(ipType, &options);
+        return 0;
+    }
+
+    // Wait for the server to listen
+    Client* client = NULL;
+    for (int attempt = 0; attempt < 100 && client == NULL; attempt++) {
+        usleep(10000);
+        client = createClientEx(ipType == UNIX ? BENCH_PATH : "127.0.0.1", BENCH_PORT, TCP, ipType, &options);
+    }
+    if (client == NULL) {
+        kill(server, SIGTERM);
+        return 1;
+    }
+
+    char* message = (char*)calloc(1, size);
+    uint64_t* latencies = (uint64_t*)malloc(sizeof(uint64_t) * numMessages);
+
+    // Latency : one message in flight (the first tenth warms up)
+    int warmup = numMessages / 10;
+    for (int i = -warmup; i < numMessages; i++) {
+        uint64_t start = nscMonotonicNs();
+        sendClientMessage(client, message, size);
+        int received = 0;
+        while (received == 0) received = receive(client);
+        if (received < 0) break;
+        if (i >= 0) latencies[i] = (nscMonotonicNs() - start) / 2;
+    }
+    qsort(latencies, numMessages, sizeof(uint64_t), compareLatencies);
+    printf("%-5s one-way latency (ns, %d bytes) : p50 %llu | p90 %llu | p99 %llu | p99.9 %llu | max %llu\n", transport, size,
+           (unsigned long long)latencies[numMessages / 2], (unsigned long long)latencies[(int)(numMessages * 0.9)],
+           (unsigned long long)latencies[(int)(numMessages * 0.99)], (unsigned long long)latencies[(int)(numMessages * 0.999)],
+           (unsigned long long)latencies[numMessages - 1]);
+
+    // Throughput : a window of messages in flight
+    uint64_t start = nscMonotonicNs();
+    int sent = 0;
+    int received = 0;
+    while (received < numMessages) {
+        while (sent < numMessages && sent - received < WINDOW) {
+            sendClientMessage(client, message, size);
+            sent++;
+        }
+        int count = receive(client);
+        if (count < 0) break;
+        received += count;
+    }
+    double seconds = (nscMonotonicNs() - start) / 1e9;
+    printf("%-5s throughput (echoed) : %.0f msg/s, %.1f MB/s\n", transport, received / seconds, received * (double)size / seconds / 1e6);
+
+    closeClient(client);
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    free(message);
+    free(latencies);
+    return 0;
+}
@@ -3,3 +3,12 @@
 gcc server.c NSC.c -o server -lpthread
 gcc client.c NSC.c -o client -lpthread
 
+
+# Load testing tools (see echoServer.c, loadgen.c, replay.c and ipcBench.c)
+gcc echoServer.c NSC.c -o echoServer -DMaxClients=20000
+gcc loadgen.c NSC.c -o loadgen -lm
+gcc replay.c NSC.c -o replay
+gcc ipcBench.c NSC.c -o ipcBench
+
+# Reliable UDP on loopback with artificial loss (see reliableTest.c)
+gcc reliableTest.c NSC.c -o reliableTest
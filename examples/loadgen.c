@@ -0,0 +1,424 @@
+#define _GNU_SOURCE
+#include "NSC.h"
+
+/*
+Name : Load Generator
+This tool measures end-to-end throughput and round-trip latency against an NSC echo server (echoServer.c).
+It opens many TCP or UDP, IPv4, IPv6 or UNIX domain socket connections with createClient and drives them with sendMessage.
+Messages are sent open-loop : every message has an intended send time taken from a fixed schedule (Poisson or constant rate),
+and its latency is measured from that intended time, so a stalled server is not hidden by a stalled sender (no coordinated omission).
+Round-trip latencies are recorded in an HDR-style (log-linear) histogram and printed as percentiles and as a .hgrm distribution.
+Linux only (epoll).
+
+Usage : loadgen [options]
+    -a address   : Server's address (default : 127.0.0.1, or ::1 with -6)
+    -p port      : Server's port (default : 25565)
+    -u           : Use UDP instead of TCP
+    -6           : Use IPv6 instead of IPv4
+    -x           : Use a UNIX domain socket (the address is the socket's path, default : /tmp/nsc-echo.sock)
+    -c count     : Number of connections (default : 100)
+    -r rate      : Total message rate in messages per second (default : 10000)
+    -d seconds   : Duration of the measurement (default : 10)
+    -w seconds   : Warm-up duration, not measured (default : 2)
+    -m sizes     : Message size distribution (default : 64)
+                   "N" fixed size, "A-B" uniform between A and B, "S1:W1,S2:W2,..." weighted sizes
+    -f           : Send at a fixed interval instead of Poisson arrivals
+    -o file      : Write the percentile distribution (.hgrm) to a file instead of stdout
+
+Example (one Linux box) :
+    gcc echoServer.c NSC.c -DMaxClients=20000 -o echoServer && ulimit -n 65536 && ./echoServer tcp 4 &
+    gcc loadgen.c NSC.c -lm -o loadgen && ./loadgen -c 5000 -r 200000 -m 64:90,1024:9,4096:1
+
+Same-host transports compared (same load, loopback TCP then UNIX domain socket) :
+    ./echoServer tcp 4 & ./loadgen -c 50 -r 100000 -d 10
+    ./echoServer tcp unix & ./loadgen -x -c 50 -r 100000 -d 10
+*/
+
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <getopt.h>
+
+#define LOADGEN_MAGIC 0x4E534C47 // "NSLG"
+#define HEADER_SIZE 24 // magic (4) + connection (4) + sequence (8) + intended send time (8)
+#define MAX_SIZES 32
+#define MAX_BURST 1024 // Maximum number of sends before the replies are processed again
+#define DRAIN_TIME_NS 2000000000ULL // Time given to the last replies once the sending stopped
+
+// HDR-style histogram : values below 2^SUB_BITS are exact,
+// above that each power of two is split in 2^SUB_BITS linear sub-buckets (< 1% relative error)
+#define SUB_BITS 7
+#define SUB_COUNT (1 << SUB_BITS)
+#define BUCKET_COUNT ((64 - SUB_BITS + 1) * SUB_COUNT)
+
+typedef struct {
+    uint64_t counts[BUCKET_COUNT];
+    uint64_t totalCount;
+    uint64_t maxValue;
+    double sum;
+    double sumSquares;
+} Histogram;
+
+typedef struct {
+    int sizes[MAX_SIZES];
+    double cumulativeWeights[MAX_SIZES];
+    int numSizes;
+    int uniform; // 1 if sizes[0]-sizes[1] is a uniform range
+} SizeDistribution;
+
+static uint64_t rngState = 0x9E3779B97F4A7C15ULL;
+
+// xorshift64* generator
+static uint64_t nextRandom() {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 2685821657736338717ULL;
+}
+
+// Uniform double in ]0, 1]
+static double nextUniform() {
+    return ((nextRandom() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bucketIndex(uint64_t value) {
+    if (value < SUB_COUNT) return (int)value;
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - SUB_BITS;
+    return ((shift + 1) << SUB_BITS) + (int)((value >> shift) - SUB_COUNT);
+}
+
+// Highest value that falls in the given bucket
+static uint64_t bucketHighestValue(int index) {
+    if (index < SUB_COUNT) return index;
+    int shift = (index >> SUB_BITS) - 1;
+    uint64_t lowest = (uint64_t)(SUB_COUNT + (index & (SUB_COUNT - 1))) << shift;
+    return lowest + ((1ULL << shift) - 1);
+}
+
+static void recordValue(Histogram* histogram, uint64_t value) {
+    histogram->counts[bucketIndex(value)]++;
+    histogram->totalCount++;
+    if (value > histogram->maxValue) histogram->maxValue = value;
+    histogram->sum += (double)value;
+    histogram->sumSquares += (double)value * (double)value;
+}
+
+static uint64_t valueAtPercentile(const Histogram* histogram, double percentile) {
+    if (histogram->totalCount == 0) return 0;
+    uint64_t target = (uint64_t)ceil(percentile / 100.0 * histogram->totalCount);
+    if (target == 0) target = 1;
+    uint64_t cumulative = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        cumulative += histogram->counts[i];
+        if (cumulative >= target) {
+            uint64_t value = bucketHighestValue(i);
+            return value < histogram->maxValue ? value : histogram->maxValue;
+        }
+    }
+    return histogram->maxValue;
+}
+
+// Print the percentile distribution in the HdrHistogram's .hgrm format (values in microseconds)
+static void printDistribution(FILE* out, const Histogram* histogram) {
+    fprintf(out, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+    if (histogram->totalCount == 0) return;
+
+    uint64_t cumulative = 0;
+    int index = 0;
+    // 5 reporting ticks per half distance : 0%, 10%, ..., 50%, 55%, ..., 75%, 77.5%, ...
+    for (int half = 0; half < 64; half++) {
+        double start = 1.0 - pow(0.5, half);
+        double step = pow(0.5, half + 1) / 5.0;
+        for (int tick = 0; tick < 5; tick++) {
+            double percentile = start + step * tick;
+            uint64_t target = (uint64_t)ceil(percentile * histogram->totalCount);
+            if (target == 0) target = 1;
+            while (index < BUCKET_COUNT && cumulative + histogram->counts[index] < target) {
+                cumulative += histogram->counts[index];
+                index++;
+            }
+            if (index >= BUCKET_COUNT || target >= histogram->totalCount) {
+                half = 64;
+                break;
+            }
+            uint64_t value = bucketHighestValue(index);
+            if (value > histogram->maxValue) value = histogram->maxValue;
+            fprintf(out, "%12.3f %14.12f %10llu %14.2f\n", value / 1000.0, percentile,
+                (unsigned long long)(cumulative + histogram->counts[index]), 1.0 / (1.0 - percentile));
+        }
+    }
+    fprintf(out, "%12.3f %14.12f %10llu\n", histogram->maxValue / 1000.0, 1.0, (unsigned long long)histogram->totalCount);
+
+    double mean = histogram->sum / histogram->totalCount;
+    double variance = histogram->sumSquares / histogram->totalCount - mean * mean;
+    fprintf(out, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean / 1000.0, sqrt(variance > 0 ? variance : 0) / 1000.0);
+    fprintf(out, "#[Max     = %12.3f, Total count    = %12llu]\n", histogram->maxValue / 1000.0, (unsigned long long)histogram->totalCount);
+    fprintf(out, "#[Buckets = %12d, SubBuckets     = %12d]\n", 64 - SUB_BITS + 1, SUB_COUNT);
+}
+
+// Parse "N", "A-B" or "S1:W1,S2:W2,..."
+static int parseSizes(const char* spec, SizeDistribution* distribution) {
+    distribution->numSizes = 0;
+    distribution->uniform = 0;
+    if (strchr(spec, '-')) {
+        if (sscanf(spec, "%d-%d", &distribution->sizes[0], &distribution->sizes[1]) != 2) return -1;
+        if (distribution->sizes[1] < distribution->sizes[0]) return -1;
+        distribution->uniform = 1;
+        distribution->numSizes = 2;
+        return 0;
+    }
+
+    double totalWeight = 0;
+    const char* cursor = spec;
+    while (*cursor && distribution->numSizes < MAX_SIZES) {
+        int size = 0;
+        double weight = 1;
+        int consumed = 0;
+        if (sscanf(cursor, "%d%n", &size, &consumed) != 1) return -1;
+        cursor += consumed;
+        if (*cursor == ':') {
+            cursor++;
+            if (sscanf(cursor, "%lf%n", &weight, &consumed) != 1) return -1;
+            cursor += consumed;
+        }
+        totalWeight += weight;
+        distribution->sizes[distribution->numSizes] = size;
+        distribution->cumulativeWeights[distribution->numSizes] = totalWeight;
+        distribution->numSizes++;
+        if (*cursor == ',') cursor++;
+    }
+    if (distribution->numSizes == 0 || totalWeight <= 0) return -1;
+    for (int i = 0; i < distribution->numSizes; i++) {
+        distribution->cumulativeWeights[i] /= totalWeight;
+    }
+    return 0;
+}
+
+static int nextSize(const SizeDistribution* distribution) {
+    if (distribution->uniform) {
+        int range = distribution->sizes[1] - distribution->sizes[0] + 1;
+        return distribution->sizes[0] + (int)(nextRandom() % range);
+    }
+    double draw = nextUniform();
+    for (int i = 0; i < distribution->numSizes - 1; i++) {
+        if (draw <= distribution->cumulativeWeights[i]) return distribution->sizes[i];
+    }
+    return distribution->sizes[distribution->numSizes - 1];
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage : %s [-a address] [-p port] [-u] [-6] [-x] [-c connections] [-r rate] [-d seconds] [-w seconds] [-m sizes] [-f] [-o file]\n", name);
+}
+
+int main(int argc, char** argv) {
+    const char* address = NULL;
+    int port = 25565;
+    int connType = TCP;
+    int ipType = IPv4;
+    int numConnections = 100;
+    double rate = 10000;
+    double duration = 10;
+    double warmup = 2;
+    const char* sizeSpec = "64";
+    int fixedInterval = 0;
+    const char* outputPath = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "a:p:u6xc:r:d:w:m:fo:h")) != -1) {
+        switch (option) {
+            case 'a': address = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'u': connType = UDP; break;
+            case '6': ipType = IPv6; break;
+            case 'x': ipType = UNIX; break;
+            case 'c': numConnections = atoi(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'd': duration = atof(optarg); break;
+            case 'w': warmup = atof(optarg); break;
+            case 'm': sizeSpec = optarg; break;
+            case 'f': fixedInterval = 1; break;
+            case 'o': outputPath = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (address == NULL) address = (ipType == IPv4) ? "127.0.0.1" : (ipType == IPv6) ? "::1" : "/tmp/nsc-echo.sock";
+    if (numConnections <= 0 || rate <= 0 || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    SizeDistribution sizes;
+    if (parseSizes(sizeSpec, &sizes) != 0) {
+        fprintf(stderr, "Invalid size distribution : %s\n", sizeSpec);
+        return 1;
+    }
+    // Messages carry a 24 bytes header and must fit in the receiver's buffer
+    int maxSize = (connType == TCP) ? BufferSize - 4 : BufferSize - 1;
+    for (int i = 0; i < sizes.numSizes; i++) {
+        if (sizes.sizes[i] < HEADER_SIZE) sizes.sizes[i] = HEADER_SIZE;
+        if (sizes.sizes[i] > maxSize) sizes.sizes[i] = maxSize;
+    }
+
+    // Thousands of connections need thousands of file descriptors
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    int epoll = epoll_create1(0);
+    if (epoll < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+
+    Client** clients = (Client**)calloc(numConnections, sizeof(Client*));
+    for (int i = 0; i < numConnections; i++) {
+        clients[i] = createClient(address, port, connType, ipType);
+        if (clients[i] == NULL) {
+            fprintf(stderr, "Connection %d failed, is the echo server running (and allowed to accept %d clients) ?\n", i, numConnections);
+            return 1;
+        }
+        struct epoll_event registration;
+        registration.events = EPOLLIN;
+        registration.data.u32 = i;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, clients[i]->socket, &registration);
+    }
+    printf("%d %s/%s connections opened to %s:%d\n", numConnections, connType == TCP ? "TCP" : "UDP", ipType == IPv4 ? "IPv4" : (ipType == IPv6) ? "IPv6" : "UNIX", address, port);
+    printf("Rate : %.0f msg/s (%s), sizes : %s, warm-up : %.1f s, duration : %.1f s\n", rate, fixedInterval ? "fixed interval" : "Poisson", sizeSpec, warmup, duration);
+
+    Histogram* histogram = (Histogram*)calloc(1, sizeof(Histogram));
+    char* message = (char*)calloc(1, BufferSize);
+    char* datagram = (char*)malloc(BufferSize);
+    struct epoll_event readyEvents[256];
+
+    uint64_t meanInterval = (uint64_t)(1e9 / rate);
+    uint64_t startNs = nowNs();
+    uint64_t measureStartNs = startNs + (uint64_t)(warmup * 1e9);
+    uint64_t endNs = measureStartNs + (uint64_t)(duration * 1e9);
+    uint64_t nextSendNs = startNs;
+    uint64_t sequence = 0;
+    uint64_t sent = 0, measuredSent = 0, received = 0, measuredReceived = 0, measuredBytes = 0, invalid = 0;
+    int nextConnection = 0;
+
+    while (1) {
+        uint64_t now = nowNs();
+        int sending = now < endNs;
+        if (!sending && (received >= sent || now >= endNs + DRAIN_TIME_NS)) break;
+
+        // Send every message whose intended time has come (open loop)
+        int burst = 0;
+        while (sending && nextSendNs <= now && burst < MAX_BURST) {
+            int size = nextSize(&sizes);
+            uint32_t magic = LOADGEN_MAGIC;
+            uint32_t connection = nextConnection;
+            memcpy(message, &magic, 4);
+            memcpy(message + 4, &connection, 4);
+            memcpy(message + 8, &sequence, 8);
+            memcpy(message + 16, &nextSendNs, 8);
+
+            Client* client = clients[connection];
+            sendMessage(&client->socket, message, size, connType, ipType, &client->sin);
+
+            sent++;
+            sequence++;
+            if (nextSendNs >= measureStartNs) measuredSent++;
+            nextConnection = (nextConnection + 1) % numConnections;
+            nextSendNs += fixedInterval ? meanInterval : (uint64_t)(-log(nextUniform()) * meanInterval);
+            burst++;
+        }
+
+        // Wait for the replies until the next intended send time
+        int timeout = 10;
+        if (sending) {
+            now = nowNs();
+            timeout = (nextSendNs > now) ? (int)((nextSendNs - now) / 1000000) : 0;
+        }
+        int numReady = epoll_wait(epoll, readyEvents, 256, timeout);
+
+        for (int i = 0; i < numReady; i++) {
+            Client* client = clients[readyEvents[i].data.u32];
+            while (1) {
+                char* reply = NULL;
+                int length;
+                if (connType == TCP) {
+                    length = readMessage(client, &reply);
+                }
+                else {
+                    length = recv(client->socket, datagram, BufferSize, 0);
+                    reply = datagram;
+                }
+                if (length <= 0) {
+                    if (connType == TCP) free(reply);
+                    if (length == READMSG_CONN_CLOSED || length == READMSG_SOCKET_ERROR) {
+                        if (connType == TCP) {
+                            fprintf(stderr, "Connection %u closed by the server\n", readyEvents[i].data.u32);
+                            epoll_ctl(epoll, EPOLL_CTL_DEL, client->socket, NULL);
+                        }
+                    }
+                    break;
+                }
+
+                uint64_t receivedNs = nowNs();
+                uint32_t magic = 0;
+                uint64_t intendedNs = 0;
+                if (length >= HEADER_SIZE) {
+                    memcpy(&magic, reply, 4);
+                    memcpy(&intendedNs, reply + 16, 8);
+                }
+                if (magic != LOADGEN_MAGIC) {
+                    invalid++; // Too short to hold the header, or not an echo
+                }
+                else {
+                    received++;
+                    if (intendedNs >= measureStartNs && intendedNs < endNs) {
+                        recordValue(histogram, receivedNs - intendedNs);
+                        measuredReceived++;
+                        measuredBytes += length;
+                    }
+                }
+                if (connType == TCP) free(reply);
+            }
+        }
+    }
+
+    // Report
+    printf("\nSent : %llu, received : %llu, lost : %llu, invalid : %llu\n",
+        (unsigned long long)sent, (unsigned long long)received,
+        (unsigned long long)(sent > received ? sent - received : 0), (unsigned long long)invalid);
+    printf("Measured : %llu sent, %llu received\n", (unsigned long long)measuredSent, (unsigned long long)measuredReceived);
+    printf("Throughput : %.0f msg/s, %.2f MB/s (echoed payload)\n", measuredReceived / duration, measuredBytes / duration / 1e6);
+    printf("Round-trip latency (us) : p50 %.1f | p90 %.1f | p99 %.1f | p99.9 %.1f | p99.99 %.1f | max %.1f\n\n",
+        valueAtPercentile(histogram, 50) / 1000.0, valueAtPercentile(histogram, 90) / 1000.0,
+        valueAtPercentile(histogram, 99) / 1000.0, valueAtPercentile(histogram, 99.9) / 1000.0,
+        valueAtPercentile(histogram, 99.99) / 1000.0, histogram->maxValue / 1000.0);
+
+    FILE* output = stdout;
+    if (outputPath != NULL) {
+        output = fopen(outputPath, "w");
+        if (output == NULL) {
+            perror(outputPath);
+            output = stdout;
+        }
+    }
+    printDistribution(output, histogram);
+    if (output != stdout) fclose(output);
+
+    for (int i = 0; i < numConnections; i++) {
+        closeClient(clients[i]);
+    }
+    free(clients);
+    free(histogram);
+    free(message);
+    free(datagram);
+    close(epoll);
+
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include "NSC.h"
+
+/*
+Name : Reliable UDP Loopback Test
+This tool drives reliable UDP on loopback with artificial loss : a server and a client of the same process
+exchange messages on three channels, one of each type, while both ends drop a percentage of their datagrams
+on purpose (NSC_ReliableOptions.lossPercent). Every tenth message is larger than the MTU, to be fragmented.
+The server checks the messages it receives and echoes them on their channel, the client checks the echoes :
+    - reliable ordered : every message, once, in the order it was sent
+    - reliable unordered : every message, once, in any order
+    - unreliable sequenced : never a message older than the last one delivered, never one twice
+The content of each message is checked too. The exit status is 0 if every check passed.
+
+Usage : reliableTest [loss] [messages] [size]
+    loss     : percentage of the datagrams dropped on purpose by each end (default : 10)
+    messages : number of messages sent on each channel (default : 2000)
+    size     : size of the small messages in bytes (default : 64, the large ones are 6000 bytes)
+
+Example :
+    gcc reliableTest.c NSC.c -o reliableTest && ./reliableTest 20
+*/
+
+#define TEST_PORT 25575
+#define LARGE_SIZE 6000 // Fragmented with the default MTU (1200)
+#define WINDOW 256 // Messages in flight on each channel
+#define TIMEOUT_NS 60000000000ULL // The test gives up after a minute
+
+enum { Ordered, Unordered, Sequenced, NumChannels };
+static const char* channelNames[NumChannels] = { "reliable ordered", "reliable unordered", "unreliable sequenced" };
+
+// Checks of the messages received on each channel, by one end
+typedef struct {
+    int received; // Messages received
+    int next; // Next message expected (ordered), or the one after the last received (sequenced)
+    int errors; // Messages out of order, duplicated, unknown or corrupted
+    uint8_t* seen; // 1 for each message received
+} ChannelCheck;
+
+// Size of a message : every tenth one is fragmented
+static uint32_t messageSize(int number, uint32_t size) {
+    return (number % 10 == 9) ? LARGE_SIZE : size;
+}
+
+// Build a message : its number, then bytes derived from it
+static void buildMessage(char* message, int number, int channel, uint32_t len) {
+    uint32_t value = htonl((uint32_t)number);
+    memcpy(message, &value, 4);
+    for (uint32_t i = 4; i < len; i++) message[i] = (char)(number * 31 + channel * 7 + i);
+}
+
+// Check a message received on a channel, counting it
+static void checkMessage(ChannelCheck* check, int channel, const char* data, uint32_t len, int numMessages, uint32_t size) {
+    uint32_t value;
+    if (len < 4) {
+        check->errors++;
+        return;
+    }
+    memcpy(&value, data, 4);
+    int number = (int)ntohl(value);
+    if (number < 0 || number >= numMessages || len != messageSize(number, size)) {
+        check->errors++;
+        return;
+    }
+    for (uint32_t i = 4; i < len; i++) {
+        if (data[i] != (char)(number * 31 + channel * 7 + i)) {
+            check->errors++;
+            return;
+        }
+    }
+    if (check->seen[number]) check->errors++; // Duplicate
+    check->seen[number] = 1;
+    check->received++;
+    if (channel == Ordered) {
+        if (number != check->next) check->errors++;
+        check->next = number + 1;
+    }
+    else if (channel == Sequenced) {
+        if (number < check->next) check->errors++;
+        check->next = number + 1;
+    }
+}
+
+int main(int argc, char** argv) {
+    int loss = (argc > 1) ? atoi(argv[1]) : 10;
+    int numMessages = (argc > 2) ? atoi(argv[2]) : 2000;
+    uint32_t size = (argc > 3) ? (uint32_t)atoi(argv[3]) : 64;
+    if (loss < 0 || loss >= 100 || numMessages <= 0 || size < 4 || size > BufferSize - 1) {
+        fprintf(stderr, "Usage : %s [loss (0 to 99)] [messages] [size (4 to %d)]\n", argv[0], BufferSize - 1);
+        return 1;
+    }
+    #if defined (_WIN32)
+        startup();
+    #endif
+
+    NSC_ReliableOptions reliable;
+    memset(&reliable, 0, sizeof(reliable));
+    reliable.numChannels = NumChannels;
+    reliable.channelTypes[Ordered] = ChannelReliableOrdered;
+    reliable.channelTypes[Unordered] = ChannelReliableUnordered;
+    reliable.channelTypes[Sequenced] = ChannelUnreliableSequenced;
+    reliable.lossPercent = (uint32_t)loss;
+
+    NSC_Options options;
+    memset(&options, 0, sizeof(options));
+    options.reuseAddress = 1;
+    options.pollTimeout = -1; // Both ends are polled in turn by this loop
+    Server* server = createServerEx("127.0.0.1", TEST_PORT, UDP, IPv4, &options);
+    if (server == NULL || enableServerReliable(server, &reliable) != 0) return 1;
+    Client* client = createClientEx("127.0.0.1", TEST_PORT, UDP, IPv4, &options);
+    if (client == NULL || enableClientReliable(client, &reliable) != 0) return 1;
+
+    ChannelCheck serverChecks[NumChannels];
+    ChannelCheck clientChecks[NumChannels];
+    for (int channel = 0; channel < NumChannels; channel++) {
+        memset(&serverChecks[channel], 0, sizeof(ChannelCheck));
+        memset(&clientChecks[channel], 0, sizeof(ChannelCheck));
+        serverChecks[channel].seen = (uint8_t*)calloc(numMessages, 1);
+        clientChecks[channel].seen = (uint8_t*)calloc(numMessages, 1);
+    }
+    char* message = (char*)malloc(LARGE_SIZE);
+    int sent = 0;
+    int disconnected = 0;
+
+    uint64_t start = nscMonotonicNs();
+    while (!disconnected && nscMonotonicNs() - start < TIMEOUT_NS) {
+        // Send the next messages on every channel while the reliable ones have room in the window
+        while (sent < numMessages && sent - clientChecks[Ordered].received < WINDOW && sent - clientChecks[Unordered].received < WINDOW) {
+            for (int channel = 0; channel < NumChannels; channel++) {
+                uint32_t len = messageSize(sent, size);
+                buildMessage(message, sent, channel, len);
+                sendChannelMessage(client, channel, message, len);
+            }
+            sent++;
+        }
+
+        // The server checks and echoes
+        ServerEventsList* serverEvents = serverListen(server);
+        for (int i = 0; i < serverEvents->numEvents; i++) {
+            ServerEvent* event = &serverEvents->events[i];
+            if (event->type == Disconnection) disconnected = 1;
+            if (event->type != DataReceived || event->channel < 0 || event->channel >= NumChannels) continue;
+            checkMessage(&serverChecks[event->channel], event->channel, event->data, event->dataSize, numMessages, size);
+            Client* session = getConnection(server, event->connId);
+            if (session != NULL) sendChannelMessage(session, event->channel, event->data, event->dataSize);
+        }
+        nscFreeServerEvents(serverEvents);
+
+        // The client checks the echoes
+        ClientEventsList* clientEvents = clientListen(client);
+        for (int i = 0; i < clientEvents->numEvents; i++) {
+            ClientEvent* event = &clientEvents->events[i];
+            if (event->type == Disconnection) disconnected = 1;
+            if (event->type != DataReceived || event->channel < 0 || event->channel >= NumChannels) continue;
+            checkMessage(&clientChecks[event->channel], event->channel, event->data, event->dataSize, numMessages, size);
+        }
+        nscFreeClientEvents(clientEvents);
+
+        if (clientChecks[Ordered].received == numMessages && clientChecks[Unordered].received == numMessages) break;
+    }
+    double seconds = (nscMonotonicNs() - start) / 1e9;
+
+    // Results : the reliable channels must be complete, every channel free of errors
+    int failed = disconnected;
+    for (int channel = 0; channel < NumChannels; channel++) {
+        int complete = channel == Sequenced
+            || (serverChecks[channel].received == numMessages && clientChecks[channel].received == numMessages);
+        int errors = serverChecks[channel].errors + clientChecks[channel].errors;
+        printf("%-21s : server %d/%d, echoes %d/%d, errors %d -> %s\n", channelNames[channel],
+               serverChecks[channel].received, numMessages, clientChecks[channel].received, numMessages, errors,
+               (complete && errors == 0) ? "ok" : "FAILED");
+        if (!complete || errors != 0) failed = 1;
+    }
+    NSC_ReliableStatus status;
+    getReliableStatus(client, &status);
+    printf("%.2f s, loss %d%% : %llu datagrams dropped on purpose, %llu retransmitted, rtt %u us%s\n", seconds, loss,
+           (unsigned long long)(getClientStats(client).injectedLosses + getServerStats(server).injectedLosses),
+           (unsigned long long)(getClientStats(client).retransmits + getServerStats(server).retransmits), status.rtt,
+           disconnected ? ", disconnected" : "");
+
+    closeClient(client);
+    closeServer(server);
+    for (int channel = 0; channel < NumChannels; channel++) {
+        free(serverChecks[channel].seen);
+        free(clientChecks[channel].seen);
+    }
+    free(message);
+    #if defined (_WIN32)
+        cleanup();
+    #endif
+    return failed;
+}
@@ -0,0 +1,159 @@
+#include "NSC.h"
+
+/*
+Name : Traffic Replay
+This tool replays a capture recorded by a server (see nscRecordStart) against a server : every recorded connection
+gets its own client, which sends the recorded messages with their recorded timing, at the recorded speed,
+N times faster, or as fast as possible. The answers of the server are read and counted.
+The capture of a UDP server without sessions is replayed by a single client.
+
+Usage : replay <capture> [address] [port] [speed]
+    speed : 1 (default) for the recorded timing, N for N times faster, max for no waiting
+Example :
+    echoServer tcp 4 25565 traffic.nsc (record), then loadgen ..., then : replay traffic.nsc 127.0.0.1 25565 10
+*/
+
+#define MAX_MESSAGE (1u << 24) // Larger records end the replay
+
+// Give the CPU back for a while when the next event is far
+static void yieldCpu() {
+    #if defined (_WIN32)
+        Sleep(0);
+    #else
+        usleep(500);
+    #endif
+}
+
+// Open a client for a recorded connection, NULL if the server refuses it
+static Client* openClient(const NSC_CaptureHeader* header, const char* address, int port) {
+    NSC_Options options;
+    memset(&options, 0, sizeof(options));
+    options.pollTimeout = -1; // clientListen does not wait, the pace is kept by the replay
+    options.noDelay = 1;
+    return createClientEx(address, port, header->connType, header->ipType, &options);
+}
+
+// Read the events of a client, returns the number of messages received
+static int drain(Client* client) {
+    int received = 0;
+    ClientEventsList* events = clientListen(client);
+    for (int i = 0; i < events->numEvents; i++) {
+        if (events->events[i].type == DataReceived) received++;
+    }
+    nscFreeClientEvents(events);
+    return received;
+}
+
+int main(int argc, char** argv) {
+    #if defined (_WIN32)
+        startup();
+    #endif
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage : %s <capture> [address] [port] [speed (1, N or max)]\n", argv[0]);
+        return 1;
+    }
+    const char* address = (argc > 2) ? argv[2] : "127.0.0.1";
+    int port = (argc > 3) ? atoi(argv[3]) : 25565;
+    double speed = (argc > 4 && strcmp(argv[4], "max") != 0) ? atof(argv[4]) : 1.0;
+    int maxSpeed = argc > 4 && !strcmp(argv[4], "max");
+    if (speed <= 0) speed = 1.0;
+
+    FILE* file = fopen(argv[1], "rb");
+    NSC_CaptureHeader header;
+    if (file == NULL || fread(&header, sizeof(header), 1, file) != 1 || header.magic != NSC_CAPTURE_MAGIC || header.version != NSC_CAPTURE_VERSION) {
+        fprintf(stderr, "%s is not a capture file\n", argv[1]);
+        return 1;
+    }
+    if (header.ipType == UNIX && argc <= 2) address = "/tmp/nsc-echo.sock";
+
+    // Clients of the recorded connections, by slot of their connection id
+    Client** clients = (Client**)calloc(NSC_ID_SLOTS, sizeof(Client*));
+    uint32_t* ids = (uint32_t*)calloc(NSC_ID_SLOTS, sizeof(uint32_t));
+    uint32_t* active = (uint32_t*)malloc(sizeof(uint32_t) * NSC_ID_SLOTS); // Slots with a client, to read their answers
+    int numActive = 0;
+    char* data = (char*)malloc(MAX_MESSAGE);
+
+    uint64_t sent = 0, received = 0, bytes = 0, refused = 0;
+    uint64_t start = nscMonotonicNs();
+    NSC_CaptureRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.type == Connection && record.connId == 0) break; // Zeros after the end of a server killed while recording
+        if (record.size > MAX_MESSAGE || (record.size != 0 && fread(data, 1, record.size, file) != record.size)) break;
+
+        // Wait for the time of the event (scaled)
+        if (!maxSpeed) {
+            uint64_t due = start + (uint64_t)(record.time / speed);
+            while (nscMonotonicNs() < due) {
+                for (int i = 0; i < numActive; i++) received += drain(clients[active[i]]);
+                uint64_t now = nscMonotonicNs();
+                if (due > now + 1000000) yieldCpu();
+            }
+        }
+
+        uint32_t slot = record.connId & (NSC_ID_SLOTS - 1);
+        if (record.type == Disconnection) {
+            if (clients[slot] != NULL && ids[slot] == record.connId) {
+                received += drain(clients[slot]);
+                closeClient(clients[slot]);
+                clients[slot] = NULL;
+                for (int i = 0; i < numActive; i++) {
+                    if (active[i] == slot) {
+                        active[i] = active[--numActive];
+                        break;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // A connection opens on its first event (the Connection of a TCP session, the first datagram otherwise)
+        if (clients[slot] == NULL || ids[slot] != record.connId) {
+            if (clients[slot] != NULL) closeClient(clients[slot]);
+            else active[numActive++] = slot;
+            clients[slot] = openClient(&header, address, port);
+            ids[slot] = record.connId;
+            if (clients[slot] == NULL) {
+                refused++;
+                for (int i = 0; i < numActive; i++) {
+                    if (active[i] == slot) {
+                        active[i] = active[--numActive];
+                        break;
+                    }
+                }
+                continue;
+            }
+        }
+
+        if (record.type == DataReceived) {
+            if (sendClientMessage(clients[slot], data, record.size) == 0) {
+                sent++;
+                bytes += record.size;
+            }
+            if (maxSpeed && (sent & 63) == 0) received += drain(clients[slot]);
+        }
+    }
+
+    // Read the last answers
+    uint64_t end = nscMonotonicNs() + 200000000ULL;
+    while (nscMonotonicNs() < end) {
+        for (int i = 0; i < numActive; i++) received += drain(clients[active[i]]);
+    }
+    double seconds = (nscMonotonicNs() - start) / 1e9 - 0.2;
+    if (seconds <= 0) seconds = 1e-9;
+
+    printf("Replayed %llu messages (%.1f MB) in %.3f s : %.0f msg/s, %llu answers received, %llu connections refused\n",
+           (unsigned long long)sent, bytes / 1e6, seconds, sent / seconds, (unsigned long long)received, (unsigned long long)refused);
+
+    for (int i = 0; i < numActive; i++) closeClient(clients[active[i]]);
+    fclose(file);
+    free(clients);
+    free(ids);
+    free(active);
+    free(data);
+
+    #if defined (_WIN32)
+        cleanup();
+    #endif
+    return 0;
+}
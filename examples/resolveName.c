@@ -16,7 +16,7 @@ int main() {
 
     if (ip != NULL) {
         printf("IP Address: %s\n", ip);
-        free(ip); // Free the IP string allocated in resolveDomainName
+        nscFree(ip); // Free the IP string allocated in resolveDomainName
     } else {
         printf("Failed to resolve domain name.\n");
     }
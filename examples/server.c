@@ -60,7 +60,7 @@ int main() {
                 if (usedConnType == TCP) {
                     for (int i = 0; i < server->numClients; ++i) {
                         if (server->clients[i].socket != event.socket) {
-                            sendMessage(&server->clients[i].socket, event.data, event.dataSize, usedConnType, usedIpType, &server->clients[i].sin);
+                            sendClientMessage(&server->clients[i], event.data, event.dataSize); // Queued if the client's socket is full
                         }
                     }
                 }
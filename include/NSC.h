@@ -5,7 +5,8 @@ Starring : Thomas K/BIDI
 
 Description:
 Networking System C (NSC) is a lightweight, cross-platform library that simplifies socket usage with tools for server/client handling, an event system, and message framing over TCP.
-It lets you create server and clients in IPv4 or IPv6 with TCP and UDP communication protocols.
+It lets you create server and clients in IPv4 or IPv6 with TCP and UDP communication protocols,
+or over UNIX domain sockets (stream or datagram) between processes of the same machine (Linux).
 You can also do domain name resolution.
 */
 
@@ -14,10 +15,12 @@ You can also do domain name resolution.
 
 // Includes
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <math.h>
 #include <assert.h>
 #include <stdint.h>
+#include <time.h>
 
 // Definition according to the OS used - to make the library cross-platform
 #if defined (_WIN32)
@@ -68,6 +71,7 @@ static inline void cleanup() {
 #elif defined (__linux__)
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
@@ -75,6 +79,8 @@ static inline void cleanup() {
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
 
 // We define the elements which doesn't exist in Linux
 #define INVALID_SOCKET -1
@@ -91,16 +97,51 @@ extern "C" {
 #endif
     // Definition for the connection's type
     enum NSC_ConnType { TCP, UDP };
-    enum NSC_IP_Type { IPv4, IPv6 };
+    enum NSC_IP_Type { IPv4, IPv6, UNIX }; // UNIX : UNIX domain socket (Linux), TCP for a stream socket, UDP for a datagram one
 
     // Event definition
-    enum NSC_EventType { Connection, DataReceived, Disconnection };
+    // SendComplete : a buffer sent in zero-copy mode can be reused (data and dataSize give the buffer)
+    // SendTimestamp : the kernel sent a message (see NSC_TIMESTAMP_TX), dataSize gives the id of the send and trace its timestamps
+    enum NSC_EventType { Connection, DataReceived, Disconnection, SendComplete, SendTimestamp };
 
-    // Constants
+    // Stages of the reception of a message, measured when tracing is enabled (see nscTraceEnable)
+    // Wait : time blocked in poll() / Recv : from poll()'s return to the recv() that completed the message
+    // Parse : from that recv() to the message extracted / Build : from the message extracted to the events list returned
+    // Handler : from the events list returned to nscTraceHandled() called by the application
+    // Queue : from the kernel's reception timestamp to the recv() that read the data (see NSC_TIMESTAMP_RX)
+    enum NSC_TraceStage { StageWait, StageRecv, StageParse, StageBuild, StageHandler, StageQueue, StageCount };
+
+    // What a server does with the pending connections when it holds its maximum number of connections
+    // Reject : accept and close them right away / Defer : leave them in the kernel's backlog until a slot is free
+    enum NSC_AdmissionPolicy { AdmissionReject, AdmissionDefer };
+
+    // What a server does with the messages of a connection over its rate limits (see setServerRateLimit)
+    // Delay : stop reading it until its tokens are back / Drop : read and drop them / Disconnect : close the connection
+    enum NSC_RateAction { RateDelay, RateDrop, RateDisconnect };
+
+    // Constants (can be overridden at compile time, e.g. -DMaxClients=10000)
+    // MaxClients, BufferSize and EventBlock are the defaults of NSC_Options, which sets them per instance
+    #ifndef MaxClients
     #define MaxClients 100 // Maximum number of clients on the server
+    #endif
+    #ifndef BufferSize
     #define BufferSize 8192 // Maximum size of the buffer (default : 8192)
+    #endif
+    #ifndef QueueLength
     #define QueueLength 65535 // Maximum length of the queue of pending connections
+    #endif
+    #ifndef EventBlock
     #define EventBlock 8 // Block of events to allocate
+    #endif
+    #ifndef AcceptBudget
+    #define AcceptBudget 64 // Default maximum number of connections accepted per serverListen call
+    #endif
+    #ifndef ReadBudget
+    #define ReadBudget 64 // Default maximum number of messages read from one connection per serverListen call
+    #endif
+    #ifndef BufferPoolSize
+    #define BufferPoolSize 64 // Maximum number of free receive buffers a server keeps for its connections
+    #endif
     
     #define READMSG_NO_DATA          0   // Not enough data yet for a full message
     #define READMSG_CONN_CLOSED     -1   // Connection closed by peer (recv() == 0)
@@ -108,19 +149,179 @@ extern "C" {
     #define READMSG_MSG_TOO_LARGE   -3   // Message length invalid / too large
     #define READMSG_SOCKET_ERROR    -4   // Socket error other than non-blocking wait
 
+    // Flags of the length header of a TCP frame (the length is in the low 30 bits)
+    #define NSC_FRAME_COMPRESSED   0x80000000u // The body is compressed : [original length : 4 bytes][LZ data]
+    #define NSC_FRAME_DICTIONARY   0x40000000u // Compressed with a shared dictionary : [original length][dictionary id : 4 bytes][LZ data]
+    #define NSC_FRAME_LENGTH_MASK  0x3FFFFFFFu
+    // Prioritized streams (see sendStreamMessage), invalid headers for the peers that do not read streams
+    #define NSC_FRAME_STREAM       0x40000000u // NSC_FRAME_DICTIONARY alone : a chunk of a message [stream : 1 byte][last : 1 byte][data]
+    #define NSC_FRAME_HELLO        0xFFFFFFFFu // Whole header, no body : the sender reads streams (skipped as 4 invalid bytes by the others)
+    #define NSC_MAX_STREAMS        8 // Streams of a connection, stream 0 is the most urgent
+
+    // Connection ids of a server's connections : [generation : 12 bits][slot : 20 bits] (see getConnection)
+    // The slot limits options.maxClients to NSC_ID_SLOTS, the generation tells a reused slot from the old connection
+    #define NSC_ID_SLOT_BITS  20
+    #define NSC_ID_SLOTS      (1 << NSC_ID_SLOT_BITS)
+
+    // RPC messages : [type : 1 byte][request id : 4 bytes][payload] (see nscRpcCall)
+    #define NSC_RPC_REQUEST   1
+    #define NSC_RPC_RESPONSE  2
+    #define NSC_RPC_HEADER    5
+
+    // Results of the RPC calls
+    #define RPC_OK             0   // The response was received
+    #define RPC_TIMEOUT       -1   // The deadline of the call expired first
+    #define RPC_CLOSED        -2   // The connection was closed (or the RPC channel destroyed) first
+    #define RPC_UNKNOWN       -3   // No blocking call with this id is pending
+
+    #define NSC_TRACE_BUCKETS 48 // Bucket i of a trace histogram counts the durations in [2^i, 2^(i+1)[ ns
+
+    // Monotonic timestamps (in ns) of a received message, all at 0 when tracing is disabled
+    // except the kernel ones, set whenever the connection has kernel timestamping (see NSC_TIMESTAMP_RX)
+    typedef struct {
+        uint64_t pollStart; // poll() was called
+        uint64_t readable; // poll() returned with the socket readable
+        uint64_t bytesRead; // The recv() that completed the message returned
+        uint64_t frameComplete; // The message was extracted from the connection's buffer
+        uint64_t delivered; // The events list was returned to the application
+        uint64_t kernelTime; // The kernel received the data that completed the message (DataReceived) or sent it (SendTimestamp)
+        uint64_t hardwareTime; // The same from the NIC, in the NIC's clock (0 if not available)
+    } NSC_EventTrace;
+
+    // Kernel timestamping of a connection's socket (NSC_Options.timestamping, SO_TIMESTAMPING, Linux, IPv4 and IPv6)
+    #define NSC_TIMESTAMP_RX        1 // Reception timestamps on the DataReceived events (trace.kernelTime, trace.hardwareTime)
+    #define NSC_TIMESTAMP_TX        2 // A SendTimestamp event when each send() leaves the host (not for a UDP server's sessions),
+                                      // its dataSize is the bytes sent on the connection up to the end of that send() in TCP
+                                      // (frame headers included, like stats.bytesOut), the number of the datagram (from 1) in UDP
+    #define NSC_TIMESTAMP_HARDWARE  4 // NIC timestamps too, where the device supports them (enabled on the device with SIOCSHWTSTAMP)
+
+    // Histogram of the durations of one stage
+    typedef struct {
+        uint64_t count; // Number of durations recorded
+        uint64_t sumNs; // Sum of the durations
+        uint64_t maxNs; // Longest duration
+        uint64_t buckets[NSC_TRACE_BUCKETS]; // Log2 buckets
+    } NSC_TraceHistogram;
+
+    // Timer, scheduled on a timer wheel (see nscTimerSchedule)
+    typedef struct NSC_Timer {
+        struct NSC_Timer* next; // Links of the timer in its wheel's slot (NULL when not scheduled)
+        struct NSC_Timer* prev;
+        uint64_t expires; // Expiration tick (in ms of the monotonic clock)
+        void (*callback)(struct NSC_Timer* timer, void* context); // Function called when the timer expires
+        void* context; // Pointer given back to the callback
+    } NSC_Timer;
+
+    // Hierarchical timer wheel : NSC_WHEEL_LEVELS levels of NSC_WHEEL_SLOTS slots, 1 ms per tick
+    // Level n covers 64^(n+1) ms (64 ms, 4 s, 4.5 min, 4.6 h), farther timers are re-cascaded every 4.6 h
+    #define NSC_WHEEL_BITS 6
+    #define NSC_WHEEL_SLOTS (1 << NSC_WHEEL_BITS)
+    #define NSC_WHEEL_LEVELS 4
+    typedef struct {
+        NSC_Timer slots[NSC_WHEEL_LEVELS][NSC_WHEEL_SLOTS]; // Heads of the slots' circular lists
+        uint64_t occupied[NSC_WHEEL_LEVELS]; // Bit i set if the slot i may hold timers
+        uint64_t now; // Last tick processed
+    } NSC_TimerWheel;
+
+    // Memory allocator (see nscSetAllocator) : every allocation of NSC goes through one
+    // release is never given NULL, context is passed back to the three functions
+    typedef struct {
+        void* (*allocate)(size_t size, void* context); // Like malloc
+        void* (*reallocate)(void* memory, size_t size, void* context); // Like realloc (memory can be NULL)
+        void (*release)(void* memory, void* context); // Like free
+        void* context; // Arena, counters... of the application
+    } NSC_Allocator;
+
+    // Options of createServerEx / createClientEx : socket tuning and per-instance constants
+    // A field left at 0 keeps the default, a zero-initialized structure behaves like createServer / createClient
+    // The socket options of a server are applied to its accepted connections too
+    typedef struct {
+        int noDelay; // 1 : TCP_NODELAY, small messages are sent right away (Nagle's algorithm disabled)
+        int reuseAddress; // 1 : SO_REUSEADDR on a server's socket, to bind again right after a restart
+        int recvBufferSize; // SO_RCVBUF, kernel receive buffer (bytes)
+        int sendBufferSize; // SO_SNDBUF, kernel send buffer (bytes)
+        int busyPoll; // SO_BUSY_POLL, time (us) the kernel busy-polls the device when there is nothing to read (Linux)
+        int quickAck; // 1 : TCP_QUICKACK, acknowledge right away instead of delaying (Linux, the kernel can leave this mode)
+        int fastOpen; // TCP_FASTOPEN : queue of pending fast open requests of a server, 1 for a client (Linux)
+        int tos; // IP_TOS / IPV6_TCLASS, e.g. 0xB8 for expedited forwarding
+        int maxClients; // Maximum number of clients of a server (MaxClients)
+        int bufferSize; // Size of the receive buffers, messages are at most bufferSize - 4 bytes (BufferSize)
+        int eventBlock; // Number of events allocated at once (EventBlock)
+        int pollTimeout; // Maximum wait (ms) of serverListen / clientListen (10), negative : no wait
+        int sharedMemory; // Size (bytes, rounded up to a power of two) of the shared-memory rings of a UNIX stream connection,
+                          // 0 : the data goes through the socket. The server and its clients must set it alike (Linux)
+        int ringSpin; // Time (us) spent checking the shared-memory rings before sleeping in poll(), negative : never sleep (pure spin)
+        int timestamping; // NSC_TIMESTAMP_* flags : kernel timestamps of the received messages and of the sends (Linux)
+        int streamChunk; // Size (bytes) of the chunks of the prioritized streams of a TCP connection (see sendStreamMessage), 0 : no streams
+        const NSC_Allocator* allocator; // Allocator of the instance, copied (NULL : the one set by nscSetAllocator)
+    } NSC_Options;
+
+    // Channels of reliable UDP (see enableServerReliable / enableClientReliable)
+    #define NSC_MAX_CHANNELS 8
+    enum NSC_ChannelType {
+        ChannelReliableOrdered, // Every message is delivered once, in the order they were sent
+        ChannelReliableUnordered, // Every message is delivered once, as soon as it is complete
+        ChannelUnreliableSequenced // Messages can be lost, a message older than the last delivered one is dropped
+    };
+
+    // Options of reliable UDP, both ends must use the same channels
+    typedef struct {
+        int numChannels; // Number of channels, 1 to NSC_MAX_CHANNELS (0 : one ChannelReliableOrdered channel)
+        int channelTypes[NSC_MAX_CHANNELS]; // Type of each channel
+        uint32_t mtu; // Maximum size of a datagram (0 : 1200, at most bufferSize - 1), larger messages are fragmented
+        uint32_t lossPercent; // Testing : percentage of the datagrams sent that are dropped on purpose (0 : none)
+    } NSC_ReliableOptions;
+
+    // State of the reliable UDP of a connection (see getReliableStatus)
+    typedef struct {
+        uint32_t rtt; // Smoothed round-trip time (us, 0 before the first acknowledgement)
+        uint32_t rttVariation; // Its mean deviation (us)
+        uint32_t retransmitTimeout; // Time (us) after which an unacknowledged packet is sent again
+        uint32_t congestionWindow; // Maximum number of reliable packets in flight
+        uint32_t inFlight; // Reliable packets sent and not acknowledged
+        uint32_t queued; // Reliable packets waiting for room in the congestion window
+    } NSC_ReliableStatus;
+
+    // Capture file written by nscRecordStart : an NSC_CaptureHeader, then for each event an NSC_CaptureRecord followed by its data
+    // (the fields are in the byte order of the recording host)
+    #define NSC_CAPTURE_MAGIC 0x4E534343 // "NSCC"
+    #define NSC_CAPTURE_VERSION 1
+    typedef struct {
+        uint32_t magic; // NSC_CAPTURE_MAGIC
+        uint32_t version; // NSC_CAPTURE_VERSION
+        int32_t connType; // Of the recorded server
+        int32_t ipType;
+        uint64_t startTime; // Start of the recording (ns since the epoch)
+    } NSC_CaptureHeader;
+
+    typedef struct {
+        uint64_t time; // Time of the reception (ns since the start of the recording, the kernel's one with NSC_TIMESTAMP_RX)
+        uint32_t connId; // Connection id (0 for the datagrams of a UDP server without sessions)
+        uint32_t size; // Bytes of data following the record (0 but for DataReceived)
+        uint16_t type; // Connection, DataReceived or Disconnection
+        uint16_t channel; // Channel of a reliable UDP message
+        uint32_t reserved;
+    } NSC_CaptureRecord;
+
     // Union for the address
     typedef union {
         struct sockaddr_in in;
         struct sockaddr_in6 in6;
+#if defined (__linux__)
+        struct sockaddr_un un; // Path of a UNIX domain socket ('\0' first for the abstract namespace)
+#endif
     } SIN;
 
     typedef struct {
         int type; // Type of the event (Connection, DataReceived, Disconnection)
         SOCKET socket; // Socket of the client that triggered the event
+        uint32_t connId; // Connection id of the client (see getConnection), 0 for the events of a UDP server without sessions
         char* data; // Data received
         uint32_t dataSize;
         int ipType; // IP type (IPv4 or IPv6)
         SIN sin; // Address of the client
+        NSC_EventTrace trace; // Reception timestamps (DataReceived only, when tracing is enabled)
+        int channel; // Channel of a reliable UDP message (see sendChannelMessage), stream of a TCP one (see sendStreamMessage), 0 otherwise
     } ServerEvent;
 
     // Structures for the network system
@@ -128,6 +329,8 @@ extern "C" {
     typedef struct {
         ServerEvent* events;
         int numEvents;
+        const NSC_Allocator* allocator; // Allocator of the list and of the events' data (see nscFreeServerEvents)
+        struct NSC_FlowControl* flowControl; // Flow control the messages are given back to when the list is freed (NULL : none)
     } ServerEventsList;
 
     // ClientEvent
@@ -135,29 +338,96 @@ extern "C" {
         int type;
         char* data;
         uint32_t dataSize;
+        NSC_EventTrace trace; // Reception timestamps (DataReceived only, when tracing is enabled)
+        int channel; // Channel of a reliable UDP message (see sendChannelMessage), stream of a TCP one (see sendStreamMessage), 0 otherwise
     } ClientEvent;
 
     typedef struct {
         ClientEvent* events;
         int numEvents;
+        const NSC_Allocator* allocator; // Allocator of the list and of the events' data (see nscFreeClientEvents)
     } ClientEventsList;
 
+    // Statistics counters of a connection or of a server
+    // The counters are updated unless NSC is compiled with NSC_NO_STATS (the fields stay, at 0)
+    typedef struct {
+        uint64_t bytesIn; // Bytes received (framing headers included)
+        uint64_t bytesOut; // Bytes sent (framing headers included)
+        uint64_t framesIn; // Messages received
+        uint64_t framesOut; // Messages fully sent
+        uint64_t recvCalls; // recv() / recvfrom() calls
+        uint64_t sendCalls; // send() / sendto() calls
+        uint64_t pollCalls; // poll() calls
+        uint64_t acceptCalls; // accept() calls
+        uint64_t rejectedConnections; // Connections closed right away because the server was full
+        uint64_t acceptBudgetHits; // serverListen calls that stopped accepting at the accept budget
+        uint64_t readBudgetHits; // Times the reading of a connection stopped at the read budget
+        uint64_t eagainHits; // Socket calls that returned EAGAIN / EWOULDBLOCK
+        uint64_t resyncBytes; // Bytes skipped to find a valid header again
+        uint64_t oversizeDrops; // Invalid headers (empty or larger than BufferSize - 4) met
+        uint64_t partialSends; // Messages whose sending failed before the end
+        uint64_t allocations; // Memory allocations made by NSC
+        uint64_t peakBufferUsage; // Highest number of bytes held in a receive buffer
+        uint64_t zeroCopySends; // Messages sent in zero-copy mode
+        uint64_t zeroCopyCopied; // Zero-copy sends the kernel had to copy anyway (loopback for example)
+        uint64_t compressedFrames; // Messages sent compressed
+        uint64_t compressInput; // Original size of the messages sent compressed
+        uint64_t compressOutput; // Their compressed size (compressInput / compressOutput : compression ratio)
+        uint64_t compressSkipped; // Messages sent uncompressed because compression did not shrink them
+        uint64_t compressNs; // Time spent compressing (ns)
+        uint64_t decompressedFrames; // Compressed messages received
+        uint64_t decompressNs; // Time spent decompressing (ns)
+        uint64_t decompressErrors; // Compressed messages dropped (corrupted or unknown dictionary)
+        uint64_t retransmits; // Reliable UDP packets sent again (timeout or selective acknowledgement)
+        uint64_t injectedLosses; // Datagrams dropped on purpose by the loss injection of reliable UDP
+        uint64_t recordDrops; // Events not recorded because the capture's buffer was full (see nscRecordStart)
+        uint64_t flowPauses; // Times the reading of a connection (or of a UDP server's socket) was paused by the flow control
+        uint64_t asyncDrops; // Messages of sendAsyncMessage dropped because their connection was closed
+        uint64_t rateDelays; // Times the reading of a connection (or of a UDP server's socket) was delayed by the rate limits
+        uint64_t rateDrops; // Messages dropped because they were over the rate limits
+        uint64_t rateDisconnects; // Connections closed because they went over the rate limits
+    } NSC_Stats;
+
+    // Shared compression dictionary (see nscCreateDictionary)
+    typedef struct NSC_Dictionary NSC_Dictionary;
+
     // Client's buffer informations
     typedef struct {
-        char* buffer;
+        char* buffer; // Receive buffer, NULL while a server's connection has no pending data
+        int size; // Size of the buffer (BufferSize unless set in the options)
         int len;
         int pos;
+        int skipping; // 1 while bytes are skipped to resynchronize on a valid header
+        uint64_t readTime; // Time of the last recv() that returned data (only when tracing is enabled)
+        uint64_t kernelTime; // Kernel timestamps of the data of that recv() (see NSC_TIMESTAMP_RX)
+        uint64_t hardwareTime;
     } ClientBuffer;
 
     // Client's structure
+    // An idle server's connection costs sizeof(Client) (under 512 bytes on 64 bits systems, checked when NSC is compiled)
+    // plus its poll entry (8 bytes) and its slot of the server's statistics (sizeof(NSC_Stats)) :
+    // its receive buffer is taken from the server's pool only while a message is incomplete, the optional states are allocated on use
     typedef struct {
         ClientBuffer bufferData;
+        struct NSC_BufferPool* bufferPool; // Pool the receive buffer returns to once drained (NULL : the buffer is kept)
         SOCKET socket; // The client's address
         SIN sin; // The client's address
         socklen_t recSize;
-        fd_set socketSet; // File descriptor set
         int connType; // The connection type (TCP or UDP)
         int ipType; // The IP type (IPv4 or IPv6)
+        NSC_Stats* stats; // The connection's statistics (in the server's per-slot array for a server's connection)
+        NSC_Timer timer; // Idle / read timeout of a server's connection
+        uint64_t lastActivity; // Tick (ms) of the last data received by a server's connection
+        uint64_t partialSince; // Tick (ms) since which a partial message is pending (0 if none)
+        int readPending; // 1 if the read budget stopped the reading : the connection is read next call without waiting for poll()
+        int eventBlock; // Number of events allocated at once by clientListen
+        int pollTimeout; // Maximum wait (ms) of clientListen
+        uint32_t id; // Connection id of a server's connection (0 for a standalone client)
+        const NSC_Allocator* allocator; // Allocator of the connection (the server's one for a server's connection)
+        struct NSC_ClientExtension* extension; // Rarely used states (zero-copy, send queue, compression, rings, reliable UDP...), allocated with the first of them
+        int timestamping; // NSC_TIMESTAMP_* flags enabled on the socket
+        int flowPaused; // 1 while the flow control holds the reading of a server's connection (see setServerFlowControl)
+        int ratePaused; // 1 while the rate limits delay the reading of a server's connection (see setServerRateLimit)
     } Client;
 
     // Server's structure
@@ -168,25 +438,78 @@ extern "C" {
 
         int connType; // The connection type (TCP or UDP)
         int ipType; // The IP type (IPv4 or IPv6)
-        fd_set socketSet; // Descriptor set for the server
-        int maxSocket; // Value of the maximum socket
+        struct pollfd* pollSet; // Descriptor set given to poll() (server's socket + one per client)
         int numClients; // Number of clients connected to the server
         Client* clients; // List of clients connected to the server
+        NSC_Stats stats; // Server's own statistics (listening socket, UDP, disconnected clients)
+        NSC_TimerWheel timers; // Timers run by serverListen
+        NSC_Timer expiredConnections; // Head of the list of connections whose timeout timer expired
+        uint32_t idleTimeout; // Disconnect clients that sent nothing for this long (ms, 0 : disabled)
+        uint32_t readTimeout; // Disconnect clients that leave a message incomplete for this long (ms, 0 : disabled)
+        uint32_t zeroCopyThreshold; // Zero-copy threshold given to the accepted clients (0 : disabled)
+        uint32_t compressionThreshold; // Compression threshold given to the accepted clients (0 : disabled)
+        NSC_Dictionary* compressionDictionary; // Compression dictionary given to the accepted clients (NULL : none)
+        struct NSC_BufferPool* bufferPool; // Receive buffers of the connections without pending data
+        int backlog; // Length of the queue of pending connections given to listen()
+        int acceptBudget; // Maximum number of connections accepted per serverListen call (0 : no limit)
+        int maxConnections; // Number of connections from which the admission policy applies (at most options.maxClients)
+        int admissionPolicy; // AdmissionReject or AdmissionDefer
+        uint32_t readBudgetFrames; // Maximum number of messages read from one connection per serverListen call (0 : no limit)
+        uint32_t readBudgetBytes; // Maximum number of bytes read from one connection per serverListen call (0 : no limit)
+        uint32_t flowEvents; // Maximum number of undelivered messages of one connection (0 : no limit, see setServerFlowControl)
+        uint32_t flowBytes; // Maximum number of undelivered bytes of one connection (0 : no limit)
+        uint32_t flowTotalEvents; // Maximum number of undelivered messages of all the connections (0 : no limit)
+        uint64_t flowTotalBytes; // Maximum number of undelivered bytes of all the connections (0 : no limit)
+        struct NSC_FlowControl* flowControl; // Messages handed out by serverListen and not freed yet (NULL : flow control disabled)
+        int flowPaused; // 1 while the flow control holds the reading of a UDP server's socket
+        struct NSC_AsyncSends* asyncSends; // Queues of the messages sent from other threads (NULL : disabled, see enableServerAsyncSend)
+        uint32_t rateFrames; // Messages per second of one connection (0 : no limit, see setServerRateLimit)
+        uint32_t rateBytes; // Bytes per second of one connection (0 : no limit)
+        uint32_t rateTotalFrames; // Messages per second of all the connections (0 : no limit)
+        uint64_t rateTotalBytes; // Bytes per second of all the connections (0 : no limit)
+        int rateAction; // RateDelay, RateDrop or RateDisconnect
+        struct NSC_RateLimit* rateLimit; // Token buckets of the rate limits (NULL : disabled)
+        int ratePaused; // 1 while the rate limits delay the reading of a UDP server's socket
+        NSC_Options options; // Options of the server, defaults filled in (maxClients, bufferSize... are the ones in use)
+        struct NSC_ConnectionIds* connectionIds; // Slots of the connections' ids (index in clients of each one)
+        NSC_Stats* connectionStats; // Statistics of the connections, one per slot of their ids
+        struct NSC_Topics* topics; // Publish/subscribe topics (NULL until the first subscription)
+        struct NSC_UdpSessions* udpSessions; // Sessions of a UDP server's peers by address (NULL : disabled, see enableUdpSessions)
+        NSC_ReliableOptions* reliableOptions; // Reliable UDP of the sessions (NULL : plain datagrams, see enableServerReliable)
+        struct NSC_Recorder* recorder; // Capture of the received messages (NULL : not recording, see nscRecordStart)
+        NSC_Allocator allocator; // Allocator of the server and of its connections
     } Server;
 
     /*
     Parameters:
-        - char* address : The address of the server
-        - int port : The port of the server
+        - char* address : The address of the server (UNIX : the socket's path, '@' first for the abstract namespace)
+        - int port : The port of the server (ignored in UNIX)
         - int connType : The connection type (TCP or UDP)
-        - int ipType : The IP type (IPv4 or IPv6)
+        - int ipType : The IP type (IPv4, IPv6 or UNIX)
     Output:
         - Server* : The server created with the given parameters (NULL if an error occurred)
     Description:
         This function creates a server with the given parameters and returns it.
+        A UNIX server replaces a stale socket file at its path (its creation fails while another server listens on it)
+        and removes it when it is closed.
     */
     Server* createServer(const char* address, int port, int connType, int ipType);
 
+    /*
+    Parameters:
+        - char* address : The address of the server (UNIX : the socket's path, '@' first for the abstract namespace)
+        - int port : The port of the server (ignored in UNIX)
+        - int connType : The connection type (TCP or UDP)
+        - int ipType : The IP type (IPv4, IPv6 or UNIX)
+        - const NSC_Options* options : The options of the server (NULL : defaults)
+    Output:
+        - Server* : The server created with the given parameters (NULL if an error occurred)
+    Description:
+        This function creates a server like createServer, its socket configured with the options before bind() and listen().
+        The socket options are applied to each accepted connection as well.
+    */
+    Server* createServerEx(const char* address, int port, int connType, int ipType, const NSC_Options* options);
+
     /*
     Parameters:
         - Server* server : The server to close
@@ -199,9 +522,12 @@ extern "C" {
     Parameters:
         - Server* server : The server to accept the client from
     Output:
-        - Client* : The client that was accepted
+        - Client* : The client that was accepted (NULL if there is no pending connection or the server is full)
     Description:
         This function accepts a client's connection to the server and returns a pointer to the client.
+        The accepted socket is non-blocking (and close-on-exec on Linux, with accept4()).
+        If the server already holds server->maxConnections clients, the pending connection is
+        accepted and closed right away (AdmissionReject) or left pending (AdmissionDefer).
     */
     Client* acceptClient(Server* server);
 
@@ -215,6 +541,17 @@ extern "C" {
     */
     ServerEventsList* serverListen(Server* server);
 
+    /*
+    Parameters:
+        - ServerEventsList* eventsList : The list returned by serverListen
+    Description:
+        This function frees the list, its events and the data they received, with the server's allocator.
+        To keep the data of an event, set its data to NULL and release it later with server->allocator.
+        The data of SendComplete events belongs to the application and is not freed.
+        With the default allocator, free() on the data, the events and the list is still valid.
+    */
+    void nscFreeServerEvents(ServerEventsList* eventsList);
+
     /*
     Parameters:
         - Server* server : The server to disconnect the client from
@@ -226,10 +563,331 @@ extern "C" {
 
     /*
     Parameters:
-        - char* address : The address of the client
-        - int port : The port of the client
+        - Server* server : The server
+        - uint32_t connId : The connection id (ServerEvent.connId or Client.id)
+    Output:
+        - Client* : The connection (NULL if it is disconnected)
+    Description:
+        This function finds a connection by its id in constant time.
+        Unlike its index in server->clients and its address, a connection's id does not change while it is connected,
+        and the id of a disconnected connection is not given to the next connections of its slot.
+    */
+    Client* getConnection(Server* server, uint32_t connId);
+
+    /*
+    Parameters:
+        - Server* server : The server (TCP, or UDP with sessions)
+        - uint32_t connId : The connection to subscribe
+        - const char* topic : The topic (any string)
+    Output:
+        - int : 0 if the connection is subscribed (or already was), -1 otherwise
+    Description:
+        This function subscribes a connection to a topic : it receives the messages published on it.
+        The subscriptions of a connection are removed when it disconnects.
+    */
+    int subscribe(Server* server, uint32_t connId, const char* topic);
+
+    /*
+    Parameters:
+        - Server* server : The server
+        - uint32_t connId : The connection to unsubscribe
+        - const char* topic : The topic
+    Output:
+        - int : 0 if the connection was unsubscribed, -1 if it was not subscribed
+    Description:
+        This function unsubscribes a connection from a topic.
+    */
+    int unsubscribe(Server* server, uint32_t connId, const char* topic);
+
+    /*
+    Parameters:
+        - Server* server : The server
+        - const char* topic : The topic
+        - const char* msg : The message
+        - uint32_t len : The length of the message
+    Output:
+        - int : The number of subscribers the message was sent (or queued) to, -1 on error
+    Description:
+        This function sends a message to every subscriber of a topic.
+        The frame is built once and written to each subscriber's socket (the outbound queue keeps what the socket can't take) :
+        the cost depends on the number of subscribers, not of connections. Published messages are neither compressed nor sent in zero-copy.
+    */
+    int publish(Server* server, const char* topic, const char* msg, uint32_t len);
+
+    /*
+    Parameters:
+        - Server* server : The server
+        - uint32_t maxLen : The maximum length of the message
+    Output:
+        - char* : Room for maxLen bytes in the server's publish frame (NULL if an error occurred)
+    Description:
+        This function hands out the buffer publish builds its frame in, right after the room of its header :
+        the message is written there once and nscPublishCommit sends it, instead of being copied by publish.
+        The buffer is valid until the next nscPublishReserve / publish call on the server.
+    */
+    char* nscPublishReserve(Server* server, uint32_t maxLen);
+
+    /*
+    Parameters:
+        - Server* server : The server
+        - const char* topic : The topic
+        - uint32_t len : The length of the message written in the reserved buffer (at most maxLen)
+    Output:
+        - int : The number of subscribers the message was sent (or queued) to, -1 on error
+    Description:
+        This function publishes the message written in the buffer given by nscPublishReserve, like publish.
+    */
+    int nscPublishCommit(Server* server, const char* topic, uint32_t len);
+
+    /*
+    Parameters:
+        - Server* server : The server to configure
+        - uint32_t idleTimeout : Time (ms) without receiving anything after which a client is disconnected (0 : disabled)
+        - uint32_t readTimeout : Time (ms) a client can leave a message incomplete before being disconnected (0 : disabled)
+    Description:
+        This function sets the timeouts of the server's connections (TCP) or sessions (UDP, idle timeout only).
+        serverListen reports a Disconnection event for each client that timed out and disconnects it.
+        Both timeouts share one timer per connection, scheduled on server->timers.
+    */
+    void setServerTimeouts(Server* server, uint32_t idleTimeout, uint32_t readTimeout);
+
+    /*
+    Parameters:
+        - Server* server : The UDP server
+        - uint32_t idleTimeout : Time (ms) without datagram after which a session is closed (0 : never, see setServerTimeouts)
+    Output:
+        - int : 0 if the sessions are enabled, -1 otherwise
+    Description:
+        This function gives a session to each peer of a UDP server : the first datagram of an address
+        opens it with a Connection event, its datagrams come with its connection id, and serverListen reports
+        a Disconnection event once it has been idle for idleTimeout (or clientDisconnect closes it).
+        A session is one of server->clients that shares the server's socket : getConnection, sendClientMessage,
+        nscSendReserve, subscribe and the statistics work as for a TCP connection, a message being one datagram.
+        Peers are found by address in a hash table (constant time). When maxClients sessions are open,
+        the datagrams of new peers are dropped and counted in rejectedConnections.
+    */
+    int enableUdpSessions(Server* server, uint32_t idleTimeout);
+
+    /*
+    Parameters:
+        - Server* server : The UDP server
+        - const NSC_ReliableOptions* options : The channels (NULL : one reliable ordered channel)
+    Output:
+        - int : 0 if reliable UDP is enabled, -1 otherwise
+    Description:
+        This function turns the datagrams of the server's sessions (enabled if needed, see enableUdpSessions)
+        into channels : reliable ordered, reliable unordered or unreliable sequenced, without the head-of-line
+        blocking of TCP between channels. Reliable packets are acknowledged selectively (a cumulative acknowledgement
+        and a bitmap of the 32 next packets, carried by every packet), retransmitted on timeout (estimated from
+        the round-trip time) or as soon as later packets are acknowledged, under an AIMD congestion window.
+        Messages larger than the MTU are fragmented and reassembled.
+        The messages come as DataReceived events with their channel, a session that leaves a packet
+        unacknowledged for 10 seconds is disconnected. The clients must call enableClientReliable with the same channels.
+        The sessions opened before this call keep plain datagrams.
+    */
+    int enableServerReliable(Server* server, const NSC_ReliableOptions* options);
+
+    /*
+    Parameters:
+        - Client* client : The UDP client
+        - const NSC_ReliableOptions* options : The channels, like the server's (NULL : one reliable ordered channel)
+    Output:
+        - int : 0 if reliable UDP is enabled, -1 otherwise
+    Description:
+        This function enables reliable UDP on a client (see enableServerReliable). clientListen sends
+        the acknowledgements and retransmissions, it must be called regularly.
+        A Disconnection event is reported when the server stops acknowledging.
+    */
+    int enableClientReliable(Client* client, const NSC_ReliableOptions* options);
+
+    /*
+    Parameters:
+        - Client* connection : A client or a session with reliable UDP
+        - int channel : The channel (0 to numChannels - 1)
+        - const char* msg : The message
+        - uint32_t len : Its length (at most the peer's bufferSize - 1, the larger messages are dropped by the peer)
+    Output:
+        - int : 0 if the message was sent or queued, -1 otherwise
+    Description:
+        This function sends a message on a channel. The reliable packets beyond the congestion window are queued
+        and sent as acknowledgements come. sendClientMessage sends on channel 0 once reliable UDP is enabled.
+    */
+    int sendChannelMessage(Client* connection, int channel, const char* msg, uint32_t len);
+
+    /*
+    Parameters:
+        - Client* connection : A client or a session with reliable UDP
+        - NSC_ReliableStatus* status : Receives the state of its reliable UDP
+    Output:
+        - int : 0 if the status was filled, -1 if the connection has no reliable UDP
+    */
+    int getReliableStatus(Client* connection, NSC_ReliableStatus* status);
+
+    /*
+    Parameters:
+        - Server* server : The server
+        - const char* path : The capture file to create (replaced if it exists)
+        - uint32_t bufferSize : Size of the buffer between serverListen and the writer (bytes, rounded up to a power of two, 0 : 4 MB)
+    Output:
+        - int : 0 if the recording started, -1 otherwise (already recording, file or thread error)
+    Description:
+        This function records the Connection, DataReceived and Disconnection events returned by serverListen
+        in a capture file (see NSC_CaptureRecord), to replay real traffic later (see examples/replay.c).
+        serverListen only copies the events to a buffer : a background thread writes them to the file,
+        through a memory mapping on Linux. The events that find the buffer full are dropped and counted in stats.recordDrops.
+        On Linux, link with -lpthread if the C library does not include it.
+    */
+    int nscRecordStart(Server* server, const char* path, uint32_t bufferSize);
+
+    /*
+    Parameters:
+        - Server* server : The server
+    Output:
+        - int : 0 if every event was written, -1 if events were dropped, the file could not be written or no recording was running
+    Description:
+        This function stops the recording once the buffered events are written, and closes the capture file.
+        closeServer stops it too.
+    */
+    int nscRecordStop(Server* server);
+
+    /*
+    Parameters:
+        - Server* server : The TCP server to configure
+        - int backlog : The length of the queue of pending connections (QueueLength by default)
+    Output:
+        - int : 0 on success, -1 otherwise
+    Description:
+        This function calls listen() again with the new backlog (Linux applies it, Windows keeps the first one).
+        The kernel also caps it (net.core.somaxconn on Linux).
+    */
+    int setServerBacklog(Server* server, int backlog);
+
+    /*
+    Parameters:
+        - Server* server : The TCP server to configure
+        - int acceptBudget : Maximum number of connections accepted per serverListen call (0 : no limit, AcceptBudget by default)
+        - int maxConnections : Number of connections from which new ones are not admitted (0 or more than the maximum : the maximum)
+        - int policy : AdmissionReject (default) or AdmissionDefer
+    Description:
+        This function sets how a server admits new connections.
+        The accept budget keeps a connection storm from delaying the established clients :
+        the connections over the budget are accepted in the next calls.
+        Over maxConnections, new connections are rejected (closed right away) or deferred (left in the
+        backlog, where the kernel refuses the new ones once it is full) until connections are closed.
+    */
+    void setServerAdmission(Server* server, int acceptBudget, int maxConnections, int policy);
+
+    /*
+    Parameters:
+        - Server* server : The TCP server to configure
+        - uint32_t frames : Maximum number of messages read from one connection per serverListen call (0 : no limit, ReadBudget by default)
+        - uint32_t bytes : Maximum number of bytes of messages read from one connection per serverListen call (0 : no limit, default)
+    Description:
+        This function sets the read budget of the server's connections, so that a client flooding messages
+        cannot hold a whole serverListen call while the others wait.
+        A connection that reaches its budget is read again in the next call, before poll() reports it
+        (the next poll() does not wait), which gives every busy connection its turn.
+        The byte budget is checked after each message, at least one message is read.
+    */
+    void setServerReadBudget(Server* server, uint32_t frames, uint32_t bytes);
+
+    /*
+    Parameters:
+        - Server* server : The server to configure
+        - uint32_t connectionEvents : Maximum number of undelivered messages of one connection (0 : no limit)
+        - uint32_t connectionBytes : Maximum number of undelivered bytes of one connection (0 : no limit)
+        - uint32_t totalEvents : Maximum number of undelivered messages of all the connections (0 : no limit)
+        - uint64_t totalBytes : Maximum number of undelivered bytes of all the connections (0 : no limit)
+    Output:
+        - int : 0 if the limits are set, -1 otherwise
+    Description:
+        This function bounds the memory of the messages serverListen hands out : a DataReceived message is undelivered
+        from the serverListen call that returns it until nscFreeServerEvents frees its list (which can run on another thread).
+        A connection at its limit, or every connection once a total limit is reached, is not read anymore :
+        its data waits in the kernel, then TCP makes the sender wait. Its reading resumes in the first serverListen call
+        after the application freed enough messages (the call may wait for pollTimeout if the lists are freed meanwhile).
+        A UDP server stops reading its socket at the total limits (the kernel drops the datagrams that do not fit),
+        the limits of one connection apply to stream connections only.
+        The limits are checked before each message is read, a connection can go over them by one message.
+        The lists of a server with flow control must be freed with nscFreeServerEvents, all zeros disables the limits.
+    */
+    int setServerFlowControl(Server* server, uint32_t connectionEvents, uint32_t connectionBytes, uint32_t totalEvents, uint64_t totalBytes);
+
+    /*
+    Parameters:
+        - Server* server : The server
+        - uint32_t connId : The connection (0 : all the connections)
+        - uint64_t* events : Set to the number of undelivered messages
+        - uint64_t* bytes : Set to the number of undelivered bytes
+    Output:
+        - int : 0 on success, -1 if the flow control is disabled or the connection is unknown
+    Description:
+        This function gives the messages handed out by serverListen and not freed yet (see setServerFlowControl).
+    */
+    int getFlowControlStatus(Server* server, uint32_t connId, uint64_t* events, uint64_t* bytes);
+
+    /*
+    Parameters:
+        - Server* server : The server
+    Output:
+        - int : 0 if the sends from other threads are enabled, -1 otherwise
+    Description:
+        This function gives each connection slot of the server a lock-free outbound queue, for sendAsyncMessage.
+        It is called by the server's thread, before other threads use sendAsyncMessage.
+    */
+    int enableServerAsyncSend(Server* server);
+
+    /*
+    Parameters:
+        - Server* server : The server (see enableServerAsyncSend)
+        - uint32_t connId : The connection (ServerEvent.connId)
+        - const char* msg : The message
+        - uint32_t len : Its length
+    Output:
+        - int : 0 if the message was queued, -1 otherwise
+    Description:
+        This function sends a message to a connection from any thread, without lock : the message is framed and pushed
+        on the connection's queue, and the thread of serverListen sends it (several messages per call with a vectored write).
+        The messages of one thread to one connection are sent in order, whole : they never interleave with the others.
+        On Linux the pushing thread wakes serverListen up, elsewhere the message goes at the latest after pollTimeout.
+        The messages to a connection that is closed meanwhile are dropped (stats.asyncDrops, when its slot is reused).
+        They are neither compressed nor sent in zero-copy, the server's allocator must be thread-safe (the default one is).
+        The other functions of a server stay for its thread only (sendClientMessage on a connection included).
+    */
+    int sendAsyncMessage(Server* server, uint32_t connId, const char* msg, uint32_t len);
+
+    /*
+    Parameters:
+        - Server* server : The server to configure
+        - uint32_t connectionFrames : Maximum number of messages per second of one connection (0 : no limit)
+        - uint32_t connectionBytes : Maximum number of bytes per second of one connection (0 : no limit)
+        - uint32_t totalFrames : Maximum number of messages per second of all the connections (0 : no limit)
+        - uint64_t totalBytes : Maximum number of bytes per second of all the connections (0 : no limit)
+        - int action : RateDelay, RateDrop or RateDisconnect
+    Output:
+        - int : 0 if the limits are set, -1 otherwise
+    Description:
+        This function limits the messages the server receives with token buckets, which hold one second of traffic :
+        a connection can send a burst of that size at once, then at the rate.
+        Each message received takes its tokens from the buckets of its connection and from the server's ones. Over its own limits,
+        the reading of a connection is delayed until the tokens are back (RateDelay, the data waits in the kernel,
+        then TCP makes the sender wait), its messages are dropped (RateDrop) or it is closed with a Disconnection event
+        (RateDisconnect). Over the server's limits, the reading of every connection is delayed whatever the action :
+        the connections within their own limits are neither dropped nor closed. The violations are counted in the statistics.
+        A delayed reading can go over the limits by one message.
+        A UDP server delays the reading of its socket on the server's limits (the kernel drops the datagrams that do not fit).
+        Its sessions share the socket, so the datagrams of a session over its own limits are dropped, with RateDelay too
+        (counted in rateDrops), or the session is closed (RateDisconnect). The packets of reliable sessions count too :
+        the dropped ones are sent again by the peer. All zeros disables the limits.
+    */
+    int setServerRateLimit(Server* server, uint32_t connectionFrames, uint32_t connectionBytes, uint32_t totalFrames, uint64_t totalBytes, int action);
+
+    /*
+    Parameters:
+        - char* address : The address of the client (UNIX : the socket's path, '@' first for the abstract namespace)
+        - int port : The port of the client (ignored in UNIX)
         - int connType : The connection type (TCP or UDP)
-        - int ipType : The IP type (IPv4 or IPv6)
+        - int ipType : The IP type (IPv4, IPv6 or UNIX)
     Output:
         - Client* : The client created with the given parameters (NULL if an error occurred)
     Description:
@@ -237,6 +895,20 @@ extern "C" {
     */
     Client* createClient(const char* address, int port, int connType, int ipType);
 
+    /*
+    Parameters:
+        - char* address : The address of the client (UNIX : the socket's path, '@' first for the abstract namespace)
+        - int port : The port of the client (ignored in UNIX)
+        - int connType : The connection type (TCP or UDP)
+        - int ipType : The IP type (IPv4, IPv6 or UNIX)
+        - const NSC_Options* options : The options of the client (NULL : defaults, maxClients is ignored)
+    Output:
+        - Client* : The client created with the given parameters (NULL if an error occurred)
+    Description:
+        This function creates a client like createClient, its socket configured with the options before connect().
+    */
+    Client* createClientEx(const char* address, int port, int connType, int ipType, const NSC_Options* options);
+
     /*
     Parameters:
         - Client* client : The client to close
@@ -255,14 +927,30 @@ extern "C" {
     */
     ClientEventsList* clientListen(Client* client);
 
+    /*
+    Parameters:
+        - ClientEventsList* eventsList : The list returned by clientListen
+    Description:
+        This function frees the list, its events and the data they received, with the client's allocator.
+        To keep the data of an event, set its data to NULL and release it later with client->allocator.
+        The data of SendComplete events belongs to the application and is not freed.
+    */
+    void nscFreeClientEvents(ClientEventsList* eventsList);
+
     /*
     Parameters:
         - SOCKET socket : The socket to send the data to
         - const char** msg : The buffer to which the data will be assigned
+    Output:
+        - int : The length of the message, or one of the READMSG_* codes
     Description:
         For a TCP connexion, read the message of the following format ->
         [length : 4 bytes][message]
-        and give the **msg the address of the message's buffer.
+        and give the **msg the address of the message's buffer (allocated with client->allocator).
+        Compressed messages (NSC_FRAME_COMPRESSED) are decompressed, a message compressed with a dictionary
+        needs the same dictionary on the connection (see enableCompression).
+        An incomplete message stays in the client's buffer and READMSG_NO_DATA is returned,
+        the next calls complete it when the rest arrives.
     */
     int readMessage(Client* client, char **out_msg);
 
@@ -273,24 +961,447 @@ extern "C" {
         - uint32_t len : The length of the data
         - int connType : The type of connection on which you want to send the data
         - SOCKADDR_IN* sin : The address to send the data to
+    Output:
+        - int : 0 if the whole message was sent, -1 otherwise (partial send or error)
     Description:
         This function sends the data to the given socket according to the type
         of connection you want. 
         In the case of UDP the length of the message
         is not send.
+        The sending is not counted in any statistics, use sendClientMessage for that.
+        In TCP it waits for room in the socket's buffer until the whole frame is sent (a server's connection is non-blocking).
+        It writes on the socket directly : on a server's connection, sendClientMessage (see getConnection) sends after
+        the bytes already queued and does not wait, it is the one to use once a connection has an outbound queue.
+        A connection using shared-memory rings (NSC_Options.sharedMemory) only takes its messages from sendClientMessage.
     */
-    void sendMessage(SOCKET* socket, const char *msg, uint32_t len, int connType, int ipType, SIN* sin);
+    int sendMessage(SOCKET* socket, const char *msg, uint32_t len, int connType, int ipType, SIN* sin);
+
+    /*
+    Parameters:
+        - Client* client : The connection to send the data on (a client or one of server->clients)
+        - const char *msg : The data you want to send
+        - uint32_t len : The length of the data
+    Output:
+        - int : 0 if the whole message was sent, -1 otherwise (partial send or error)
+    Description:
+        This function sends the data like sendMessage, using the connection's socket, type and address,
+        and updates the connection's statistics.
+        In TCP, what the socket cannot take right away is copied in the connection's outbound queue,
+        which serverListen / clientListen send when the socket becomes writable (see getQueuedBytes).
+        If compression is enabled on the connection (see enableCompression), messages of at least
+        its threshold are compressed, unless it does not make them smaller.
+        If zero-copy is enabled on the connection (see enableZeroCopy) and len is at least its threshold,
+        the message is sent without being copied : msg must stay valid and unchanged until
+        a SendComplete event with data == msg is received (or the connection is closed).
+    */
+    int sendClientMessage(Client* client, const char *msg, uint32_t len);
+
+    /*
+    Parameters:
+        - Client* client : The TCP connection (a client or one of server->clients, with NSC_Options.streamChunk set)
+        - int stream : The stream (0 to NSC_MAX_STREAMS - 1, 0 is the most urgent)
+        - const char *msg : The message
+        - uint32_t len : Its length (at most the peer's bufferSize - 4, like the other messages)
+    Output:
+        - int : 0 if the message was sent or queued, -1 otherwise
+    Description:
+        This function sends a message on a prioritized stream : it is cut in chunks of streamChunk bytes,
+        and each time the socket can take a chunk, it is taken from the most urgent stream with messages waiting.
+        A small message on stream 0 waits for one chunk at most, not for the large messages queued on the other streams.
+        The messages of a stream are delivered in order, with their stream in the event's channel.
+        Both ends announce the streams when the connection opens : until the peer's announce is received,
+        or if the peer does not read streams, the message is sent like sendClientMessage (on stream 0).
+        Streamed messages are neither compressed nor sent in zero-copy, the ones of sendClientMessage go before the chunks waiting.
+    */
+    int sendStreamMessage(Client* client, int stream, const char *msg, uint32_t len);
+
+    /*
+    Parameters:
+        - Client* client : The TCP connection to send the file on (a client or one of server->clients)
+        - int fd : The file descriptor of the file to send
+        - int64_t offset : The offset of the first byte to send in the file
+        - uint32_t len : The number of bytes to send, which is the length of the message (at most the peer's bufferSize - 4, like the other messages)
+    Output:
+        - int : 0 if the message was sent or queued, -1 otherwise (the file is shorter than offset + len for example)
+    Description:
+        This function sends len bytes of a file as one message : [length : 4 bytes][file's bytes].
+        On Linux the body goes from the page cache to the socket with sendfile(), without being copied
+        in user space; elsewhere it is read and sent by chunks.
+        The message goes through the connection's outbound queue : what the socket cannot take right away
+        is sent by serverListen / clientListen when it becomes writable, without blocking the other connections.
+        The file descriptor is duplicated, the caller can close it right away,
+        but the file must not be truncated until it is sent.
+    */
+    int sendFileMessage(Client* client, int fd, int64_t offset, uint32_t len);
+
+    /*
+    Parameters:
+        - Client* client : The connection to send a message on (a client or one of server->clients)
+        - uint32_t maxLen : The maximum length of the message
+    Output:
+        - char* : Room for maxLen bytes to write the message in (NULL if an error occurred)
+    Description:
+        This function hands out a buffer of the connection's outbound queue, right after the room of the message's header,
+        so that a serializer writes the message once : nscSendCommit sends the header and the message in one call,
+        and what the socket cannot take stays in this buffer instead of being copied in the queue.
+        The buffers are recycled, a connection that keeps sending does not allocate.
+        The message must be committed before any other call on the connection, a new reservation replaces an uncommitted one.
+    */
+    char* nscSendReserve(Client* client, uint32_t maxLen);
+
+    /*
+    Parameters:
+        - Client* client : The connection
+        - uint32_t len : The length of the message written in the reserved buffer (at most maxLen)
+    Output:
+        - int : 0 if the message was sent or queued, -1 otherwise
+    Description:
+        This function sends the message written in the buffer given by nscSendReserve, like sendClientMessage
+        (compressed if it reaches the compression threshold, never in zero-copy mode : the buffer belongs to the connection).
+    */
+    int nscSendCommit(Client* client, uint32_t len);
+
+    /*
+    Parameters:
+        - Client* client : The connection (a client or one of server->clients)
+    Output:
+        - uint64_t : The number of bytes waiting in the connection's outbound queue (and in its streams)
+    */
+    uint64_t getQueuedBytes(Client* client);
+
+    /*
+    Parameters:
+        - Client* client : The TCP connection (a client or one of server->clients)
+        - uint32_t threshold : Messages of at least this size are sent in zero-copy mode (0 : disable)
+    Output:
+        - int : 0 on success, -1 if zero-copy is not supported (it needs Linux 4.14+)
+    Description:
+        This function enables the zero-copy mode (MSG_ZEROCOPY) for the large messages sent with sendClientMessage.
+        The kernel then sends directly from the application's buffer and reports when it is done with it,
+        which serverListen / clientListen surface as SendComplete events.
+        It saves the copy of the payload, which only pays off for large messages (typically > 10 KB).
+    */
+    int enableZeroCopy(Client* client, uint32_t threshold);
+
+    /*
+    Parameters:
+        - Server* server : The server
+        - uint32_t threshold : Zero-copy threshold of the server's connections (0 : disable)
+    Description:
+        This function calls enableZeroCopy on every connected client and on the clients accepted later.
+    */
+    void setServerZeroCopy(Server* server, uint32_t threshold);
+
+    /*
+    Parameters:
+        - const char* data : The content of the dictionary (typical messages, common keys...)
+        - uint32_t len : Its length (only the last 65535 bytes are used)
+    Output:
+        - NSC_Dictionary* : The dictionary (NULL if an error occurred)
+    Description:
+        This function creates a compression dictionary that both ends of a connection share.
+        Small messages have little to compress by themselves, with a dictionary they can
+        reference its content, which must be identical on both ends (its id is checked).
+        The dictionary must outlive the connections that use it.
+    */
+    NSC_Dictionary* nscCreateDictionary(const char* data, uint32_t len);
+
+    /*
+    Parameters:
+        - NSC_Dictionary* dictionary : The dictionary to free
+    */
+    void nscFreeDictionary(NSC_Dictionary* dictionary);
+
+    /*
+    Parameters:
+        - Client* client : The TCP connection (a client or one of server->clients)
+        - uint32_t threshold : Messages of at least this size are compressed (0 : messages are not compressed)
+        - NSC_Dictionary* dictionary : The dictionary to compress and decompress with (NULL : none)
+    Output:
+        - int : 0 on success, -1 otherwise (UDP or allocation failure)
+    Description:
+        This function enables the compression of the messages sent with sendClientMessage,
+        with a built-in LZ codec (LZ4 block format) : fast, for text-like payloads.
+        Compressed messages are flagged in their length header, any NSC connection decompresses them,
+        but the messages compressed with a dictionary need it on the receiving connection too
+        (a threshold of 0 with a dictionary only sets it for the reception).
+    */
+    int enableCompression(Client* client, uint32_t threshold, NSC_Dictionary* dictionary);
+
+    /*
+    Parameters:
+        - Server* server : The server
+        - uint32_t threshold : Compression threshold of the server's connections (0 : disable)
+        - NSC_Dictionary* dictionary : The dictionary of the server's connections (NULL : none)
+    Description:
+        This function calls enableCompression on every connected client and on the clients accepted later.
+    */
+    void setServerCompression(Server* server, uint32_t threshold, NSC_Dictionary* dictionary);
+
+    /*
+    Parameters:
+        - Server* server : The server to read the statistics of
+    Output:
+        - NSC_Stats : Snapshot of the server's statistics (its own counters plus the ones of every connected client)
+    Description:
+        This function returns the statistics of the whole server.
+        Counters are summed, peakBufferUsage is the highest of all the connections.
+        Per-connection counters can be read with getClientStats(&server->clients[i]).
+    */
+    NSC_Stats getServerStats(Server* server);
+
+    /*
+    Parameters:
+        - Client* client : The client to read the statistics of
+    Output:
+        - NSC_Stats : Snapshot of the client's statistics
+    */
+    NSC_Stats getClientStats(Client* client);
+
+    /*
+    Output:
+        - uint64_t : The current time of a monotonic clock, in nanoseconds
+    */
+    uint64_t nscMonotonicNs();
+
+    /*
+    Parameters:
+        - NSC_TimerWheel* wheel : The wheel to initialize
+    Description:
+        This function initializes an empty timer wheel.
+        A server has its own wheel (server->timers), run by serverListen.
+    */
+    void nscTimerWheelInit(NSC_TimerWheel* wheel);
+
+    /*
+    Parameters:
+        - NSC_Timer* timer : The timer to initialize
+        - void (*callback)(NSC_Timer* timer, void* context) : Function called when the timer expires
+        - void* context : Pointer given back to the callback
+    Description:
+        This function initializes a timer, which must stay at the same address while it is scheduled.
+    */
+    void nscTimerInit(NSC_Timer* timer, void (*callback)(NSC_Timer* timer, void* context), void* context);
+
+    /*
+    Parameters:
+        - NSC_TimerWheel* wheel : The wheel on which the timer is scheduled
+        - NSC_Timer* timer : The timer to schedule (rescheduled if already scheduled)
+        - uint32_t delay : Delay before the expiration, in ms
+    Description:
+        This function schedules a timer in O(1). The callback is called once by nscTimerWheelAdvance after the delay.
+        A callback can schedule or cancel any timer, including its own.
+    */
+    void nscTimerSchedule(NSC_TimerWheel* wheel, NSC_Timer* timer, uint32_t delay);
+
+    /*
+    Parameters:
+        - NSC_Timer* timer : The timer to cancel
+    Description:
+        This function cancels a scheduled timer in O(1) (nothing happens if it is not scheduled).
+    */
+    void nscTimerCancel(NSC_Timer* timer);
+
+    /*
+    Parameters:
+        - const NSC_Timer* timer : The timer to check
+    Output:
+        - int : 1 if the timer is scheduled, 0 otherwise
+    */
+    int nscTimerPending(const NSC_Timer* timer);
+
+    /*
+    Parameters:
+        - NSC_TimerWheel* wheel : The wheel to advance
+    Output:
+        - int : The number of timers that expired
+    Description:
+        This function advances the wheel up to the current time and calls the callbacks of the expired timers.
+        serverListen calls it for server->timers.
+    */
+    int nscTimerWheelAdvance(NSC_TimerWheel* wheel);
+
+    /*
+    Parameters:
+        - NSC_TimerWheel* wheel : The wheel to check
+        - int maxTimeout : The highest value to return (ms)
+    Output:
+        - int : The time (ms) until the next timer may expire, at most maxTimeout
+    Description:
+        This function gives the timeout to wait for in poll() so that the next timer is not late.
+        It can return a shorter time than the actual expiration (when a higher level of the wheel has to be cascaded).
+    */
+    int nscTimerWheelNextTimeout(NSC_TimerWheel* wheel, int maxTimeout);
+
+    /*
+    Parameters:
+        - int enabled : 1 to enable the tracing, 0 to disable it
+    Description:
+        This function enables or disables the tracing of the received messages (disabled by default).
+        When enabled, every DataReceived event carries the timestamps of its reception (event.trace)
+        and the durations of the stages (see NSC_TraceStage) are recorded in process-wide lock-free histograms.
+    */
+    void nscTraceEnable(int enabled);
+
+    /*
+    Parameters:
+        - const NSC_EventTrace* trace : The trace of an event the application has finished handling
+    Description:
+        This function records the Handler stage of an event (from its delivery to now).
+        It does nothing if the event was not traced.
+    */
+    void nscTraceHandled(const NSC_EventTrace* trace);
+
+    /*
+    Parameters:
+        - NSC_TraceHistogram* histograms : Array of StageCount histograms, filled with the current values (indexed by NSC_TraceStage)
+        - int reset : 1 to reset the histograms after reading them
+    Description:
+        This function exports the tracing histograms, to be sent to a monitoring system for example.
+        It can be called from any thread.
+    */
+    void nscGetTraceHistograms(NSC_TraceHistogram* histograms, int reset);
+
+    /*
+    Parameters:
+        - void (*hook)(const NSC_EventTrace* trace, int fromServer, void* context) : Function called for every traced message (NULL to remove it)
+        - void* context : Pointer given back to the hook
+    Description:
+        This function sets a hook called with the trace of each received message when its events list is delivered,
+        to export individual traces (to a tracer for example).
+        The hook runs inside serverListen / clientListen, it should be fast.
+    */
+    void nscSetTraceHook(void (*hook)(const NSC_EventTrace* trace, int fromServer, void* context), void* context);
+
+    // RPC channel over a client's connection (see nscRpcCreate)
+    typedef struct NSC_Rpc NSC_Rpc;
+
+    // Completion of an RPC call : status is RPC_OK (response valid until the function returns), RPC_TIMEOUT or RPC_CLOSED
+    typedef void (*NSC_RpcCallback)(uint32_t id, int status, const char* response, uint32_t len, void* context);
+
+    /*
+    Parameters:
+        - Client* client : The TCP client the requests are sent on
+    Output:
+        - NSC_Rpc* : The RPC channel (NULL if an error occurred)
+    Description:
+        This function creates an RPC channel on a client : any number of requests can be in flight,
+        each message carries its request id and the responses are matched in any order.
+        The client then carries RPC messages only and is read by nscRpcPoll / nscRpcWait instead of clientListen.
+        The server reads the requests as DataReceived events (see nscRpcParseRequest) and answers with nscRpcRespond.
+    */
+    NSC_Rpc* nscRpcCreate(Client* client);
+
+    /*
+    Parameters:
+        - NSC_Rpc* rpc : The RPC channel to destroy
+    Description:
+        This function completes the pending calls with RPC_CLOSED and frees the channel (not the client).
+    */
+    void nscRpcDestroy(NSC_Rpc* rpc);
+
+    /*
+    Parameters:
+        - NSC_Rpc* rpc : The RPC channel
+        - const char* request : The request
+        - uint32_t len : The length of the request
+        - uint32_t timeoutMs : Deadline of the call (0 : none)
+        - NSC_RpcCallback callback : Function called on completion, NULL to wait for it with nscRpcWait
+        - void* context : Pointer given back to the callback
+    Output:
+        - uint32_t : The id of the request, 0 if it could not be sent
+    Description:
+        This function sends a request without waiting for its response.
+        The callbacks are called by nscRpcPoll / nscRpcWait.
+    */
+    uint32_t nscRpcCall(NSC_Rpc* rpc, const char* request, uint32_t len, uint32_t timeoutMs, NSC_RpcCallback callback, void* context);
+
+    /*
+    Parameters:
+        - NSC_Rpc* rpc : The RPC channel
+        - int timeoutMs : Maximum wait for a response (ms, 0 : no wait)
+    Output:
+        - int : The number of calls completed, RPC_CLOSED if the connection is closed
+    Description:
+        This function reads the responses received, expires the calls past their deadline and sends the queued requests.
+        The messages that are not RPC responses are dropped : the connection carries RPC traffic only (see nscRpcCreate).
+    */
+    int nscRpcPoll(NSC_Rpc* rpc, int timeoutMs);
+
+    /*
+    Parameters:
+        - NSC_Rpc* rpc : The RPC channel
+        - uint32_t id : The id of a call made without callback
+        - char** response : Receives the response (to release by the caller with client->allocator, NULL if the call failed)
+        - uint32_t* len : Receives the length of the response
+    Output:
+        - int : RPC_OK, RPC_TIMEOUT, RPC_CLOSED or RPC_UNKNOWN
+    Description:
+        This function blocks until the call completes, completing the other calls meanwhile.
+    */
+    int nscRpcWait(NSC_Rpc* rpc, uint32_t id, char** response, uint32_t* len);
+
+    /*
+    Parameters:
+        - NSC_Rpc* rpc : The RPC channel
+    Output:
+        - uint32_t : The number of calls sent and not completed yet
+    */
+    uint32_t nscRpcInFlight(NSC_Rpc* rpc);
+
+    /*
+    Parameters:
+        - const char* data : A message received (data of a DataReceived event)
+        - uint32_t len : Its length
+        - uint32_t* id : Receives the id of the request
+        - const char** payload : Receives the address of the request in data
+        - uint32_t* payloadLen : Receives the length of the request
+    Output:
+        - int : 0 if the message is an RPC request, -1 otherwise
+    */
+    int nscRpcParseRequest(const char* data, uint32_t len, uint32_t* id, const char** payload, uint32_t* payloadLen);
+
+    /*
+    Parameters:
+        - Client* connection : The connection the request came from (one of server->clients)
+        - uint32_t id : The id of the request
+        - const char* response : The response
+        - uint32_t len : The length of the response
+    Output:
+        - int : 0 if the response was sent or queued, -1 otherwise
+    Description:
+        This function answers a request, in any order : the client matches the response with its id.
+    */
+    int nscRpcRespond(Client* connection, uint32_t id, const char* response, uint32_t len);
 
     /*
     Parameters:
         - const char* domainName : The domain name to resolve
     Output:
-        - char* : The IP address of the domain name (caller must free the returned string)
+        - char* : The IP address of the domain name (caller must free the returned string with nscFree)
     Description:
         This function resolves a domain name and returns the associated IP address.
     */
     char* resolveDomainName(const char* domainName);
 
+    /*
+    Parameters:
+        - const NSC_Allocator* allocator : The allocator to use (copied, NULL : malloc / realloc / free)
+    Description:
+        This function sets the allocator of the servers and clients created afterwards without one in their options,
+        and of the memory that belongs to no instance (resolveDomainName, dictionaries).
+        Call it before creating anything : memory is released with the allocator that gave it.
+    */
+    void nscSetAllocator(const NSC_Allocator* allocator);
+
+    /*
+    Parameters:
+        - void* memory : Memory returned by resolveDomainName (can be NULL)
+    Description:
+        This function releases memory with the allocator set by nscSetAllocator.
+    */
+    void nscFree(void* memory);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,102 +1,3813 @@
+// accept4() is a GNU extension
+#if defined (__linux__) && !defined (_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "NSC.h"
 
-Server* createServer(const char* address, int port, int connType, int ipType) {
-    Server* server = (Server*)malloc(sizeof(Server)); // Create the server's structure
+// Kernel structures of the socket's error queue (zero-copy completions and timestamps), private to the library
+#if defined (__linux__)
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#endif
+
+// System headers of the implementation only
+#if defined (_WIN32)
+#include <io.h>
+#elif defined (__linux__)
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#endif
+
+// poll() is named WSAPoll() on Windows
+#if defined (_WIN32)
+#define pollSockets(fds, numFds, timeout) WSAPoll(fds, numFds, timeout)
+#else
+#define pollSockets(fds, numFds, timeout) poll(fds, numFds, timeout)
+#endif
+
+// File descriptors' functions are prefixed on Windows
+#if defined (_WIN32)
+#define dupFile(fd) _dup(fd)
+#define closeFile(fd) _close(fd)
+#else
+#define dupFile(fd) dup(fd)
+#define closeFile(fd) close(fd)
+#endif
+
+// Size of a file (-1 on error)
+#if defined (_WIN32)
+#define fileSize(fd) _filelengthi64(fd)
+#else
+static int64_t fileSize(int fd) {
+    struct stat info;
+    return (fstat(fd, &info) == 0) ? (int64_t)info.st_size : -1;
+}
+#endif
+
+// Zero-copy sending (Linux 4.14+) and socket options, defined here for older headers
+#if defined (__linux__)
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+#ifndef TCP_FASTOPEN_CONNECT
+#define TCP_FASTOPEN_CONNECT 30
+#endif
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#endif
+
+// A message sent in zero-copy mode, whose buffer is still referenced by the kernel
+typedef struct {
+    const char* buffer;
+    uint32_t len;
+    uint32_t firstId; // Ids of the zero-copy send() calls of the message (the kernel counts them per socket)
+    uint32_t lastId;
+    uint32_t completed; // Number of those ids the kernel has completed
+} ZeroCopySend;
+
+// Zero-copy sending state of a connection
+struct NSC_ZeroCopy {
+    uint32_t threshold; // Minimum size of the messages sent in zero-copy mode (0 : disabled)
+    uint32_t nextId; // Id of the next zero-copy send() call
+    ZeroCopySend* pending; // Messages not completed yet, in sending order
+    int numPending;
+    int capacity;
+    int numCompleted; // Pending messages already completed, to be reported
+};
+
+// A send timestamp read from a socket's error queue
+typedef struct {
+    uint32_t id; // Id of the send (SOF_TIMESTAMPING_OPT_ID, from 1)
+    uint64_t kernelTime; // Monotonic (ns)
+    uint64_t hardwareTime; // NIC's clock (ns)
+} TimestampEntry;
+
+// Send timestamps of a connection not reported yet (see NSC_TIMESTAMP_TX)
+#define NSC_MAX_SEND_TIMESTAMPS 4096 // Kept until the next serverListen / clientListen, the next ones are dropped
+struct NSC_SendTimestamps {
+    TimestampEntry* entries;
+    int count;
+    int capacity;
+};
+
+// A piece of data of a connection's outbound queue
+typedef struct OutSegment {
+    struct OutSegment* next;
+    int fd; // File the bytes are sent from (duplicated), -1 for the bytes stored in data
+    int64_t offset; // Offset of the next byte to send (in the file or in data)
+    uint32_t len; // Number of bytes left to send
+    uint32_t capacity; // Size of data
+    int endsFrame; // 1 if the segment ends a message
+    char data[]; // Bytes to send (fd == -1)
+} OutSegment;
+
+// Outbound queue of a connection, sent in order when the socket is writable
+struct NSC_OutQueue {
+    OutSegment* head;
+    OutSegment* tail;
+    uint64_t queuedBytes; // Bytes left to send in the queue
+    OutSegment* reserved; // Segment handed out by nscSendReserve, not committed yet
+    uint32_t reservedLen; // Maximum length of the reserved message
+    OutSegment* spare; // Sent segment kept for the next message, instead of an allocation
+};
+
+#define outQueuePending(client) ((client)->extension->outQueue != NULL && (client)->extension->outQueue->head != NULL)
+
+// Free receive buffers of a server, lent to its connections while they have pending data
+struct NSC_BufferPool {
+    int numFree;
+    char* buffers[BufferPoolSize];
+};
+
+// LZ codec (LZ4 block format) : hash table of 2^LZ_HASH_BITS positions, matches of 4+ bytes up to 64 KB back
+#define LZ_HASH_BITS 12
+#define LZ_HASH_SIZE (1 << LZ_HASH_BITS)
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+
+// A client created by createClientEx, with the allocator its connection uses and its statistics
+typedef struct {
+    Client client;
+    NSC_Allocator allocator;
+    NSC_Stats stats;
+} StandaloneClient;
+
+// Shared compression dictionary, with its hash table computed once
+struct NSC_Dictionary {
+    uint8_t* data;
+    uint32_t len;
+    uint32_t id; // Hash of the content, sent in the messages to check both ends use the same dictionary
+    uint32_t table[LZ_HASH_SIZE]; // Positions (+1) of the dictionary's 4 bytes sequences
+    NSC_Allocator allocator; // Allocator the dictionary was created with
+};
+
+// Compression settings of a connection
+struct NSC_Compression {
+    uint32_t threshold; // Minimum size of the messages compressed (0 : none)
+    NSC_Dictionary* dictionary; // Dictionary used in both directions (NULL : none)
+    uint8_t* scratch; // Buffer of the compressed frames
+    uint32_t scratchSize;
+};
+
+// Slots of a server's connection ids (one per possible connection)
+struct NSC_ConnectionIds {
+    int* index; // Index in clients of the connection holding each slot (-1 : free)
+    uint16_t* generation; // Generation of each slot, changed when its connection disconnects
+    int* freeSlots; // Stack of the free slots
+    int numFree;
+};
+
+// Messages handed out by a server's serverListen and not freed yet (see setServerFlowControl)
+// The counters are atomic (the lists can be freed by another thread than the server's one) and read as signed :
+// the messages of an old connection freed after its slot was reset can take them below zero
+struct NSC_FlowControl {
+    uint64_t totalEvents;
+    uint64_t totalBytes;
+    uint64_t* events; // Counters of each slot of connection id
+    uint64_t* bytes;
+    uint64_t* ids; // Connection id the counters of each slot belong to
+    uint32_t numSlots;
+};
+
+// A publish/subscribe topic and its subscribers
+typedef struct NSC_Topic {
+    struct NSC_Topic* next; // Next topic of the bucket
+    uint32_t hash;
+    uint32_t* subscribers; // Connection ids of the subscribers
+    uint32_t numSubscribers;
+    uint32_t capacity;
+    char* name;
+} NSC_Topic;
+
+// Topics of a server (hash table by name)
+#define TOPIC_BUCKETS 64 // Initial number of buckets, doubled when there are more topics than buckets
+struct NSC_Topics {
+    NSC_Topic** buckets;
+    uint32_t numBuckets;
+    uint32_t numTopics;
+    char* frame; // Buffer of the published frames
+    uint32_t frameSize;
+    const NSC_Allocator* allocator; // The server's allocator
+};
+
+// Topics a connection is subscribed to (removed from them on disconnection)
+struct NSC_Subscriptions {
+    NSC_Topic** topics;
+    int numTopics;
+    int capacity;
+};
+
+// Sessions of a UDP server : connection ids by peer address, open addressing with linear probing
+struct NSC_UdpSessions {
+    uint32_t* ids; // Connection id of the session of each entry (0 : empty)
+    uint32_t* hashes; // Hash of the peer address of each entry
+    uint32_t mask; // Number of entries - 1 (a power of two, at least twice maxClients)
+};
+
+// Control block of a shared-memory ring (single producer, single consumer), each side's fields on its own cache line
+typedef struct {
+    uint64_t head; // Bytes consumed, written by the consumer
+    uint32_t producerWaiting; // 1 : the ring was full, the consumer rings the doorbell once it made room
+    char padding1[52];
+    uint64_t tail; // Bytes produced, written by the producer
+    uint32_t consumerWaiting; // 1 : the consumer sleeps in poll(), the producer rings the doorbell once it wrote
+    char padding2[52];
+} NSC_RingControl;
+
+// Shared memory of a connection : [control server -> client][control client -> server] then, from RING_DATA_OFFSET,
+// [data server -> client][data client -> server]. The UNIX socket carries the doorbells (one byte) and the disconnection
+#define RING_DATA_OFFSET 4096
+#define RING_MIN_SIZE 4096
+#define RING_MAX_SIZE (1 << 30)
+#define RING_MAGIC 0x4E53434D // "NSCM", offer of the shared memory sent by the server with its file descriptor
+struct NSC_SharedRing {
+    uint8_t* memory;
+    size_t mapSize;
+    NSC_RingControl* rx; // Ring read by this side
+    uint8_t* rxData;
+    NSC_RingControl* tx; // Ring written by this side
+    uint8_t* txData;
+    uint32_t size; // Size of each ring (power of two)
+    int spin; // NSC_Options.ringSpin
+    int checkSocket; // 1 once poll() reported the socket : doorbells or the disconnection are to be read
+};
+
+// Rarely used states of a connection (NULL when disabled), allocated with the first of them (see clientExtension)
+struct NSC_ClientExtension {
+    struct NSC_ZeroCopy* zeroCopy; // Zero-copy sending state
+    struct NSC_OutQueue* outQueue; // Data waiting for the socket to be writable (TCP, NULL until first needed)
+    struct NSC_Compression* compression; // Compression settings
+    struct NSC_Subscriptions* subscriptions; // Topics the connection is subscribed to
+    struct NSC_SharedRing* ring; // Shared-memory rings of the connection (NULL : the data goes through the socket)
+    struct NSC_Reliable* reliable; // Reliable UDP state (NULL : plain datagrams)
+    struct NSC_SendTimestamps* sendTimestamps; // Send timestamps read from the error queue and not reported yet
+    struct NSC_Streams* streams; // Prioritized streams (see NSC_Options.streamChunk)
+};
+
+// Extension of the connections that have none : its states are read as NULL, it is never written
+static struct NSC_ClientExtension noExtension;
+
+// The footprint of an idle connection documented in NSC.h : sizeof(Client) under 512 bytes on 64 bits systems
+typedef char clientSizeCheck[(sizeof(void*) < 8 || sizeof(Client) < 512) ? 1 : -1];
+
+// Statistics counters, compiled out with NSC_NO_STATS
+// (the arguments are then only type-checked : sizeof does not evaluate them, but they count as used)
+#ifndef NSC_NO_STATS
+#define statAdd(stats, field, value) ((stats).field += (value))
+#define statMax(stats, field, value) do { if ((uint64_t)(value) > (stats).field) (stats).field = (value); } while (0)
+#define statClock() nscMonotonicNs() // Start of a measured duration
+#else
+#define statAdd(stats, field, value) ((void)sizeof((stats).field += (value)))
+#define statMax(stats, field, value) ((void)sizeof((stats).field = (value)))
+#define statClock() 0
+#endif
+
+// Atomic operations on 64 bits counters (relaxed ordering), used by the lock-free tracing histograms
+// The acquire / release ones publish the data of a ring shared by two threads (see nscRecordStart),
+// or the messages pushed on a queue by other threads (see sendAsyncMessage)
+#if defined (_MSC_VER)
+#define atomicAdd64(target, value) InterlockedExchangeAdd64((volatile LONG64*)(target), (LONG64)(value))
+#define atomicLoad64(target) ((uint64_t)InterlockedCompareExchange64((volatile LONG64*)(target), 0, 0))
+#define atomicExchange64(target, value) ((uint64_t)InterlockedExchange64((volatile LONG64*)(target), (LONG64)(value)))
+#define atomicCas64(target, expected, value) (InterlockedCompareExchange64((volatile LONG64*)(target), (LONG64)(value), (LONG64)(expected)) == (LONG64)(expected))
+#define atomicLoadAcquire64(target) ((uint64_t)InterlockedCompareExchange64((volatile LONG64*)(target), 0, 0))
+#define atomicStoreRelease64(target, value) InterlockedExchange64((volatile LONG64*)(target), (LONG64)(value))
+#define atomicCasRelease64(target, expected, value) atomicCas64(target, expected, value)
+#define atomicExchangeAcquire64(target, value) atomicExchange64(target, value)
+#else
+#define atomicAdd64(target, value) __atomic_fetch_add(target, value, __ATOMIC_RELAXED)
+#define atomicLoad64(target) __atomic_load_n(target, __ATOMIC_RELAXED)
+#define atomicExchange64(target, value) __atomic_exchange_n(target, value, __ATOMIC_RELAXED)
+#define atomicCas64(target, expected, value) __atomic_compare_exchange_n(target, &(expected), value, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define atomicLoadAcquire64(target) __atomic_load_n(target, __ATOMIC_ACQUIRE)
+#define atomicStoreRelease64(target, value) __atomic_store_n(target, value, __ATOMIC_RELEASE)
+#define atomicCasRelease64(target, expected, value) __atomic_compare_exchange_n(target, &(expected), value, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)
+#define atomicExchangeAcquire64(target, value) __atomic_exchange_n(target, value, __ATOMIC_ACQUIRE)
+#endif
+
+// Tracing state, shared by every server and client of the process
+static volatile int traceEnabled = 0;
+static NSC_TraceHistogram traceHistograms[StageCount];
+static void (*traceHook)(const NSC_EventTrace* trace, int fromServer, void* context) = NULL;
+static void* traceHookContext = NULL;
+
+// Default allocator : the C library's functions
+static void* stdAllocate(size_t size, void* context) {
+    (void)context;
+    return malloc(size);
+}
+
+static void* stdReallocate(void* memory, size_t size, void* context) {
+    (void)context;
+    return realloc(memory, size);
+}
+
+static void stdRelease(void* memory, void* context) {
+    (void)context;
+    free(memory);
+}
+
+// Allocator of the instances created without one in their options, and of the memory that belongs to none
+static NSC_Allocator globalAllocator = { stdAllocate, stdReallocate, stdRelease, NULL };
+
+// Allocations through an NSC_Allocator* (memFree ignores NULL like free)
+#define memAlloc(allocator, size) ((allocator)->allocate((size), (allocator)->context))
+#define memRealloc(allocator, memory, size) ((allocator)->reallocate((memory), (size), (allocator)->context))
+#define memFree(allocator, memory) do { void* released = (memory); if (released != NULL) (allocator)->release(released, (allocator)->context); } while (0)
+
+static void* memCalloc(const NSC_Allocator* allocator, size_t count, size_t size) {
+    void* memory = memAlloc(allocator, count * size);
+    if (memory != NULL) memset(memory, 0, count * size);
+    return memory;
+}
+
+// The extension of a connection, allocated on its first state (NULL if the allocation failed)
+static struct NSC_ClientExtension* clientExtension(Client* client) {
+    if (client->extension == &noExtension) {
+        struct NSC_ClientExtension* extension = (struct NSC_ClientExtension*)memCalloc(client->allocator, 1, sizeof(struct NSC_ClientExtension));
+        if (!extension) return NULL;
+        client->extension = extension;
+        statAdd(*client->stats, allocations, 1);
+    }
+    return client->extension;
+}
+
+// Free the extension of a closed connection (its states already freed)
+static void freeExtension(Client* client) {
+    if (client->extension != &noExtension) memFree(client->allocator, client->extension);
+    client->extension = &noExtension;
+}
+
+// Returns 1 if the last socket call failed only because it would have blocked
+static int wouldBlock() {
+#if defined (_WIN32)
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EWOULDBLOCK || errno == EAGAIN;
+#endif
+}
+
+uint64_t nscMonotonicNs() {
+#if defined (_WIN32)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL
+        + (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/*
+    Parameters:
+        - int stage : The stage to record (NSC_TraceStage)
+        - uint64_t start : Start of the stage (0 if unknown)
+        - uint64_t end : End of the stage
+    Description:
+        This function adds the duration of a stage to its histogram, without lock.
+*/
+static void traceRecord(int stage, uint64_t start, uint64_t end) {
+    if (start == 0 || end < start) return;
+    uint64_t duration = end - start;
+    NSC_TraceHistogram* histogram = &traceHistograms[stage];
+
+    int bucket = 0;
+    while (bucket < NSC_TRACE_BUCKETS - 1 && (duration >> (bucket + 1)) != 0) bucket++;
+
+    atomicAdd64(&histogram->buckets[bucket], 1);
+    atomicAdd64(&histogram->count, 1);
+    atomicAdd64(&histogram->sumNs, duration);
+    uint64_t currentMax = atomicLoad64(&histogram->maxNs);
+    while (duration > currentMax) {
+        if (atomicCas64(&histogram->maxNs, currentMax, duration)) break;
+        currentMax = atomicLoad64(&histogram->maxNs);
+    }
+}
+
+/*
+    Parameters:
+        - NSC_EventTrace* trace : The trace of the new event
+        - uint64_t pollStart : When poll() was called (0 when tracing is disabled or for non-data events)
+        - uint64_t readable : When poll() returned
+        - uint64_t bytesRead : When the recv() that completed the message returned
+    Description:
+        This function initializes the trace of a new event, the message being complete now.
+*/
+static void traceEvent(NSC_EventTrace* trace, uint64_t pollStart, uint64_t readable, uint64_t bytesRead) {
+    trace->pollStart = pollStart;
+    trace->readable = readable;
+    trace->bytesRead = bytesRead;
+    trace->frameComplete = (pollStart != 0) ? nscMonotonicNs() : 0;
+    trace->delivered = 0;
+    trace->kernelTime = 0;
+    trace->hardwareTime = 0;
+}
+
+// Set the kernel timestamps of an event (see NSC_TIMESTAMP_RX)
+static void traceKernel(NSC_EventTrace* trace, uint64_t kernelTime, uint64_t hardwareTime) {
+    trace->kernelTime = kernelTime;
+    trace->hardwareTime = hardwareTime;
+}
+
+/*
+    Parameters:
+        - NSC_EventTrace* trace : The trace of an event about to be returned to the application
+        - uint64_t delivered : The time of the delivery
+        - int fromServer : 1 if the event comes from serverListen, 0 from clientListen
+    Description:
+        This function completes the trace of a traced event and records its stages.
+*/
+static void traceDeliver(NSC_EventTrace* trace, uint64_t delivered, int fromServer) {
+    if (trace->frameComplete == 0) return; // Not traced
+    trace->delivered = delivered;
+    traceRecord(StageWait, trace->pollStart, trace->readable);
+    traceRecord(StageRecv, trace->readable, trace->bytesRead);
+    traceRecord(StageParse, trace->bytesRead, trace->frameComplete);
+    traceRecord(StageBuild, trace->frameComplete, trace->delivered);
+    traceRecord(StageQueue, trace->kernelTime, trace->bytesRead);
+    void (*hook)(const NSC_EventTrace*, int, void*) = traceHook;
+    if (hook != NULL) hook(trace, fromServer, traceHookContext);
+}
+
+/*
+    Parameters:
+        - NSC_Stats* total : The statistics to add to
+        - const NSC_Stats* stats : The statistics to add
+    Description:
+        This function adds the counters of stats to total (peakBufferUsage keeps the highest value).
+*/
+static void addStats(NSC_Stats* total, const NSC_Stats* stats) {
+    total->bytesIn += stats->bytesIn;
+    total->bytesOut += stats->bytesOut;
+    total->framesIn += stats->framesIn;
+    total->framesOut += stats->framesOut;
+    total->recvCalls += stats->recvCalls;
+    total->sendCalls += stats->sendCalls;
+    total->pollCalls += stats->pollCalls;
+    total->acceptCalls += stats->acceptCalls;
+    total->rejectedConnections += stats->rejectedConnections;
+    total->acceptBudgetHits += stats->acceptBudgetHits;
+    total->readBudgetHits += stats->readBudgetHits;
+    total->eagainHits += stats->eagainHits;
+    total->resyncBytes += stats->resyncBytes;
+    total->oversizeDrops += stats->oversizeDrops;
+    total->partialSends += stats->partialSends;
+    total->allocations += stats->allocations;
+    if (stats->peakBufferUsage > total->peakBufferUsage) total->peakBufferUsage = stats->peakBufferUsage;
+    total->zeroCopySends += stats->zeroCopySends;
+    total->zeroCopyCopied += stats->zeroCopyCopied;
+    total->compressedFrames += stats->compressedFrames;
+    total->compressInput += stats->compressInput;
+    total->compressOutput += stats->compressOutput;
+    total->compressSkipped += stats->compressSkipped;
+    total->compressNs += stats->compressNs;
+    total->decompressedFrames += stats->decompressedFrames;
+    total->decompressNs += stats->decompressNs;
+    total->decompressErrors += stats->decompressErrors;
+    total->retransmits += stats->retransmits;
+    total->injectedLosses += stats->injectedLosses;
+    total->recordDrops += stats->recordDrops;
+    total->flowPauses += stats->flowPauses;
+    total->asyncDrops += stats->asyncDrops;
+    total->rateDelays += stats->rateDelays;
+    total->rateDrops += stats->rateDrops;
+    total->rateDisconnects += stats->rateDisconnects;
+}
+
+/*
+    Parameters:
+        - SOCKET socket : A connected stream socket, or a datagram socket
+        - int flags : The NSC_TIMESTAMP_* flags to enable
+        - int ipType : The IP type of the socket
+    Output:
+        - int : The flags enabled (0 if the socket does not support SO_TIMESTAMPING)
+    Description:
+        This function enables the kernel timestamps of a socket. The send timestamps are numbered (SOF_TIMESTAMPING_OPT_ID)
+        from the moment the option is set, a stream socket must be connected for them.
+*/
+static int enableTimestamping(SOCKET socket, int flags, int ipType) {
+#if defined (__linux__)
+    if (ipType == UNIX || !(flags & (NSC_TIMESTAMP_RX | NSC_TIMESTAMP_TX))) return 0;
+    int value = SOF_TIMESTAMPING_SOFTWARE;
+    if (flags & NSC_TIMESTAMP_RX) value |= SOF_TIMESTAMPING_RX_SOFTWARE;
+    if (flags & NSC_TIMESTAMP_TX) value |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    if (flags & NSC_TIMESTAMP_HARDWARE) {
+        value |= SOF_TIMESTAMPING_RAW_HARDWARE;
+        if (flags & NSC_TIMESTAMP_RX) value |= SOF_TIMESTAMPING_RX_HARDWARE;
+        if (flags & NSC_TIMESTAMP_TX) value |= SOF_TIMESTAMPING_TX_HARDWARE;
+    }
+    if (setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPING, &value, sizeof(value)) != 0) return 0;
+    return flags & (NSC_TIMESTAMP_RX | NSC_TIMESTAMP_TX | NSC_TIMESTAMP_HARDWARE);
+#else
+    (void)socket;
+    (void)flags;
+    (void)ipType;
+    return 0;
+#endif
+}
+
+#if defined (__linux__)
+// A software timestamp of the kernel (CLOCK_REALTIME) on the monotonic clock of the traces
+static uint64_t kernelToMonotonic(const struct timespec* stamp) {
+    if (stamp->tv_sec == 0 && stamp->tv_nsec == 0) return 0;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t age = ((int64_t)now.tv_sec - stamp->tv_sec) * 1000000000LL + (now.tv_nsec - stamp->tv_nsec);
+    return nscMonotonicNs() - age;
+}
+
+// Read the SO_TIMESTAMPING timestamps of a message's control data (unchanged if it has none)
+static void readTimestamps(struct msghdr* message, uint64_t* kernelTime, uint64_t* hardwareTime) {
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(message); cmsg != NULL; cmsg = CMSG_NXTHDR(message, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING) continue;
+        struct scm_timestamping stamps;
+        memcpy(&stamps, CMSG_DATA(cmsg), sizeof(stamps));
+        *kernelTime = kernelToMonotonic(&stamps.ts[0]);
+        *hardwareTime = (uint64_t)stamps.ts[2].tv_sec * 1000000000ULL + (uint64_t)stamps.ts[2].tv_nsec;
+    }
+}
+#endif
+
+/*
+    Parameters:
+        - SOCKET socket : The socket to read
+        - char* buffer : Where to copy the data
+        - uint32_t len : Its size
+        - SIN* from : Receives the address of the sender (NULL for a connected socket)
+        - socklen_t* fromLen : Size of from, receives the length of the address (NULL with from)
+        - uint64_t* kernelTime : Receives the kernel's reception timestamp (monotonic, ns), when data was received
+        - uint64_t* hardwareTime : Receives the NIC's one
+    Output:
+        - int : Like recvfrom()
+    Description:
+        This function receives like recvfrom(), with the reception timestamps of a socket with NSC_TIMESTAMP_RX (0 if none came).
+*/
+static int recvTimestamped(SOCKET socket, char* buffer, uint32_t len, SIN* from, socklen_t* fromLen, uint64_t* kernelTime, uint64_t* hardwareTime) {
+#if defined (__linux__)
+    char control[256];
+    struct iovec vector;
+    vector.iov_base = buffer;
+    vector.iov_len = len;
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_name = from;
+    message.msg_namelen = (from != NULL) ? *fromLen : 0;
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    int received = recvmsg(socket, &message, 0);
+    if (received >= 0 && from != NULL) *fromLen = message.msg_namelen;
+    if (received > 0) {
+        *kernelTime = 0;
+        *hardwareTime = 0;
+        readTimestamps(&message, kernelTime, hardwareTime);
+    }
+    return received;
+#else
+    if (kernelTime != NULL) *kernelTime = 0;
+    if (hardwareTime != NULL) *hardwareTime = 0;
+    return recvfrom(socket, buffer, len, 0, (SOCKADDR*)from, fromLen);
+#endif
+}
+
+// Keep a send timestamp until it is reported (the software and hardware ones of a send come separately)
+static void keepSendTimestamp(Client* client, uint32_t id, uint64_t kernelTime, uint64_t hardwareTime) {
+    struct NSC_SendTimestamps* timestamps = client->extension->sendTimestamps;
+    if (timestamps == NULL) {
+        struct NSC_ClientExtension* extension = clientExtension(client);
+        if (!extension) return;
+        timestamps = (struct NSC_SendTimestamps*)memCalloc(client->allocator, 1, sizeof(struct NSC_SendTimestamps));
+        if (!timestamps) return;
+        extension->sendTimestamps = timestamps;
+        statAdd(*client->stats, allocations, 1);
+    }
+    if (timestamps->count > 0 && timestamps->entries[timestamps->count - 1].id == id) {
+        TimestampEntry* last = &timestamps->entries[timestamps->count - 1];
+        if (kernelTime != 0) last->kernelTime = kernelTime;
+        if (hardwareTime != 0) last->hardwareTime = hardwareTime;
+        return;
+    }
+    if (timestamps->count == timestamps->capacity) {
+        if (timestamps->capacity >= NSC_MAX_SEND_TIMESTAMPS) return;
+        int capacity = (timestamps->capacity == 0) ? 16 : timestamps->capacity * 2;
+        TimestampEntry* entries = (TimestampEntry*)memRealloc(client->allocator, timestamps->entries, sizeof(TimestampEntry) * capacity);
+        if (!entries) return;
+        timestamps->entries = entries;
+        timestamps->capacity = capacity;
+        statAdd(*client->stats, allocations, 1);
+    }
+    TimestampEntry* entry = &timestamps->entries[timestamps->count++];
+    entry->id = id;
+    entry->kernelTime = kernelTime;
+    entry->hardwareTime = hardwareTime;
+}
+
+// Take the oldest send timestamp not reported yet, 0 if there is none
+static int takeSendTimestamp(Client* client, uint32_t* id, uint64_t* kernelTime, uint64_t* hardwareTime) {
+    struct NSC_SendTimestamps* timestamps = client->extension->sendTimestamps;
+    if (timestamps == NULL || timestamps->count == 0) return 0;
+    *id = timestamps->entries[0].id;
+    *kernelTime = timestamps->entries[0].kernelTime;
+    *hardwareTime = timestamps->entries[0].hardwareTime;
+    timestamps->count--;
+    memmove(timestamps->entries, timestamps->entries + 1, sizeof(TimestampEntry) * timestamps->count);
+    return 1;
+}
+
+static void freeSendTimestamps(Client* client) {
+    if (client->extension->sendTimestamps == NULL) return;
+    memFree(client->allocator, client->extension->sendTimestamps->entries);
+    memFree(client->allocator, client->extension->sendTimestamps);
+    client->extension->sendTimestamps = NULL;
+}
+
+/*
+    Parameters:
+        - Client* client : A connection in zero-copy mode or with send timestamps
+    Description:
+        This function reads the socket's error queue : the zero-copy completions mark the messages
+        whose buffer the kernel released, the send timestamps are kept until they are reported.
+*/
+static void readErrorQueue(Client* client) {
+#if defined (__linux__)
+    struct NSC_ZeroCopy* zeroCopy = client->extension->zeroCopy;
+    while (1) {
+        char control[256];
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        int status = recvmsg(client->socket, &message, MSG_ERRQUEUE);
+        statAdd(*client->stats, recvCalls, 1);
+        if (status < 0) break; // Queue drained
+
+        uint64_t kernelTime = 0;
+        uint64_t hardwareTime = 0;
+        readTimestamps(&message, &kernelTime, &hardwareTime);
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+                && !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) continue;
+
+            struct sock_extended_err error;
+            memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+            if (error.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                keepSendTimestamp(client, error.ee_data + 1, kernelTime, hardwareTime);
+                continue;
+            }
+            if (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY || zeroCopy == NULL) continue;
+
+            // The kernel completed the ids [ee_info, ee_data]
+            uint32_t low = error.ee_info;
+            uint32_t high = error.ee_data;
+            if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) statAdd(*client->stats, zeroCopyCopied, high - low + 1);
+
+            for (int i = 0; i < zeroCopy->numPending; i++) {
+                ZeroCopySend* pending = &zeroCopy->pending[i];
+                // Overlap of the two ranges, relative to firstId (ids wrap around)
+                int32_t span = (int32_t)(pending->lastId - pending->firstId);
+                int32_t start = (int32_t)(low - pending->firstId);
+                int32_t end = (int32_t)(high - pending->firstId);
+                if (start < 0) start = 0;
+                if (end > span) end = span;
+                if (end < start) continue;
+
+                int wasComplete = pending->completed == (uint32_t)span + 1;
+                pending->completed += end - start + 1;
+                if (!wasComplete && pending->completed == (uint32_t)span + 1) zeroCopy->numCompleted++;
+            }
+        }
+    }
+#endif
+}
+
+/*
+    Parameters:
+        - Client* client : A connection in zero-copy mode
+        - const char** buffer : Receives the released buffer
+        - uint32_t* len : Receives its length
+    Output:
+        - int : 1 if a released buffer was taken, 0 if there is none
+    Description:
+        This function removes the oldest message whose buffer the kernel released from the pending ones.
+*/
+static int takeZeroCopyCompleted(Client* client, const char** buffer, uint32_t* len) {
+    struct NSC_ZeroCopy* zeroCopy = client->extension->zeroCopy;
+    if (zeroCopy == NULL || zeroCopy->numCompleted == 0) return 0;
+
+    for (int i = 0; i < zeroCopy->numPending; i++) {
+        ZeroCopySend* pending = &zeroCopy->pending[i];
+        if (pending->completed != pending->lastId - pending->firstId + 1) continue;
+
+        *buffer = pending->buffer;
+        *len = pending->len;
+        memmove(pending, pending + 1, sizeof(ZeroCopySend) * (zeroCopy->numPending - i - 1));
+        zeroCopy->numPending--;
+        zeroCopy->numCompleted--;
+        return 1;
+    }
+    return 0;
+}
+
+// Free the zero-copy state of a connection (the kernel keeps its own references on the pending buffers' pages)
+static void freeZeroCopy(Client* client) {
+    if (client->extension->zeroCopy == NULL) return;
+    memFree(client->allocator, client->extension->zeroCopy->pending);
+    memFree(client->allocator, client->extension->zeroCopy);
+    client->extension->zeroCopy = NULL;
+}
+
+// Link a segment at the end of an outbound queue
+static void appendSegment(struct NSC_OutQueue* queue, OutSegment* segment, int fd, int64_t offset, uint32_t len, int endsFrame) {
+    segment->next = NULL;
+    segment->fd = fd;
+    segment->offset = offset;
+    segment->len = len;
+    segment->endsFrame = endsFrame;
+    if (queue->tail != NULL) queue->tail->next = segment;
+    else queue->head = segment;
+    queue->tail = segment;
+    queue->queuedBytes += len;
+}
+
+/*
+    Parameters:
+        - Client* client : The TCP connection
+        - const char* data : The bytes to queue (copied), NULL for a file
+        - uint32_t len : The number of bytes to queue
+        - int fd : The file to send the bytes from (owned by the queue from now), -1 for data
+        - int64_t offset : The offset of the bytes in the file
+        - int endsFrame : 1 if these bytes end a message
+    Output:
+        - int : 0 if the bytes were queued, -1 otherwise
+    Description:
+        This function appends a segment to the connection's outbound queue.
+*/
+static int queueSegment(Client* client, const char* data, uint32_t len, int fd, int64_t offset, int endsFrame) {
+    if (client->extension->outQueue == NULL) {
+        struct NSC_ClientExtension* extension = clientExtension(client);
+        if (!extension) return -1;
+        extension->outQueue = (struct NSC_OutQueue*)memCalloc(client->allocator, 1, sizeof(struct NSC_OutQueue));
+        if (!extension->outQueue) return -1;
+        statAdd(*client->stats, allocations, 1);
+    }
+
+    uint32_t capacity = (fd < 0) ? len : 0;
+    OutSegment* segment = client->extension->outQueue->spare;
+    if (segment != NULL && segment->capacity >= capacity) {
+        client->extension->outQueue->spare = NULL;
+    }
+    else {
+        segment = (OutSegment*)memAlloc(client->allocator, sizeof(OutSegment) + capacity);
+        if (!segment) return -1;
+        segment->capacity = capacity;
+        statAdd(*client->stats, allocations, 1);
+    }
+
+    if (fd < 0) memcpy(segment->data, data, len);
+    appendSegment(client->extension->outQueue, segment, fd, (fd < 0) ? 0 : offset, len, endsFrame);
+    return 0;
+}
+
+// Keep a segment whose data was sent for the next message (the largest one is kept)
+static void keepSpareSegment(Client* client, OutSegment* segment) {
+    struct NSC_OutQueue* queue = client->extension->outQueue;
+    if (queue->spare != NULL && queue->spare->capacity >= segment->capacity) {
+        memFree(client->allocator, segment);
+        return;
+    }
+    memFree(client->allocator, queue->spare);
+    queue->spare = segment;
+}
+
+// Free the outbound queue of a connection, the data not sent yet is lost
+static void freeOutQueue(Client* client) {
+    if (client->extension->outQueue == NULL) return;
+    OutSegment* segment = client->extension->outQueue->head;
+    while (segment != NULL) {
+        OutSegment* next = segment->next;
+        if (segment->fd >= 0) closeFile(segment->fd);
+        memFree(client->allocator, segment);
+        segment = next;
+    }
+    memFree(client->allocator, client->extension->outQueue->reserved);
+    memFree(client->allocator, client->extension->outQueue->spare);
+    memFree(client->allocator, client->extension->outQueue);
+    client->extension->outQueue = NULL;
+}
+
+#if defined (__linux__)
+// Wake the other side up (a full socket already holds a doorbell)
+static void ringDoorbell(SOCKET socket) {
+    char doorbell = 0;
+    send(socket, &doorbell, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+// 1 if the ring read by this side has data
+static int ringHasData(struct NSC_SharedRing* ring) {
+    return __atomic_load_n(&ring->rx->tail, __ATOMIC_ACQUIRE) != ring->rx->head;
+}
+
+/*
+    Parameters:
+        - struct NSC_SharedRing* ring : The connection's rings
+    Output:
+        - int : 1 if the ring has data (no need to sleep), 0 otherwise
+    Description:
+        This function prepares the sleep in poll() : the producer is asked to ring the doorbell on its next write.
+        The flag is set before the ring is checked a last time, so a write can't fall in between unnoticed.
+        In pure spin mode the producer never rings.
+*/
+static int ringArm(struct NSC_SharedRing* ring) {
+    if (ring->spin < 0) return ringHasData(ring);
+    __atomic_store_n(&ring->rx->consumerWaiting, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->rx->tail, __ATOMIC_SEQ_CST) != ring->rx->head) {
+        __atomic_store_n(&ring->rx->consumerWaiting, 0, __ATOMIC_RELAXED);
+        return 1;
+    }
+    return 0;
+}
+
+// Check a ring for data until some arrives or the time (ns) runs out
+static int ringSpinWait(struct NSC_SharedRing* ring, uint64_t budget) {
+    uint64_t end = nscMonotonicNs() + budget;
+    do {
+        for (int i = 0; i < 64; i++) {
+            if (ringHasData(ring)) return 1;
+        }
+        sched_yield(); // The other side may be waiting for this core
+    } while (nscMonotonicNs() < end);
+    return 0;
+}
+
+// Check the rings of a server's connections until one has data or the time (ns) runs out
+static int serverRingsSpinWait(Server* server, uint64_t budget) {
+    uint64_t end = nscMonotonicNs() + budget;
+    do {
+        for (int i = 0; i < server->numClients; i++) {
+            if (server->clients[i].extension->ring != NULL && ringHasData(server->clients[i].extension->ring)) return 1;
+        }
+        sched_yield();
+    } while (nscMonotonicNs() < end);
+    return 0;
+}
+
+// Time (ns) spent checking the rings before sleeping : ringSpin, or the whole poll timeout in pure spin mode
+#define ringSpinBudget(spin, pollTimeout) (((spin) > 0) ? (uint64_t)(spin) * 1000 : (uint64_t)(pollTimeout) * 1000000)
+
+/*
+    Parameters:
+        - struct NSC_SharedRing* ring : The connection's rings
+        - SOCKET socket : The connection's socket (doorbell)
+        - char* buffer : Where to copy the bytes
+        - uint32_t len : The maximum number of bytes
+    Output:
+        - uint32_t : The number of bytes read (0 if the ring is empty)
+    Description:
+        This function reads bytes from the ring written by the other side, like recv() on a stream socket.
+*/
+static uint32_t ringRead(struct NSC_SharedRing* ring, SOCKET socket, char* buffer, uint32_t len) {
+    NSC_RingControl* control = ring->rx;
+    uint64_t head = control->head;
+    uint64_t available = __atomic_load_n(&control->tail, __ATOMIC_ACQUIRE) - head;
+    uint32_t count = (available < len) ? (uint32_t)available : len;
+    if (count == 0) return 0;
+
+    uint32_t offset = (uint32_t)(head & (ring->size - 1));
+    uint32_t first = (count < ring->size - offset) ? count : ring->size - offset;
+    memcpy(buffer, ring->rxData + offset, first);
+    memcpy(buffer + first, ring->rxData, count - first);
+    __atomic_store_n(&control->head, head + count, __ATOMIC_SEQ_CST);
+
+    // The producer waits for room
+    if (__atomic_load_n(&control->producerWaiting, __ATOMIC_SEQ_CST) && __atomic_exchange_n(&control->producerWaiting, 0, __ATOMIC_SEQ_CST)) {
+        ringDoorbell(socket);
+    }
+    return count;
+}
+
+// Room left in the ring written by this side, the consumer is asked to ring the doorbell when there is less than needed
+static uint32_t ringSpace(struct NSC_SharedRing* ring, uint32_t needed) {
+    NSC_RingControl* control = ring->tx;
+    uint32_t space = ring->size - (uint32_t)(control->tail - __atomic_load_n(&control->head, __ATOMIC_ACQUIRE));
+    if (space >= needed) return space;
+
+    // Set the flag before checking again, so the consumer can't make room in between unnoticed
+    __atomic_store_n(&control->producerWaiting, 1, __ATOMIC_SEQ_CST);
+    return ring->size - (uint32_t)(control->tail - __atomic_load_n(&control->head, __ATOMIC_SEQ_CST));
+}
+
+/*
+    Parameters:
+        - struct NSC_SharedRing* ring : The connection's rings
+        - SOCKET socket : The connection's socket (doorbell)
+        - const char* data : The bytes to write
+        - uint32_t len : The number of bytes
+    Output:
+        - uint32_t : The number of bytes written (less than len if the ring is full)
+    Description:
+        This function writes bytes to the ring read by the other side, like send() on a non-blocking stream socket.
+*/
+static uint32_t ringWrite(struct NSC_SharedRing* ring, SOCKET socket, const char* data, uint32_t len) {
+    NSC_RingControl* control = ring->tx;
+    uint32_t space = ringSpace(ring, len);
+    uint32_t count = (space < len) ? space : len;
+    if (count == 0) return 0;
+
+    uint64_t tail = control->tail;
+    uint32_t offset = (uint32_t)(tail & (ring->size - 1));
+    uint32_t first = (count < ring->size - offset) ? count : ring->size - offset;
+    memcpy(ring->txData + offset, data, first);
+    memcpy(ring->txData, data + first, count - first);
+    __atomic_store_n(&control->tail, tail + count, __ATOMIC_SEQ_CST);
+
+    // The consumer sleeps in poll()
+    if (__atomic_load_n(&control->consumerWaiting, __ATOMIC_SEQ_CST) && __atomic_exchange_n(&control->consumerWaiting, 0, __ATOMIC_SEQ_CST)) {
+        ringDoorbell(socket);
+    }
+    return count;
+}
+
+// Map the shared memory of a connection's rings
+static struct NSC_SharedRing* mapSharedRing(const NSC_Allocator* allocator, int fd, uint32_t size, int isServer, int spin) {
+    struct NSC_SharedRing* ring = (struct NSC_SharedRing*)memCalloc(allocator, 1, sizeof(struct NSC_SharedRing));
+    if (!ring) return NULL;
+    ring->mapSize = RING_DATA_OFFSET + 2 * (size_t)size;
+    ring->memory = (uint8_t*)mmap(NULL, ring->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ring->memory == MAP_FAILED) {
+        memFree(allocator, ring);
+        return NULL;
+    }
+    NSC_RingControl* toClient = (NSC_RingControl*)ring->memory;
+    NSC_RingControl* toServer = toClient + 1;
+    uint8_t* toClientData = ring->memory + RING_DATA_OFFSET;
+    uint8_t* toServerData = toClientData + size;
+    ring->rx = isServer ? toServer : toClient;
+    ring->rxData = isServer ? toServerData : toClientData;
+    ring->tx = isServer ? toClient : toServer;
+    ring->txData = isServer ? toClientData : toServerData;
+    ring->size = size;
+    ring->spin = spin;
+    return ring;
+}
+
+/*
+    Parameters:
+        - Client* client : A connection just accepted by a UNIX stream server
+        - uint32_t size : The size of each ring
+        - int spin : NSC_Options.ringSpin
+    Output:
+        - int : 0 if the rings were created and offered to the client, -1 otherwise
+    Description:
+        This function creates the shared memory of a connection (memfd) and sends it to the client over the socket.
+*/
+static int offerSharedRing(Client* client, uint32_t size, int spin) {
+    if (clientExtension(client) == NULL) return -1;
+    int fd = memfd_create("nsc-ring", MFD_CLOEXEC);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, RING_DATA_OFFSET + 2 * (off_t)size) != 0) {
+        close(fd);
+        return -1;
+    }
+    client->extension->ring = mapSharedRing(client->allocator, fd, size, 1, spin);
+    if (client->extension->ring == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    uint32_t offer[2] = { htonl(RING_MAGIC), htonl(size) };
+    struct iovec data = { offer, sizeof(offer) };
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &fd, sizeof(int));
+
+    int sent = (int)sendmsg(client->socket, &message, MSG_NOSIGNAL);
+    close(fd); // The mappings keep the memory
+    if (sent != (int)sizeof(offer)) {
+        munmap(client->extension->ring->memory, client->extension->ring->mapSize);
+        memFree(client->allocator, client->extension->ring);
+        client->extension->ring = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+    Parameters:
+        - Client* client : A client just connected to a UNIX stream server (blocking socket)
+        - uint32_t size : The size of each ring expected
+        - int spin : NSC_Options.ringSpin
+    Output:
+        - int : 0 if the client maps the rings offered by the server, -1 otherwise
+    Description:
+        This function waits (1 s at most) for the shared memory the server sends on connection and maps it.
+*/
+static int takeSharedRing(Client* client, uint32_t size, int spin) {
+    struct pollfd pollEntry;
+    pollEntry.fd = client->socket;
+    pollEntry.events = POLLIN;
+    pollEntry.revents = 0;
+    if (pollSockets(&pollEntry, 1, 1000) <= 0) return -1;
+
+    uint32_t offer[2];
+    struct iovec data = { offer, sizeof(offer) };
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (recvmsg(client->socket, &message, MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(offer)) return -1;
+
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (header == NULL || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) return -1;
+    int fd;
+    memcpy(&fd, CMSG_DATA(header), sizeof(int));
+    if (ntohl(offer[0]) != RING_MAGIC || ntohl(offer[1]) != size || clientExtension(client) == NULL) {
+        close(fd);
+        return -1;
+    }
+    client->extension->ring = mapSharedRing(client->allocator, fd, size, 0, spin);
+    close(fd);
+    return (client->extension->ring != NULL) ? 0 : -1;
+}
+#endif
+
+// Unmap the shared-memory rings of a connection
+static void freeSharedRing(Client* client) {
+#if defined (__linux__)
+    if (client->extension->ring == NULL) return;
+    munmap(client->extension->ring->memory, client->extension->ring->mapSize);
+    memFree(client->allocator, client->extension->ring);
+    client->extension->ring = NULL;
+#else
+    (void)client;
+#endif
+}
+
+/*
+    Parameters:
+        - Client* client : A stream connection
+        - const char* data : The bytes to send
+        - uint32_t len : The number of bytes
+    Output:
+        - int : The number of bytes sent, -1 on error (wouldBlock() : the socket or the ring is full)
+    Description:
+        This function sends bytes like send(), to the shared-memory ring of the connection if it has one.
+*/
+static int streamSend(Client* client, const char* data, uint32_t len) {
+#if defined (__linux__)
+    if (client->extension->ring != NULL) {
+        uint32_t written = ringWrite(client->extension->ring, client->socket, data, len);
+        if (written > 0) return (int)written;
+        errno = EAGAIN;
+        return -1;
+    }
+#endif
+    return send(client->socket, data, len, 0);
+}
+
+/*
+    Parameters:
+        - Client* client : A stream connection
+        - char* buffer : Where to copy the bytes
+        - uint32_t len : The maximum number of bytes
+    Output:
+        - int : The number of bytes received, 0 if the connection was closed, -1 on error (wouldBlock() : nothing to read)
+    Description:
+        This function receives bytes like recv(), from the shared-memory ring of the connection if it has one.
+        The socket of such a connection only carries doorbells : they are read once poll() reported it.
+*/
+static int streamRecv(Client* client, char* buffer, uint32_t len) {
+#if defined (__linux__)
+    struct NSC_SharedRing* ring = client->extension->ring;
+    if (ring != NULL) {
+        while (1) {
+            uint32_t count = ringRead(ring, client->socket, buffer, len);
+            if (count > 0) return (int)count;
+            if (!ring->checkSocket) break;
+
+            char doorbells[64];
+            int n = recv(client->socket, doorbells, sizeof(doorbells), 0);
+            statAdd(*client->stats, recvCalls, 1);
+            if (n > 0) continue; // Check the ring again
+            if (n == 0) {
+                // Closed : the data written before still comes first
+                count = ringRead(ring, client->socket, buffer, len);
+                return (int)count;
+            }
+            if (!wouldBlock()) return -1;
+            ring->checkSocket = 0;
+            break;
+        }
+        errno = EAGAIN;
+        return -1;
+    }
+#endif
+    if (client->timestamping & NSC_TIMESTAMP_RX) {
+        return recvTimestamped(client->socket, buffer, len, NULL, NULL, &client->bufferData.kernelTime, &client->bufferData.hardwareTime);
+    }
+    return recv(client->socket, buffer, len, 0);
+}
+
+/*
+    Parameters:
+        - SOCKET socket : The socket to send the bytes on
+        - OutSegment* segment : A file segment
+    Output:
+        - int : The number of bytes sent, 0 at the end of the file, -1 on error
+    Description:
+        This function sends the next bytes of a file segment : with sendfile() on Linux,
+        straight from the page cache, read in a chunk and sent otherwise.
+*/
+static int sendFileChunk(SOCKET socket, OutSegment* segment) {
+#if defined (__linux__)
+    off_t offset = (off_t)segment->offset;
+    size_t count = (segment->len < 0x40000000) ? segment->len : 0x40000000;
+    return (int)sendfile(socket, segment->fd, &offset, count);
+#else
+    char chunk[65536];
+    unsigned int count = (segment->len < sizeof(chunk)) ? segment->len : sizeof(chunk);
+    if (_lseeki64(segment->fd, segment->offset, SEEK_SET) < 0) return -1;
+    int numRead = _read(segment->fd, chunk, count);
+    if (numRead <= 0) return numRead;
+    return send(socket, chunk, numRead, 0); // Only what was sent is consumed, the rest is read again next time
+#endif
+}
+
+// Copy the next bytes of a file segment to the shared-memory ring (sendfile() can't write to memory)
+static int ringFileChunk(Client* client, OutSegment* segment) {
+#if defined (__linux__)
+    char chunk[65536];
+    uint32_t count = (segment->len < sizeof(chunk)) ? segment->len : sizeof(chunk);
+    uint32_t space = ringSpace(client->extension->ring, count);
+    if (space == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (count > space) count = space;
+    ssize_t numRead = pread(segment->fd, chunk, count, (off_t)segment->offset);
+    if (numRead <= 0) return (int)numRead;
+    return streamSend(client, chunk, (uint32_t)numRead);
+#else
+    (void)client;
+    (void)segment;
+    return -1;
+#endif
+}
+
+/*
+    Parameters:
+        - Client* client : The TCP connection
+    Output:
+        - int : 1 if the queue is empty, 0 if the socket is full, -1 on error (the queue is dropped)
+    Description:
+        This function sends the connection's outbound queue until it is empty or the socket is full.
+*/
+static int flushOutQueue(Client* client) {
+    struct NSC_OutQueue* queue = client->extension->outQueue;
+    while (queue != NULL && queue->head != NULL) {
+        OutSegment* segment = queue->head;
+        while (segment->len > 0) {
+            int sent;
+            if (segment->fd < 0) {
+                sent = streamSend(client, segment->data + segment->offset, segment->len);
+            }
+            else {
+                sent = (client->extension->ring != NULL) ? ringFileChunk(client, segment) : sendFileChunk(client->socket, segment);
+            }
+            statAdd(*client->stats, sendCalls, 1);
+
+            if (sent <= 0) {
+                if (sent < 0 && wouldBlock()) {
+                    statAdd(*client->stats, eagainHits, 1);
+                    return 0;
+                }
+                statAdd(*client->stats, partialSends, 1);
+                freeOutQueue(client);
+                return -1;
+            }
+            segment->offset += sent;
+            segment->len -= sent;
+            queue->queuedBytes -= sent;
+            statAdd(*client->stats, bytesOut, sent);
+        }
+
+        if (segment->endsFrame) statAdd(*client->stats, framesOut, 1);
+        queue->head = segment->next;
+        if (queue->head == NULL) queue->tail = NULL;
+        if (segment->fd >= 0) {
+            closeFile(segment->fd);
+            memFree(client->allocator, segment);
+        }
+        else {
+            keepSpareSegment(client, segment);
+        }
+    }
+    return 1;
+}
+
+/*
+    Parameters:
+        - Client* client : The TCP connection
+        - const char* data : The bytes to send
+        - uint32_t len : The number of bytes
+        - int endsFrame : 1 if these bytes end a message
+    Output:
+        - int : 0 if the bytes were sent or queued, -1 otherwise
+    Description:
+        This function sends bytes on the connection, after the ones already queued,
+        and queues what the socket cannot take right away.
+*/
+static int sendStream(Client* client, const char* data, uint32_t len, int endsFrame) {
+    uint32_t totalSent = 0;
+    if (!outQueuePending(client)) {
+        while (totalSent < len) {
+            int sent = streamSend(client, data + totalSent, len - totalSent);
+            statAdd(*client->stats, sendCalls, 1);
+            if (sent <= 0) {
+                if (sent < 0 && wouldBlock()) {
+                    statAdd(*client->stats, eagainHits, 1);
+                    break; // The rest is queued
+                }
+                return -1;
+            }
+            totalSent += sent;
+            statAdd(*client->stats, bytesOut, sent);
+        }
+        if (totalSent == len) {
+            if (endsFrame) statAdd(*client->stats, framesOut, 1);
+            return 0;
+        }
+    }
+    return queueSegment(client, data + totalSent, len - totalSent, -1, 0, endsFrame);
+}
+
+// Prioritized streams of a TCP connection (see sendStreamMessage)
+// A streamed message goes in chunk frames : [NSC_FRAME_STREAM | length][stream : 1 byte][last : 1 byte][data]
+#define STREAM_CHUNK_HEADER 2
+
+// A message waiting in its stream
+typedef struct StreamMessage {
+    struct StreamMessage* next;
+    uint32_t len;
+    uint32_t sent; // Bytes already sent in chunks
+    char data[];
+} StreamMessage;
+
+struct NSC_Streams {
+    StreamMessage* head[NSC_MAX_STREAMS]; // Messages waiting in each stream, in order
+    StreamMessage* tail[NSC_MAX_STREAMS];
+    uint64_t queuedBytes; // Bytes of these messages not sent yet
+    char* partial[NSC_MAX_STREAMS]; // Message being reassembled on each stream (NULL : none)
+    uint32_t partialLen[NSC_MAX_STREAMS];
+    uint32_t partialSize[NSC_MAX_STREAMS];
+    uint8_t dropping[NSC_MAX_STREAMS]; // 1 while the chunks of a message too large are skipped
+    char* chunk; // Frame of the chunk being sent
+    uint32_t chunkSize; // Maximum number of bytes of message per chunk
+    int peer; // 1 once the peer announced that it reads streams
+    int received; // Stream of the message readMessage returned last
+};
+
+// Stream of the message readMessage returned last (0 without streams)
+#define messageStream(client) (((client)->extension->streams != NULL) ? (client)->extension->streams->received : 0)
+
+static void freeStreams(Client* client) {
+    struct NSC_Streams* streams = client->extension->streams;
+    if (streams == NULL) return;
+    for (int i = 0; i < NSC_MAX_STREAMS; i++) {
+        while (streams->head[i] != NULL) {
+            StreamMessage* next = streams->head[i]->next;
+            memFree(client->allocator, streams->head[i]);
+            streams->head[i] = next;
+        }
+        memFree(client->allocator, streams->partial[i]);
+    }
+    memFree(client->allocator, streams->chunk);
+    memFree(client->allocator, streams);
+    client->extension->streams = NULL;
+}
+
+/*
+    Parameters:
+        - Client* client : A TCP connection, just connected or accepted
+        - uint32_t chunkSize : The size of the chunks of its streams
+    Output:
+        - int : 0 if the streams are enabled, -1 otherwise
+    Description:
+        This function enables the streams of a connection and announces them to the peer with a hello header.
+        The peers that do not read streams skip it like any invalid header, and keep receiving plain frames.
+*/
+static int enableStreams(Client* client, uint32_t chunkSize) {
+    if (clientExtension(client) == NULL) return -1;
+    struct NSC_Streams* streams = (struct NSC_Streams*)memCalloc(client->allocator, 1, sizeof(struct NSC_Streams));
+    if (!streams) return -1;
+    streams->chunk = (char*)memAlloc(client->allocator, 4 + STREAM_CHUNK_HEADER + chunkSize);
+    if (!streams->chunk) {
+        memFree(client->allocator, streams);
+        return -1;
+    }
+    streams->chunkSize = chunkSize;
+    client->extension->streams = streams;
+    statAdd(*client->stats, allocations, 2);
+    uint32_t hello = htonl(NSC_FRAME_HELLO);
+    return sendStream(client, (const char*)&hello, 4, 0);
+}
+
+/*
+    Parameters:
+        - Client* client : A connection with streams
+    Output:
+        - int : 0 if the chunks were sent or queued, -1 on error
+    Description:
+        This function sends chunks of the waiting messages, each one from the most urgent stream, until the socket is full.
+        Only the chunk the socket could not take goes to the outbound queue : the next chunk is chosen when it is sent.
+*/
+static int sendStreamChunks(Client* client) {
+    struct NSC_Streams* streams = client->extension->streams;
+    while (streams->queuedBytes > 0 && !outQueuePending(client)) {
+        int stream = 0;
+        while (streams->head[stream] == NULL) stream++;
+        StreamMessage* message = streams->head[stream];
+        uint32_t len = message->len - message->sent;
+        if (len > streams->chunkSize) len = streams->chunkSize;
+        int last = (message->sent + len == message->len);
+
+        uint32_t header = htonl(NSC_FRAME_STREAM | (STREAM_CHUNK_HEADER + len));
+        memcpy(streams->chunk, &header, 4);
+        streams->chunk[4] = (char)stream;
+        streams->chunk[5] = (char)last;
+        memcpy(streams->chunk + 4 + STREAM_CHUNK_HEADER, message->data + message->sent, len);
+        message->sent += len;
+        streams->queuedBytes -= len;
+        if (last) {
+            streams->head[stream] = message->next;
+            if (streams->head[stream] == NULL) streams->tail[stream] = NULL;
+            memFree(client->allocator, message);
+        }
+        if (sendStream(client, streams->chunk, 4 + STREAM_CHUNK_HEADER + len, last) != 0) {
+            statAdd(*client->stats, partialSends, 1);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Send the outbound queue, then the chunks of the streams it held back (same output as flushOutQueue)
+static int flushConnection(Client* client) {
+    int status = flushOutQueue(client);
+    if (status == 1 && client->extension->streams != NULL && sendStreamChunks(client) != 0) return -1;
+    return status;
+}
+
+/*
+    Parameters:
+        - Client* client : A connection with streams
+        - const uint8_t* body : The body of a chunk frame
+        - uint32_t len : Its length (more than STREAM_CHUNK_HEADER)
+        - char** msg : Set to the message completed by the chunk
+    Output:
+        - int : The length of the message completed, 0 if it is not complete yet, or a READMSG_* error
+    Description:
+        This function adds a chunk to the message being reassembled on its stream.
+*/
+static int takeStreamChunk(Client* client, const uint8_t* body, uint32_t len, char** msg) {
+    struct NSC_Streams* streams = client->extension->streams;
+    int stream = body[0];
+    int last = body[1];
+    len -= STREAM_CHUNK_HEADER;
+    if (stream >= NSC_MAX_STREAMS) {
+        statAdd(*client->stats, oversizeDrops, 1);
+        return READMSG_MSG_TOO_LARGE;
+    }
+    uint32_t total = streams->partialLen[stream] + len;
+    if (streams->dropping[stream] || total > (uint32_t)client->bufferData.size - 4) {
+        // The message is larger than the buffer : its chunks are skipped up to the last one
+        if (!streams->dropping[stream]) statAdd(*client->stats, oversizeDrops, 1);
+        streams->dropping[stream] = !last;
+        streams->partialLen[stream] = 0;
+        return last ? READMSG_MSG_TOO_LARGE : 0;
+    }
+    if (total + 1 > streams->partialSize[stream]) {
+        uint32_t size = (streams->partialSize[stream] != 0) ? streams->partialSize[stream] : streams->chunkSize + 1;
+        while (size < total + 1) size *= 2;
+        if (size > (uint32_t)client->bufferData.size - 3) size = (uint32_t)client->bufferData.size - 3;
+        char* partial = (char*)memRealloc(client->allocator, streams->partial[stream], size);
+        if (!partial) return READMSG_ALLOC_FAILED;
+        statAdd(*client->stats, allocations, 1);
+        streams->partial[stream] = partial;
+        streams->partialSize[stream] = size;
+    }
+    memcpy(streams->partial[stream] + streams->partialLen[stream], body + STREAM_CHUNK_HEADER, len);
+    streams->partialLen[stream] = total;
+    if (!last) return 0;
+
+    // The message is handed over with its buffer
+    *msg = streams->partial[stream];
+    (*msg)[total] = '\0';
+    streams->partial[stream] = NULL;
+    streams->partialLen[stream] = 0;
+    streams->partialSize[stream] = 0;
+    streams->received = stream;
+    statAdd(*client->stats, framesIn, 1);
+    return (int)total;
+}
+
+// Attach a receive buffer to a connection, from its pool if possible
+static char* takeBuffer(Client* client) {
+    struct NSC_BufferPool* pool = client->bufferPool;
+    if (pool != NULL && pool->numFree > 0) {
+        client->bufferData.buffer = pool->buffers[--pool->numFree];
+    }
+    else {
+        client->bufferData.buffer = (char*)memAlloc(client->allocator, client->bufferData.size);
+        statAdd(*client->stats, allocations, 1);
+    }
+    return client->bufferData.buffer;
+}
+
+// Give the receive buffer of a server's connection back to its pool (a client without pool keeps it)
+static void releaseBuffer(Client* client) {
+    struct NSC_BufferPool* pool = client->bufferPool;
+    if (pool == NULL || client->bufferData.buffer == NULL) return;
+    if (pool->numFree < BufferPoolSize) {
+        pool->buffers[pool->numFree++] = client->bufferData.buffer;
+    }
+    else {
+        memFree(client->allocator, client->bufferData.buffer);
+    }
+    client->bufferData.buffer = NULL;
+    client->bufferData.len = 0;
+    client->bufferData.pos = 0;
+}
+
+// Free the compression settings of a connection (the dictionary belongs to the application)
+static void freeCompression(Client* client) {
+    if (client->extension->compression == NULL) return;
+    memFree(client->allocator, client->extension->compression->scratch);
+    memFree(client->allocator, client->extension->compression);
+    client->extension->compression = NULL;
+}
+
+// Create the connection ids' slots of a server (slot 0 is taken first)
+static struct NSC_ConnectionIds* createConnectionIds(const NSC_Allocator* allocator, int numSlots) {
+    struct NSC_ConnectionIds* ids = (struct NSC_ConnectionIds*)memAlloc(allocator, sizeof(struct NSC_ConnectionIds));
+    if (!ids) return NULL;
+    ids->index = (int*)memAlloc(allocator, sizeof(int) * numSlots);
+    ids->generation = (uint16_t*)memAlloc(allocator, sizeof(uint16_t) * numSlots);
+    ids->freeSlots = (int*)memAlloc(allocator, sizeof(int) * numSlots);
+    if (!ids->index || !ids->generation || !ids->freeSlots) {
+        memFree(allocator, ids->index);
+        memFree(allocator, ids->generation);
+        memFree(allocator, ids->freeSlots);
+        memFree(allocator, ids);
+        return NULL;
+    }
+    for (int i = 0; i < numSlots; i++) {
+        ids->index[i] = -1;
+        ids->generation[i] = 1;
+        ids->freeSlots[i] = numSlots - 1 - i;
+    }
+    ids->numFree = numSlots;
+    return ids;
+}
+
+// Give a connection id to the connection at an index of the clients (a slot is free while the server isn't full)
+static uint32_t takeConnectionId(struct NSC_ConnectionIds* ids, int index) {
+    int slot = ids->freeSlots[--ids->numFree];
+    ids->index[slot] = index;
+    return ((uint32_t)ids->generation[slot] << NSC_ID_SLOT_BITS) | (uint32_t)slot;
+}
+
+// Free the slot of a disconnected connection, its id won't match the next connection of the slot
+static void releaseConnectionId(struct NSC_ConnectionIds* ids, uint32_t id) {
+    int slot = (int)(id & (NSC_ID_SLOTS - 1));
+    ids->index[slot] = -1;
+    ids->generation[slot] = (ids->generation[slot] + 1) & 0xFFF;
+    if (ids->generation[slot] == 0) ids->generation[slot] = 1; // 0 is never a valid id
+    ids->freeSlots[ids->numFree++] = slot;
+}
+
+// Hash of a topic's name (FNV-1a)
+static uint32_t topicHash(const char* name) {
+    uint32_t hash = 2166136261u;
+    while (*name != '\0') {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Find a topic, *link set to the pointer that references it in its bucket
+static NSC_Topic* findTopic(struct NSC_Topics* topics, const char* name, uint32_t hash, NSC_Topic*** link) {
+    NSC_Topic** current = &topics->buckets[hash & (topics->numBuckets - 1)];
+    while (*current != NULL) {
+        if ((*current)->hash == hash && strcmp((*current)->name, name) == 0) break;
+        current = &(*current)->next;
+    }
+    if (link != NULL) *link = current;
+    return *current;
+}
+
+// Double the number of buckets of the topics
+static void growTopics(struct NSC_Topics* topics) {
+    uint32_t numBuckets = topics->numBuckets * 2;
+    NSC_Topic** buckets = (NSC_Topic**)memCalloc(topics->allocator, numBuckets, sizeof(NSC_Topic*));
+    if (!buckets) return; // Longer chains, still correct
+    for (uint32_t i = 0; i < topics->numBuckets; i++) {
+        NSC_Topic* topic = topics->buckets[i];
+        while (topic != NULL) {
+            NSC_Topic* next = topic->next;
+            topic->next = buckets[topic->hash & (numBuckets - 1)];
+            buckets[topic->hash & (numBuckets - 1)] = topic;
+            topic = next;
+        }
+    }
+    memFree(topics->allocator, topics->buckets);
+    topics->buckets = buckets;
+    topics->numBuckets = numBuckets;
+}
+
+// Remove a subscriber from a topic, the topic is freed once it has none
+static void removeSubscriber(struct NSC_Topics* topics, NSC_Topic* topic, uint32_t id) {
+    for (uint32_t i = 0; i < topic->numSubscribers; i++) {
+        if (topic->subscribers[i] == id) {
+            topic->subscribers[i] = topic->subscribers[--topic->numSubscribers];
+            break;
+        }
+    }
+    if (topic->numSubscribers != 0) return;
+
+    NSC_Topic** link;
+    findTopic(topics, topic->name, topic->hash, &link);
+    *link = topic->next;
+    topics->numTopics--;
+    memFree(topics->allocator, topic->subscribers);
+    memFree(topics->allocator, topic->name);
+    memFree(topics->allocator, topic);
+}
+
+// Remove a disconnecting connection from all its topics
+static void freeSubscriptions(Server* server, Client* client) {
+    struct NSC_Subscriptions* subscriptions = client->extension->subscriptions;
+    if (subscriptions == NULL) return;
+    for (int i = 0; i < subscriptions->numTopics; i++) {
+        removeSubscriber(server->topics, subscriptions->topics[i], client->id);
+    }
+    memFree(&server->allocator, subscriptions->topics);
+    memFree(&server->allocator, subscriptions);
+    client->extension->subscriptions = NULL;
+}
+
+// Free the topics of a server
+static void freeTopics(struct NSC_Topics* topics) {
+    if (topics == NULL) return;
+    for (uint32_t i = 0; i < topics->numBuckets; i++) {
+        NSC_Topic* topic = topics->buckets[i];
+        while (topic != NULL) {
+            NSC_Topic* next = topic->next;
+            memFree(topics->allocator, topic->subscribers);
+            memFree(topics->allocator, topic->name);
+            memFree(topics->allocator, topic);
+            topic = next;
+        }
+    }
+    memFree(topics->allocator, topics->buckets);
+    memFree(topics->allocator, topics->frame);
+    memFree(topics->allocator, topics);
+}
+
+// Hash of the address of a UDP peer (FNV-1a of its address and port)
+static uint32_t peerHash(const SIN* address, int ipType) {
+    const uint8_t* bytes[2];
+    size_t lengths[2] = { 0, 0 };
+    if (ipType == IPv4) {
+        bytes[0] = (const uint8_t*)&address->in.sin_addr;
+        lengths[0] = sizeof(address->in.sin_addr);
+        bytes[1] = (const uint8_t*)&address->in.sin_port;
+        lengths[1] = sizeof(address->in.sin_port);
+    }
+    else if (ipType == IPv6) {
+        bytes[0] = (const uint8_t*)&address->in6.sin6_addr;
+        lengths[0] = sizeof(address->in6.sin6_addr);
+        bytes[1] = (const uint8_t*)&address->in6.sin6_port;
+        lengths[1] = sizeof(address->in6.sin6_port);
+    }
+#if defined (__linux__)
+    else {
+        bytes[0] = (const uint8_t*)address->un.sun_path;
+        lengths[0] = sizeof(address->un.sun_path);
+    }
+#endif
+    uint32_t hash = 2166136261u;
+    for (int part = 0; part < 2; part++) {
+        for (size_t i = 0; i < lengths[part]; i++) hash = (hash ^ bytes[part][i]) * 16777619u;
+    }
+    return hash;
+}
+
+// 1 if two addresses are the same UDP peer
+static int samePeer(const SIN* a, const SIN* b, int ipType) {
+    if (ipType == IPv4) {
+        return a->in.sin_port == b->in.sin_port && a->in.sin_addr.s_addr == b->in.sin_addr.s_addr;
+    }
+    if (ipType == IPv6) {
+        return a->in6.sin6_port == b->in6.sin6_port && a->in6.sin6_scope_id == b->in6.sin6_scope_id
+            && !memcmp(&a->in6.sin6_addr, &b->in6.sin6_addr, sizeof(a->in6.sin6_addr));
+    }
+#if defined (__linux__)
+    return !memcmp(a->un.sun_path, b->un.sun_path, sizeof(a->un.sun_path)); // Zeroed before recvfrom()
+#else
+    return 0;
+#endif
+}
+
+// Session of a UDP peer (NULL if it has none), *entry receives its entry or the free entry it would take
+static Client* findSession(Server* server, const SIN* address, uint32_t hash, uint32_t* entry) {
+    struct NSC_UdpSessions* sessions = server->udpSessions;
+    uint32_t i = hash & sessions->mask;
+    while (sessions->ids[i] != 0) {
+        if (sessions->hashes[i] == hash) {
+            Client* session = getConnection(server, sessions->ids[i]);
+            if (session != NULL && samePeer(&session->sin, address, server->ipType)) {
+                *entry = i;
+                return session;
+            }
+        }
+        i = (i + 1) & sessions->mask;
+    }
+    *entry = i;
+    return NULL;
+}
+
+// Remove the entry of a disconnected session, the following entries of its run are moved back (no tombstones)
+static void removeSession(Server* server, const Client* session) {
+    struct NSC_UdpSessions* sessions = server->udpSessions;
+    uint32_t i = peerHash(&session->sin, server->ipType) & sessions->mask;
+    while (sessions->ids[i] != session->id) {
+        if (sessions->ids[i] == 0) return;
+        i = (i + 1) & sessions->mask;
+    }
+
+    uint32_t hole = i;
+    while (1) {
+        i = (i + 1) & sessions->mask;
+        if (sessions->ids[i] == 0) break;
+        // An entry stays if its home is cyclically in (hole, i]
+        uint32_t home = sessions->hashes[i] & sessions->mask;
+        if (((i - home) & sessions->mask) < ((i - hole) & sessions->mask)) continue;
+        sessions->ids[hole] = sessions->ids[i];
+        sessions->hashes[hole] = sessions->hashes[i];
+        hole = i;
+    }
+    sessions->ids[hole] = 0;
+}
+
+static void freeUdpSessions(Server* server) {
+    if (server->udpSessions == NULL) return;
+    memFree(&server->allocator, server->udpSessions->ids);
+    memFree(&server->allocator, server->udpSessions->hashes);
+    memFree(&server->allocator, server->udpSessions);
+    server->udpSessions = NULL;
+}
+
+// Current tick of the timer wheels (ms of the monotonic clock)
+static uint64_t currentTick() {
+    return nscMonotonicNs() / 1000000;
+}
+
+// Index of the lowest bit set (bits != 0)
+static int lowestBit(uint64_t bits) {
+#if defined (__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int index = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+// Link a timer at the end of a circular list
+static void timerLink(NSC_Timer* head, NSC_Timer* timer) {
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+// Unlink a timer from its list
+static void timerUnlink(NSC_Timer* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+// Fix the links of a linked timer that was copied to a new address (the clients array is compacted on disconnection)
+static void timerMoved(NSC_Timer* timer) {
+    if (timer->next != NULL) {
+        timer->next->prev = timer;
+        timer->prev->next = timer;
+    }
+}
+
+/*
+    Parameters:
+        - NSC_TimerWheel* wheel : The wheel
+        - NSC_Timer* timer : The timer to insert (timer->expires > wheel->now)
+    Description:
+        This function links the timer in the slot of the lowest level whose range contains its expiration.
+        A timer is at level n when its expiration and wheel->now only differ by their bits of the levels <= n,
+        so it is cascaded to a lower level when the ticks reach the start of its slot.
+*/
+static void wheelInsert(NSC_TimerWheel* wheel, NSC_Timer* timer) {
+    uint64_t expires = timer->expires;
+    int level = 0;
+    while (level < NSC_WHEEL_LEVELS - 1
+        && (expires >> (NSC_WHEEL_BITS * (level + 1))) != (wheel->now >> (NSC_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+
+    int slot;
+    if ((expires >> (NSC_WHEEL_BITS * NSC_WHEEL_LEVELS)) != (wheel->now >> (NSC_WHEEL_BITS * NSC_WHEEL_LEVELS))) {
+        // Beyond the wheel : last slot of the top level to be reached, the timer is inserted again from there
+        slot = (int)((wheel->now >> (NSC_WHEEL_BITS * level)) - 1) & (NSC_WHEEL_SLOTS - 1);
+    }
+    else {
+        slot = (int)(expires >> (NSC_WHEEL_BITS * level)) & (NSC_WHEEL_SLOTS - 1);
+    }
+
+    timerLink(&wheel->slots[level][slot], timer);
+    wheel->occupied[level] |= 1ULL << slot;
+}
+
+// Move the timers of a slot to a lower level (or keep them at the top level if they are beyond the wheel)
+static void wheelCascade(NSC_TimerWheel* wheel, int level, int slot) {
+    NSC_Timer* head = &wheel->slots[level][slot];
+    NSC_Timer pending;
+    pending.next = pending.prev = &pending;
+
+    // Take the whole list first, as the timers can be inserted back in the same slot
+    if (head->next != head) {
+        pending.next = head->next;
+        pending.prev = head->prev;
+        pending.next->prev = &pending;
+        pending.prev->next = &pending;
+        head->next = head->prev = head;
+    }
+    wheel->occupied[level] &= ~(1ULL << slot);
+
+    while (pending.next != &pending) {
+        NSC_Timer* timer = pending.next;
+        timerUnlink(timer);
+        wheelInsert(wheel, timer);
+    }
+}
+
+static int wheelEmpty(const NSC_TimerWheel* wheel) {
+    for (int level = 0; level < NSC_WHEEL_LEVELS; level++) {
+        if (wheel->occupied[level] != 0) return 0;
+    }
+    return 1;
+}
+
+void nscTimerWheelInit(NSC_TimerWheel* wheel) {
+    for (int level = 0; level < NSC_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < NSC_WHEEL_SLOTS; slot++) {
+            wheel->slots[level][slot].next = &wheel->slots[level][slot];
+            wheel->slots[level][slot].prev = &wheel->slots[level][slot];
+        }
+        wheel->occupied[level] = 0;
+    }
+    wheel->now = currentTick();
+}
+
+void nscTimerInit(NSC_Timer* timer, void (*callback)(NSC_Timer* timer, void* context), void* context) {
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expires = 0;
+    timer->callback = callback;
+    timer->context = context;
+}
+
+void nscTimerSchedule(NSC_TimerWheel* wheel, NSC_Timer* timer, uint32_t delay) {
+    if (timer->next != NULL) timerUnlink(timer);
+    timer->expires = currentTick() + delay;
+    if (timer->expires <= wheel->now) timer->expires = wheel->now + 1;
+    wheelInsert(wheel, timer);
+}
+
+void nscTimerCancel(NSC_Timer* timer) {
+    // The slot's bit is cleared lazily, when the slot is next visited
+    if (timer->next != NULL) timerUnlink(timer);
+}
+
+int nscTimerPending(const NSC_Timer* timer) {
+    return timer->next != NULL;
+}
+
+int nscTimerWheelAdvance(NSC_TimerWheel* wheel) {
+    uint64_t target = currentTick();
+    int expired = 0;
+
+    while (wheel->now < target) {
+        if (wheelEmpty(wheel)) {
+            wheel->now = target; // Nothing to run, jump directly
+            break;
+        }
+        wheel->now++;
+        uint64_t tick = wheel->now;
+
+        // Cascade the higher levels whose slot starts now (from the top, they can fill the lower ones)
+        for (int level = NSC_WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((tick & ((1ULL << (NSC_WHEEL_BITS * level)) - 1)) == 0) {
+                wheelCascade(wheel, level, (int)(tick >> (NSC_WHEEL_BITS * level)) & (NSC_WHEEL_SLOTS - 1));
+            }
+        }
+
+        // Run the timers of the level 0's slot
+        int slot = (int)tick & (NSC_WHEEL_SLOTS - 1);
+        NSC_Timer* head = &wheel->slots[0][slot];
+        wheel->occupied[0] &= ~(1ULL << slot);
+        if (head->next == head) continue;
+
+        // Detach the slot's list : callbacks can schedule (even in this slot) or cancel timers
+        NSC_Timer due;
+        due.next = head->next;
+        due.prev = head->prev;
+        due.next->prev = &due;
+        due.prev->next = &due;
+        head->next = head->prev = head;
+
+        while (due.next != &due) {
+            NSC_Timer* timer = due.next;
+            timerUnlink(timer);
+            expired++;
+            timer->callback(timer, timer->context);
+        }
+    }
+    return expired;
+}
+
+int nscTimerWheelNextTimeout(NSC_TimerWheel* wheel, int maxTimeout) {
+    uint64_t now = currentTick();
+
+    for (int level = 0; level < NSC_WHEEL_LEVELS; level++) {
+        int shift = NSC_WHEEL_BITS * level;
+        int current = (int)(wheel->now >> shift) & (NSC_WHEEL_SLOTS - 1);
+        // The slots of the level still to come in the current cycle
+        uint64_t bits = (current == NSC_WHEEL_SLOTS - 1) ? 0 : wheel->occupied[level] & (~0ULL << (current + 1));
+
+        while (bits != 0) {
+            int slot = lowestBit(bits);
+            NSC_Timer* head = &wheel->slots[level][slot];
+            if (head->next == head) {
+                wheel->occupied[level] &= ~(1ULL << slot); // Emptied by nscTimerCancel
+                bits &= bits - 1;
+                continue;
+            }
+            // Start of the slot : the expiration itself at level 0, the cascade of the slot above
+            uint64_t base = (wheel->now >> (shift + NSC_WHEEL_BITS)) << (shift + NSC_WHEEL_BITS);
+            uint64_t deadline = base + ((uint64_t)slot << shift);
+            if (deadline <= now) return 0;
+            return (deadline - now < (uint64_t)maxTimeout) ? (int)(deadline - now) : maxTimeout;
+        }
+    }
+    return maxTimeout;
+}
+
+// Callback of the connections' timers : the connection is handled by serverListen (see processTimeouts)
+static void connectionTimerExpired(NSC_Timer* timer, void* context) {
+    Server* server = (Server*)context;
+    timerLink(&server->expiredConnections, timer);
+}
+
+// Schedule the timeout timer of a server's connection according to its activity
+static void scheduleConnectionTimer(Server* server, Client* client, uint64_t now) {
+    uint64_t deadline = UINT64_MAX;
+    if (server->idleTimeout != 0) deadline = client->lastActivity + server->idleTimeout;
+    if (server->readTimeout != 0 && client->partialSince != 0 && client->partialSince + server->readTimeout < deadline) {
+        deadline = client->partialSince + server->readTimeout;
+    }
+
+    if (deadline == UINT64_MAX) {
+        nscTimerCancel(&client->timer);
+    }
+    else {
+        nscTimerSchedule(&server->timers, &client->timer, (deadline > now) ? (uint32_t)(deadline - now) : 0);
+    }
+}
+
+static uint32_t lzRead32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static uint32_t lzHash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Byte at a position of the window made of the dictionary followed by the input
+#define lzWindowByte(dict, dictLen, src, pos) (((pos) < (dictLen)) ? (dict)[pos] : (src)[(pos) - (dictLen)])
+
+/*
+    Parameters:
+        - const uint8_t* dict : The dictionary (NULL if none), followed by the input in the window
+        - uint32_t dictLen : The length of the dictionary
+        - const uint8_t* src : The input
+        - uint32_t candidate : The window position of the match
+        - uint32_t pos : The input position being matched (after candidate in the window)
+        - uint32_t len : The length of the input
+    Output:
+        - uint32_t : The number of bytes equal from these positions
+*/
+static uint32_t lzMatchLength(const uint8_t* dict, uint32_t dictLen, const uint8_t* src, uint32_t candidate, uint32_t pos, uint32_t len) {
+    uint32_t n = 0;
+    while (candidate + n < dictLen && pos + n < len) {
+        if (dict[candidate + n] != src[pos + n]) return n;
+        n++;
+    }
+
+    // The rest of the match is in the input, compared by words
+    const uint8_t* a = src + (candidate + n - dictLen);
+    const uint8_t* b = src + pos + n;
+    while (pos + n + 8 <= len) {
+        uint64_t x, y;
+        memcpy(&x, a, 8);
+        memcpy(&y, b, 8);
+        if (x != y) return n + (lowestBit(x ^ y) >> 3); // Little-endian : first different byte
+        a += 8;
+        b += 8;
+        n += 8;
+    }
+    while (pos + n < len && *a == *b) {
+        a++;
+        b++;
+        n++;
+    }
+    return n;
+}
+
+// Write a length continuing a token's nibble (15 + bytes of 255 + the rest)
+static uint8_t* lzWriteLength(uint8_t* out, uint32_t len) {
+    while (len >= 255) {
+        *out++ = 255;
+        len -= 255;
+    }
+    *out++ = (uint8_t)len;
+    return out;
+}
+
+/*
+    Parameters:
+        - uint8_t* out : The output position
+        - uint8_t* outEnd : The end of the output
+        - const uint8_t* literals : The literals of the sequence
+        - uint32_t numLiterals : Their number
+        - uint32_t offset : The distance of the match
+        - uint32_t matchLen : The length of the match (0 for the last sequence)
+    Output:
+        - uint8_t* : The position after the sequence, NULL if it does not fit
+*/
+static uint8_t* lzWriteSequence(uint8_t* out, uint8_t* outEnd, const uint8_t* literals, uint32_t numLiterals, uint32_t offset, uint32_t matchLen) {
+    if ((size_t)(outEnd - out) < (size_t)numLiterals + numLiterals / 255 + matchLen / 255 + 8) return NULL;
+
+    uint8_t* token = out++;
+    *token = (uint8_t)(((numLiterals < 15) ? numLiterals : 15) << 4);
+    if (numLiterals >= 15) out = lzWriteLength(out, numLiterals - 15);
+    memcpy(out, literals, numLiterals);
+    out += numLiterals;
+
+    if (matchLen == 0) return out; // Last sequence : literals only
+
+    *out++ = (uint8_t)(offset & 0xFF);
+    *out++ = (uint8_t)(offset >> 8);
+    matchLen -= LZ_MIN_MATCH;
+    *token |= (uint8_t)((matchLen < 15) ? matchLen : 15);
+    if (matchLen >= 15) out = lzWriteLength(out, matchLen - 15);
+    return out;
+}
+
+/*
+    Parameters:
+        - const NSC_Dictionary* dictionary : The dictionary (NULL if none)
+        - const uint8_t* src : The data to compress
+        - uint32_t len : Its length
+        - uint8_t* dst : The output
+        - uint32_t capacity : The size of the output
+    Output:
+        - uint32_t : The compressed size, 0 if it does not fit in capacity
+    Description:
+        This function compresses the data in the LZ4 block format (greedy parsing, one hash probe per position),
+        the matches can reference the dictionary, seen as the data preceding the input.
+        It skips faster and faster in incompressible data.
+*/
+static uint32_t lzCompress(const NSC_Dictionary* dictionary, const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t capacity) {
+    const uint8_t* dict = (dictionary != NULL) ? dictionary->data : NULL;
+    uint32_t dictLen = (dictionary != NULL) ? dictionary->len : 0;
+    uint32_t table[LZ_HASH_SIZE]; // Window positions + 1 (0 : empty)
+    if (dictionary != NULL) memcpy(table, dictionary->table, sizeof(table));
+    else memset(table, 0, sizeof(table));
+
+    uint8_t* out = dst;
+    uint8_t* outEnd = dst + capacity;
+    uint32_t anchor = 0; // First literal not written yet
+    uint32_t pos = 0;
+
+    while (len >= LZ_MIN_MATCH && pos <= len - LZ_MIN_MATCH) {
+        uint32_t sequence = lzRead32(src + pos);
+        uint32_t hash = lzHash(sequence);
+        uint32_t candidate = table[hash];
+        uint32_t windowPos = dictLen + pos;
+        table[hash] = windowPos + 1;
+
+        if (candidate != 0 && windowPos - (candidate - 1) <= LZ_MAX_OFFSET) {
+            candidate--;
+            uint32_t matchLen = lzMatchLength(dict, dictLen, src, candidate, pos, len);
+            if (matchLen >= LZ_MIN_MATCH) {
+                out = lzWriteSequence(out, outEnd, src + anchor, pos - anchor, windowPos - candidate, matchLen);
+                if (out == NULL) return 0;
+                pos += matchLen;
+                anchor = pos;
+                // Index the end of the match, the next search often starts there
+                if (pos <= len - LZ_MIN_MATCH + 2 && pos >= 2) table[lzHash(lzRead32(src + pos - 2))] = dictLen + pos - 2 + 1;
+                continue;
+            }
+        }
+        pos += 1 + ((pos - anchor) >> 6);
+    }
+
+    out = lzWriteSequence(out, outEnd, src + anchor, len - anchor, 0, 0);
+    return (out != NULL) ? (uint32_t)(out - dst) : 0;
+}
+
+/*
+    Parameters:
+        - const NSC_Dictionary* dictionary : The dictionary of the compression (NULL if none)
+        - const uint8_t* src : The compressed data
+        - uint32_t srcLen : Its length
+        - uint8_t* dst : The output
+        - uint32_t dstLen : The original size
+    Output:
+        - int : 0 if exactly dstLen bytes were decompressed, -1 if the data is corrupted
+    Description:
+        This function decompresses LZ4 block data, checking every length and offset against the buffers.
+*/
+static int lzDecompress(const NSC_Dictionary* dictionary, const uint8_t* src, uint32_t srcLen, uint8_t* dst, uint32_t dstLen) {
+    const uint8_t* dict = (dictionary != NULL) ? dictionary->data : NULL;
+    uint32_t dictLen = (dictionary != NULL) ? dictionary->len : 0;
+    const uint8_t* in = src;
+    const uint8_t* inEnd = src + srcLen;
+    uint32_t pos = 0;
+
+    while (in < inEnd) {
+        uint8_t token = *in++;
+
+        uint32_t numLiterals = token >> 4;
+        if (numLiterals == 15) {
+            uint8_t byte;
+            do {
+                if (in >= inEnd) return -1;
+                byte = *in++;
+                numLiterals += byte;
+            } while (byte == 255 && numLiterals < dstLen);
+        }
+        if (numLiterals > (uint32_t)(inEnd - in) || numLiterals > dstLen - pos) return -1;
+        memcpy(dst + pos, in, numLiterals);
+        in += numLiterals;
+        pos += numLiterals;
+
+        if (in == inEnd) break; // Last sequence
+
+        if (inEnd - in < 2) return -1;
+        uint32_t offset = in[0] | ((uint32_t)in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > pos + dictLen) return -1;
+
+        uint32_t matchLen = token & 15;
+        if (matchLen == 15) {
+            uint8_t byte;
+            do {
+                if (in >= inEnd) return -1;
+                byte = *in++;
+                matchLen += byte;
+            } while (byte == 255 && matchLen < dstLen);
+        }
+        matchLen += LZ_MIN_MATCH;
+        if (matchLen > dstLen - pos) return -1;
+
+        if (offset > pos) {
+            // The match starts in the dictionary
+            uint32_t fromDict = offset - pos;
+            uint32_t start = dictLen - fromDict;
+            uint32_t count = (matchLen < fromDict) ? matchLen : fromDict;
+            memcpy(dst + pos, dict + start, count);
+            pos += count;
+            matchLen -= count;
+        }
+        if (matchLen > 0) {
+            if (offset >= matchLen) {
+                memcpy(dst + pos, dst + pos - offset, matchLen);
+                pos += matchLen;
+            }
+            else {
+                // Overlapping match : repeats the last offset bytes
+                for (uint32_t i = 0; i < matchLen; i++, pos++) dst[pos] = dst[pos - offset];
+            }
+        }
+    }
+    return (pos == dstLen) ? 0 : -1;
+}
+
+NSC_Dictionary* nscCreateDictionary(const char* data, uint32_t len) {
+    // Matches reach 64 KB back at most, older bytes are never referenced
+    if (len > LZ_MAX_OFFSET) {
+        data += len - LZ_MAX_OFFSET;
+        len = LZ_MAX_OFFSET;
+    }
+
+    NSC_Dictionary* dictionary = (NSC_Dictionary*)memAlloc(&globalAllocator, sizeof(NSC_Dictionary));
+    if (!dictionary) return NULL;
+    dictionary->data = (uint8_t*)memAlloc(&globalAllocator, len + 1);
+    if (!dictionary->data) {
+        memFree(&globalAllocator, dictionary);
+        return NULL;
+    }
+    memcpy(dictionary->data, data, len);
+    dictionary->len = len;
+    dictionary->allocator = globalAllocator;
+
+    // FNV-1a hash of the content
+    dictionary->id = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) {
+        dictionary->id = (dictionary->id ^ dictionary->data[i]) * 16777619u;
+    }
+
+    memset(dictionary->table, 0, sizeof(dictionary->table));
+    for (uint32_t i = 0; i + LZ_MIN_MATCH <= len; i++) {
+        dictionary->table[lzHash(lzRead32(dictionary->data + i))] = i + 1;
+    }
+    return dictionary;
+}
+
+void nscFreeDictionary(NSC_Dictionary* dictionary) {
+    if (dictionary == NULL) return;
+    NSC_Allocator allocator = dictionary->allocator;
+    memFree(&allocator, dictionary->data);
+    memFree(&allocator, dictionary);
+}
+
+/*
+    Parameters:
+        - Client* client : The connection that received the message
+        - uint32_t flags : The flags of the message's header
+        - const char* body : The body of the message
+        - uint32_t len : Its length
+        - char** msg : Receives the decompressed message
+    Output:
+        - int : The length of the decompressed message, READMSG_MSG_TOO_LARGE if it is invalid,
+                READMSG_ALLOC_FAILED if the allocation failed
+*/
+static int decompressFrame(Client* client, uint32_t flags, const char* body, uint32_t len, char** msg) {
+    uint32_t headerSize = (flags & NSC_FRAME_DICTIONARY) ? 8 : 4;
+    if (len < headerSize) {
+        statAdd(*client->stats, decompressErrors, 1);
+        return READMSG_MSG_TOO_LARGE;
+    }
+
+    uint32_t originalLen;
+    memcpy(&originalLen, body, 4);
+    originalLen = ntohl(originalLen);
+
+    NSC_Dictionary* dictionary = NULL;
+    if (flags & NSC_FRAME_DICTIONARY) {
+        uint32_t id;
+        memcpy(&id, body + 4, 4);
+        dictionary = (client->extension->compression != NULL) ? client->extension->compression->dictionary : NULL;
+        if (dictionary == NULL || dictionary->id != ntohl(id)) dictionary = NULL;
+    }
+    if (originalLen == 0 || originalLen > (uint32_t)client->bufferData.size - 4 || ((flags & NSC_FRAME_DICTIONARY) && dictionary == NULL)) {
+        statAdd(*client->stats, decompressErrors, 1);
+        return READMSG_MSG_TOO_LARGE;
+    }
+
+    *msg = (char*)memAlloc(client->allocator, originalLen + 1); // Allocate space for message + null terminator
+    if (!*msg) return READMSG_ALLOC_FAILED;
+    statAdd(*client->stats, allocations, 1);
+
+    uint64_t start = statClock();
+    int status = lzDecompress(dictionary, (const uint8_t*)body + headerSize, len - headerSize, (uint8_t*)*msg, originalLen);
+    statAdd(*client->stats, decompressNs, nscMonotonicNs() - start);
+    if (status != 0) {
+        memFree(client->allocator, *msg);
+        *msg = NULL;
+        statAdd(*client->stats, decompressErrors, 1);
+        return READMSG_MSG_TOO_LARGE;
+    }
+    (*msg)[originalLen] = '\0';
+
+    statAdd(*client->stats, framesIn, 1);
+    statAdd(*client->stats, decompressedFrames, 1);
+    return originalLen;
+}
+
+// Copy the options (NULL : none) and fill in the defaults
+static NSC_Options resolveOptions(const NSC_Options* options) {
+    NSC_Options resolved;
+    if (options != NULL) resolved = *options;
+    else memset(&resolved, 0, sizeof(resolved));
+
+    if (resolved.maxClients <= 0) resolved.maxClients = MaxClients;
+    if (resolved.maxClients > NSC_ID_SLOTS) resolved.maxClients = NSC_ID_SLOTS;
+    if (resolved.bufferSize <= 0) resolved.bufferSize = BufferSize;
+    if (resolved.bufferSize < 8) resolved.bufferSize = 8;
+    if (resolved.eventBlock <= 0) resolved.eventBlock = EventBlock;
+    if (resolved.sharedMemory > 0) {
+        uint32_t size = RING_MIN_SIZE;
+        while (size < (uint32_t)resolved.sharedMemory && size < RING_MAX_SIZE) size <<= 1;
+        resolved.sharedMemory = (int)size;
+    }
+    if (resolved.streamChunk > resolved.bufferSize - 4 - STREAM_CHUNK_HEADER) resolved.streamChunk = resolved.bufferSize - 4 - STREAM_CHUNK_HEADER;
+    if (resolved.pollTimeout == 0) resolved.pollTimeout = 10;
+    else if (resolved.pollTimeout < 0) resolved.pollTimeout = 0;
+    return resolved;
+}
+
+// Address family of an IP type
+static int addressFamily(int ipType) {
+    if (ipType == IPv4) return AF_INET;
+    if (ipType == IPv6) return AF_INET6;
+    return AF_UNIX;
+}
+
+#if defined (__linux__)
+/*
+    Parameters:
+        - struct sockaddr_un* address : The address to set
+        - const char* path : The socket's path, '@' first for a name in the abstract namespace
+    Output:
+        - socklen_t : The length of the address (0 if the path is empty or too long)
+    Description:
+        This function sets the address of a UNIX domain socket.
+*/
+static socklen_t setUnixAddress(struct sockaddr_un* address, const char* path) {
+    size_t len = strlen(path);
+    if (len == 0 || len >= sizeof(address->sun_path)) return 0;
+
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    memcpy(address->sun_path, path, len);
+    if (path[0] == '@') {
+        // Abstract namespace : the name is the bytes after a null one, its length is the address' one
+        address->sun_path[0] = '\0';
+        return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len);
+    }
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len + 1);
+}
+
+// Length of the address of a UNIX domain socket (an abstract name ends at its first null byte)
+static socklen_t unixAddressLength(const struct sockaddr_un* address) {
+    if (address->sun_path[0] == '\0') {
+        return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + strnlen(address->sun_path + 1, sizeof(address->sun_path) - 1));
+    }
+    return (socklen_t)sizeof(*address);
+}
+#endif
+
+// Send a datagram to an address, 0 if it was sent whole
+static int sendDatagram(SOCKET socket, const char* msg, uint32_t len, int ipType, SIN* sin, NSC_Stats* stats) {
+    int sent = SOCKET_ERROR;
+    if (ipType == IPv4) {
+        sent = sendto(socket, msg, len, 0, (SOCKADDR*)&sin->in, sizeof(sin->in));
+    }
+    else if (ipType == IPv6) {
+        sent = sendto(socket, msg, len, 0, (SOCKADDR*)&sin->in6, sizeof(sin->in6));
+    }
+#if defined (__linux__)
+    else if (ipType == UNIX) {
+        sent = sendto(socket, msg, len, 0, (SOCKADDR*)&sin->un, unixAddressLength(&sin->un));
+    }
+#endif
+    statAdd(*stats, sendCalls, 1);
+    if (sent < 0 && wouldBlock()) statAdd(*stats, eagainHits, 1);
+    if (sent > 0) statAdd(*stats, bytesOut, sent);
+    return (sent == (int)len) ? 0 : -1;
+}
+
+// Reliable UDP (see enableServerReliable) : every datagram of a connection is a packet
+// [kind : 1][channel : 1][fragment : 2][fragments : 2][fragment size : 2][packet : 4][message : 4][cumulative ack : 4][ack bits : 4][payload]
+// The cumulative ack is the first packet not received, bit i of the ack bits is set if the packet cumulative ack + 1 + i was received
+#define RUDP_HEADER 24
+#define RUDP_MAGIC 0xA0 // High bits of the kind, the other datagrams are dropped
+#define RUDP_DATA 1 // Unreliable message (not acknowledged)
+#define RUDP_RELIABLE 2 // Reliable message (acknowledged, retransmitted)
+#define RUDP_ACK 3 // Acknowledgements only
+#define RUDP_WINDOW 256 // Maximum number of reliable packets in flight (power of two)
+#define RUDP_DEFAULT_MTU 1200
+#define RUDP_MAX_MESSAGE (1 << 24)
+#define RUDP_MIN_RTO 10000 // Bounds of the retransmission timeout (us)
+#define RUDP_MAX_RTO 2000000
+#define RUDP_INITIAL_RTO 200000
+#define RUDP_LOST_TIMEOUT 10000000 // A packet unacknowledged for this long (us) means the peer is lost
+#define RUDP_INITIAL_WINDOW 8 // Congestion window (packets) at start
+#define RUDP_DUP_THRESHOLD 3 // Later packets acknowledged before a missing one is sent again without waiting for its timeout
+
+// A reliable packet waiting for room in the congestion window, then for its acknowledgement
+typedef struct RudpPacket {
+    struct RudpPacket* next; // Next packet of the queue
+    uint64_t sentAt; // Time (us) of the first transmission
+    uint64_t retransmitAt; // Time (us) of the next transmission
+    uint32_t seq;
+    uint32_t len; // Header included
+    uint32_t retries; // Transmissions after the first one
+    uint8_t data[]; // The packet
+} RudpPacket;
+
+// A message being reassembled, held until the previous ones of its channel are delivered, or ready to be delivered
+typedef struct RudpMessage {
+    struct RudpMessage* next;
+    int channel;
+    uint32_t seq; // Sequence of the message in its channel
+    uint32_t len;
+    char* data;
+    uint8_t* fragments; // 1 for each fragment received (reassembly only)
+    uint32_t numFragments;
+    uint32_t fragmentSize; // Bytes per fragment, the same in every packet of the message
+    uint32_t received;
+} RudpMessage;
+
+// Reliable UDP state of a connection
+struct NSC_Reliable {
+    NSC_ReliableOptions options;
+    uint32_t fragmentSize; // Bytes of message per packet (mtu - RUDP_HEADER)
+    uint32_t maxMessage; // Largest message received (bufferSize - 1, like a datagram)
+    uint32_t random; // State of the loss injection (xorshift)
+    uint8_t* scratch; // Packets of the unreliable messages (mtu bytes)
+    int lost; // 1 once a packet stayed unacknowledged for RUDP_LOST_TIMEOUT
+
+    // Sending
+    uint32_t nextPacket; // Sequence of the next reliable packet
+    uint32_t sendBase; // Oldest packet not acknowledged
+    RudpPacket* window[RUDP_WINDOW]; // Packets in flight by sequence (NULL : acknowledged)
+    uint32_t inFlight;
+    RudpPacket* queueHead; // Packets waiting for room in the congestion window
+    RudpPacket* queueTail;
+    uint32_t queued;
+    uint32_t nextMessage[NSC_MAX_CHANNELS]; // Sequence of the next message of each channel
+
+    // Congestion control (AIMD, in packets) and round-trip time (RFC 6298, in us)
+    uint32_t cwnd;
+    uint32_t cwndCount; // Acknowledgements counted towards the next increase in congestion avoidance
+    uint32_t ssthresh;
+    int inRecovery; // 1 after a loss, until the packets sent before it are acknowledged
+    uint32_t recoveryPoint;
+    uint64_t srtt;
+    uint64_t rttvar;
+    uint64_t rto;
+
+    // Receiving
+    uint32_t recvBase; // Every packet before it was received
+    uint8_t recvMap[RUDP_WINDOW]; // 1 for the packets received after recvBase
+    int ackPending; // 1 if packets were received since the last acknowledgement sent
+    uint32_t deliverNext[NSC_MAX_CHANNELS]; // Next message to deliver (ordered), or the one after the last delivered (sequenced)
+    RudpMessage* partial; // Messages being reassembled
+    uint32_t numPartial; // At most RUDP_WINDOW
+    RudpMessage* held; // Complete messages of ordered channels waiting for the previous ones
+    uint32_t numHeld; // At most RUDP_WINDOW
+    RudpMessage* readyHead; // Messages to deliver, in order
+    RudpMessage* readyTail;
+};
+
+static void rudpWrite16(uint8_t* p, uint16_t value) {
+    value = htons(value);
+    memcpy(p, &value, 2);
+}
+
+static void rudpWrite32(uint8_t* p, uint32_t value) {
+    value = htonl(value);
+    memcpy(p, &value, 4);
+}
+
+static uint16_t rudpRead16(const uint8_t* p) {
+    uint16_t value;
+    memcpy(&value, p, 2);
+    return ntohs(value);
+}
+
+static uint32_t rudpRead32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return ntohl(value);
+}
+
+// Time of reliable UDP (us)
+static uint64_t rudpNow() {
+    return nscMonotonicNs() / 1000;
+}
+
+static void rudpHeader(uint8_t* packet, int kind, int channel, uint32_t fragment, uint32_t numFragments, uint32_t fragmentSize, uint32_t message) {
+    packet[0] = (uint8_t)(RUDP_MAGIC | kind);
+    packet[1] = (uint8_t)channel;
+    rudpWrite16(packet + 2, (uint16_t)fragment);
+    rudpWrite16(packet + 4, (uint16_t)numFragments);
+    rudpWrite16(packet + 6, (uint16_t)fragmentSize);
+    rudpWrite32(packet + 8, 0);
+    rudpWrite32(packet + 12, message);
+}
+
+// Send a packet with the current acknowledgements (the loss injection may drop it)
+static void rudpTransmit(Client* peer, uint8_t* packet, uint32_t len) {
+    struct NSC_Reliable* reliable = peer->extension->reliable;
+    uint32_t bits = 0;
+    for (uint32_t i = 0; i < 32; i++) {
+        if (reliable->recvMap[(reliable->recvBase + 1 + i) & (RUDP_WINDOW - 1)]) bits |= 1u << i;
+    }
+    rudpWrite32(packet + 16, reliable->recvBase);
+    rudpWrite32(packet + 20, bits);
+    reliable->ackPending = 0;
+
+    if (reliable->options.lossPercent != 0) {
+        reliable->random ^= reliable->random << 13;
+        reliable->random ^= reliable->random >> 17;
+        reliable->random ^= reliable->random << 5;
+        if (reliable->random % 100 < reliable->options.lossPercent) {
+            statAdd(*peer->stats, injectedLosses, 1);
+            return;
+        }
+    }
+    sendDatagram(peer->socket, (const char*)packet, len, peer->ipType, &peer->sin, peer->stats);
+}
+
+// Send the queued packets the congestion window has room for
+static void rudpFlush(Client* peer, uint64_t now) {
+    struct NSC_Reliable* reliable = peer->extension->reliable;
+    while (reliable->queueHead != NULL && reliable->inFlight < reliable->cwnd && reliable->nextPacket - reliable->sendBase < RUDP_WINDOW) {
+        RudpPacket* packet = reliable->queueHead;
+        reliable->queueHead = packet->next;
+        if (reliable->queueHead == NULL) reliable->queueTail = NULL;
+        reliable->queued--;
+
+        packet->seq = reliable->nextPacket++;
+        packet->sentAt = now;
+        packet->retransmitAt = now + reliable->rto;
+        rudpWrite32(packet->data + 8, packet->seq);
+        reliable->window[packet->seq & (RUDP_WINDOW - 1)] = packet;
+        reliable->inFlight++;
+        rudpTransmit(peer, packet->data, packet->len);
+    }
+}
+
+// Halve the congestion window once per window of packets
+static void rudpLoss(struct NSC_Reliable* reliable) {
+    if (reliable->inRecovery) return;
+    reliable->ssthresh = (reliable->cwnd / 2 > 2) ? reliable->cwnd / 2 : 2;
+    reliable->cwnd = reliable->ssthresh;
+    reliable->cwndCount = 0;
+    reliable->inRecovery = 1;
+    reliable->recoveryPoint = reliable->nextPacket;
+}
+
+// Send a packet in flight again
+static void rudpRetransmit(Client* peer, RudpPacket* packet, uint64_t now) {
+    struct NSC_Reliable* reliable = peer->extension->reliable;
+    packet->retries++;
+    uint64_t backoff = reliable->rto << ((packet->retries < 8) ? packet->retries : 8);
+    packet->retransmitAt = now + ((backoff < RUDP_MAX_RTO) ? backoff : RUDP_MAX_RTO);
+    statAdd(*peer->stats, retransmits, 1);
+    rudpTransmit(peer, packet->data, packet->len);
+}
+
+// A packet in flight was acknowledged
+static void rudpAcknowledged(Client* peer, uint32_t seq, uint64_t now) {
+    struct NSC_Reliable* reliable = peer->extension->reliable;
+    RudpPacket* packet = reliable->window[seq & (RUDP_WINDOW - 1)];
+    if (packet == NULL || packet->seq != seq) return;
+
+    // Round-trip time, only from packets sent once (Karn's algorithm)
+    if (packet->retries == 0) {
+        uint64_t sample = now - packet->sentAt;
+        if (reliable->srtt == 0) {
+            reliable->srtt = (sample > 0) ? sample : 1;
+            reliable->rttvar = sample / 2;
+        }
+        else {
+            uint64_t deviation = (reliable->srtt > sample) ? reliable->srtt - sample : sample - reliable->srtt;
+            reliable->rttvar = (3 * reliable->rttvar + deviation) / 4;
+            reliable->srtt = (7 * reliable->srtt + sample) / 8;
+        }
+        uint64_t rto = reliable->srtt + ((4 * reliable->rttvar > 1000) ? 4 * reliable->rttvar : 1000);
+        reliable->rto = (rto < RUDP_MIN_RTO) ? RUDP_MIN_RTO : (rto > RUDP_MAX_RTO) ? RUDP_MAX_RTO : rto;
+    }
+
+    // Slow start, then one more packet per window acknowledged
+    if (reliable->inRecovery && (int32_t)(seq - reliable->recoveryPoint) >= 0) reliable->inRecovery = 0;
+    if (!reliable->inRecovery) {
+        if (reliable->cwnd < reliable->ssthresh) {
+            reliable->cwnd++;
+        }
+        else if (++reliable->cwndCount >= reliable->cwnd) {
+            reliable->cwnd++;
+            reliable->cwndCount = 0;
+        }
+        if (reliable->cwnd > RUDP_WINDOW) reliable->cwnd = RUDP_WINDOW;
+    }
+
+    reliable->window[seq & (RUDP_WINDOW - 1)] = NULL;
+    reliable->inFlight--;
+    memFree(peer->allocator, packet);
+}
+
+// Process the acknowledgements carried by a packet
+static void rudpProcessAcks(Client* peer, uint32_t cumulative, uint32_t bits, uint64_t now) {
+    struct NSC_Reliable* reliable = peer->extension->reliable;
+    if ((int32_t)(cumulative - reliable->nextPacket) > 0 || (int32_t)(cumulative - reliable->sendBase) < 0) return; // Out of date
+
+    while (reliable->sendBase != cumulative) {
+        rudpAcknowledged(peer, reliable->sendBase, now);
+        reliable->sendBase++;
+    }
+    uint32_t highest = cumulative;
+    for (uint32_t i = 0; i < 32 && bits != 0; i++) {
+        if (!(bits & (1u << i))) continue;
+        uint32_t seq = cumulative + 1 + i;
+        if ((int32_t)(seq - reliable->nextPacket) >= 0) break;
+        rudpAcknowledged(peer, seq, now);
+        highest = seq;
+    }
+
+    // The packets acknowledged after a missing one tell it was lost : it is sent again right away
+    for (uint32_t seq = reliable->sendBase; (int32_t)(highest - seq) >= RUDP_DUP_THRESHOLD; seq++) {
+        RudpPacket* packet = reliable->window[seq & (RUDP_WINDOW - 1)];
+        if (packet == NULL || packet->retries != 0) continue;
+        rudpLoss(reliable);
+        rudpRetransmit(peer, packet, now);
+    }
+    rudpFlush(peer, now);
+}
+
+// Free a list of messages
+static void rudpFreeMessages(Client* peer, RudpMessage* message) {
+    while (message != NULL) {
+        RudpMessage* next = message->next;
+        memFree(peer->allocator, message->data);
+        memFree(peer->allocator, message->fragments);
+        memFree(peer->allocator, message);
+        message = next;
+    }
+}
+
+// Add a complete message to the messages to deliver
+static void rudpReady(struct NSC_Reliable* reliable, RudpMessage* message) {
+    message->next = NULL;
+    if (reliable->readyTail != NULL) reliable->readyTail->next = message;
+    else reliable->readyHead = message;
+    reliable->readyTail = message;
+}
+
+// A message is complete : deliver it according to the type of its channel
+static void rudpComplete(Client* peer, RudpMessage* message) {
+    struct NSC_Reliable* reliable = peer->extension->reliable;
+    int channel = message->channel;
+    int32_t distance = (int32_t)(message->seq - reliable->deliverNext[channel]);
+    switch (reliable->options.channelTypes[channel]) {
+        case ChannelReliableOrdered:
+            if (distance < 0) break;
+            if (distance > 0) {
+                // Held until the previous messages of the channel are delivered
+                // (a peer can't have more in the packets' window, the others are dropped)
+                if (reliable->numHeld >= RUDP_WINDOW) break;
+                message->next = reliable->held;
+                reliable->held = message;
+                reliable->numHeld++;
+                return;
+            }
+            rudpReady(reliable, message);
+            reliable->deliverNext[channel]++;
+            for (int found = 1; found; ) {
+                found = 0;
+                for (RudpMessage** link = &reliable->held; *link != NULL; link = &(*link)->next) {
+                    RudpMessage* held = *link;
+                    if (held->channel == channel && held->seq == reliable->deliverNext[channel]) {
+                        *link = held->next;
+                        reliable->numHeld--;
+                        rudpReady(reliable, held);
+                        reliable->deliverNext[channel]++;
+                        found = 1;
+                        break;
+                    }
+                }
+            }
+            return;
+        case ChannelReliableUnordered:
+            rudpReady(reliable, message);
+            return;
+        default:
+            if (distance < 0) break; // Older than the last message delivered
+            reliable->deliverNext[channel] = message->seq + 1;
+            rudpReady(reliable, message);
+            // The older messages of the channel being reassembled will not be delivered
+            for (RudpMessage** link = &reliable->partial; *link != NULL; ) {
+                RudpMessage* partial = *link;
+                if (partial->channel == channel && (int32_t)(partial->seq - message->seq) < 0) {
+                    *link = partial->next;
+                    reliable->numPartial--;
+                    partial->next = NULL;
+                    rudpFreeMessages(peer, partial);
+                }
+                else {
+                    link = &partial->next;
+                }
+            }
+            return;
+    }
+    message->next = NULL;
+    rudpFreeMessages(peer, message);
+}
+
+// Add a fragment to its message (a whole message if it has one fragment)
+static void rudpFragment(Client* peer, int channel, uint32_t seq, uint32_t fragment, uint32_t numFragments, uint32_t fragmentSize, const uint8_t* payload, uint32_t len) {
+    struct NSC_Reliable* reliable = peer->extension->reliable;
+    if (numFragments == 0 || fragment >= numFragments || len > fragmentSize || (fragment + 1 < numFragments && len != fragmentSize)) return;
+    // Messages are limited to the buffer's size, like the datagrams
+    if ((uint64_t)(numFragments - 1) * fragmentSize >= reliable->maxMessage) return;
+    if (fragment + 1 == numFragments && (uint64_t)fragment * fragmentSize + len > reliable->maxMessage) return;
+    if (reliable->options.channelTypes[channel] == ChannelUnreliableSequenced && (int32_t)(seq - reliable->deliverNext[channel]) < 0) return;
+    // The peer can't send an ordered message a window of packets ahead of the next one to deliver
+    if (reliable->options.channelTypes[channel] == ChannelReliableOrdered && seq - reliable->deliverNext[channel] >= RUDP_WINDOW) return;
+
+    RudpMessage* message = NULL;
+    for (RudpMessage** link = &reliable->partial; *link != NULL; link = &(*link)->next) {
+        if ((*link)->channel == channel && (*link)->seq == seq) {
+            message = *link;
+            if (message->numFragments != numFragments || message->fragmentSize != fragmentSize) return;
+            break;
+        }
+    }
+    if (message == NULL && numFragments > 1 && reliable->numPartial >= RUDP_WINDOW) {
+        // Too many messages being reassembled : the oldest unreliable one is given up, or the fragment dropped
+        RudpMessage** oldest = NULL;
+        for (RudpMessage** link = &reliable->partial; *link != NULL; link = &(*link)->next) {
+            if (reliable->options.channelTypes[(*link)->channel] == ChannelUnreliableSequenced) oldest = link;
+        }
+        if (oldest == NULL) return;
+        RudpMessage* evicted = *oldest;
+        *oldest = evicted->next;
+        reliable->numPartial--;
+        evicted->next = NULL;
+        rudpFreeMessages(peer, evicted);
+    }
+    if (message == NULL) {
+        message = (RudpMessage*)memCalloc(peer->allocator, 1, sizeof(RudpMessage));
+        if (!message) return;
+        message->channel = channel;
+        message->seq = seq;
+        message->numFragments = numFragments;
+        message->fragmentSize = fragmentSize;
+        message->data = (char*)memAlloc(peer->allocator, (size_t)numFragments * fragmentSize + 1);
+        if (numFragments > 1) message->fragments = (uint8_t*)memCalloc(peer->allocator, numFragments, 1);
+        if (!message->data || (numFragments > 1 && !message->fragments)) {
+            rudpFreeMessages(peer, message);
+            return;
+        }
+        statAdd(*peer->stats, allocations, (numFragments > 1) ? 3 : 2);
+        if (numFragments > 1) {
+            message->next = reliable->partial;
+            reliable->partial = message;
+            reliable->numPartial++;
+        }
+    }
+    else if (message->fragments[fragment]) {
+        return; // Duplicate
+    }
+
+    memcpy(message->data + (size_t)fragment * fragmentSize, payload, len);
+    if (fragment + 1 == numFragments) message->len = fragment * fragmentSize + len;
+    if (numFragments > 1) {
+        message->fragments[fragment] = 1;
+        if (++message->received < numFragments) return;
+        for (RudpMessage** link = &reliable->partial; *link != NULL; link = &(*link)->next) {
+            if (*link == message) {
+                *link = message->next;
+                reliable->numPartial--;
+                break;
+            }
+        }
+        memFree(peer->allocator, message->fragments);
+        message->fragments = NULL;
+    }
+    statAdd(*peer->stats, framesIn, 1);
+    rudpComplete(peer, message);
+}
+
+/*
+    Parameters:
+        - Client* peer : A connection with reliable UDP
+        - const char* datagram : A datagram received from its peer
+        - int len : Its length
+    Description:
+        This function processes a packet : its acknowledgements, then its fragment of message.
+        The complete messages are taken with rudpTakeMessage.
+*/
+static void rudpReceive(Client* peer, const char* datagram, int len) {
+    struct NSC_Reliable* reliable = peer->extension->reliable;
+    const uint8_t* packet = (const uint8_t*)datagram;
+    if (len < RUDP_HEADER || (packet[0] & 0xF0) != RUDP_MAGIC || packet[1] >= reliable->options.numChannels) return;
+    int kind = packet[0] & 0x0F;
+    uint64_t now = rudpNow();
+    rudpProcessAcks(peer, rudpRead32(packet + 16), rudpRead32(packet + 20), now);
+    if (kind == RUDP_ACK) return;
+
+    if (kind == RUDP_RELIABLE) {
+        uint32_t seq = rudpRead32(packet + 8);
+        int32_t offset = (int32_t)(seq - reliable->recvBase);
+        reliable->ackPending = 1; // Duplicates too : the acknowledgement may have been lost
+        if (offset < 0 || offset >= RUDP_WINDOW || reliable->recvMap[seq & (RUDP_WINDOW - 1)]) return;
+        reliable->recvMap[seq & (RUDP_WINDOW - 1)] = 1;
+        while (reliable->recvMap[reliable->recvBase & (RUDP_WINDOW - 1)]) {
+            reliable->recvMap[reliable->recvBase & (RUDP_WINDOW - 1)] = 0;
+            reliable->recvBase++;
+        }
+    }
+    else if (kind != RUDP_DATA || reliable->options.channelTypes[packet[1]] != ChannelUnreliableSequenced) {
+        return; // The messages of the reliable channels are acknowledged
+    }
+    rudpFragment(peer, packet[1], rudpRead32(packet + 12), rudpRead16(packet + 2), rudpRead16(packet + 4), rudpRead16(packet + 6),
+                 packet + RUDP_HEADER, (uint32_t)len - RUDP_HEADER);
+}
+
+// Take the next message to deliver (its data belongs to the caller), 0 if there is none
+static int rudpTakeMessage(Client* peer, int* channel, char** data, uint32_t* len) {
+    struct NSC_Reliable* reliable = peer->extension->reliable;
+    RudpMessage* message = reliable->readyHead;
+    if (message == NULL) return 0;
+    reliable->readyHead = message->next;
+    if (reliable->readyHead == NULL) reliable->readyTail = NULL;
+    *channel = message->channel;
+    *data = message->data;
+    *len = message->len;
+    memFree(peer->allocator, message);
+    return 1;
+}
+
+/*
+    Parameters:
+        - Client* peer : A connection with reliable UDP
+    Output:
+        - uint64_t : Time (us) of its next retransmission (UINT64_MAX if none)
+    Description:
+        This function retransmits the packets whose timeout expired, sends the queued packets the congestion window
+        has room for and the pending acknowledgement. peer->extension->reliable->lost is set if the peer stopped acknowledging.
+*/
+static uint64_t rudpUpdate(Client* peer) {
+    struct NSC_Reliable* reliable = peer->extension->reliable;
+    uint64_t now = rudpNow();
+    uint64_t deadline = UINT64_MAX;
+    int timedOut = 0;
+    for (uint32_t seq = reliable->sendBase; seq != reliable->nextPacket; seq++) {
+        RudpPacket* packet = reliable->window[seq & (RUDP_WINDOW - 1)];
+        if (packet == NULL) continue;
+        if (now - packet->sentAt >= RUDP_LOST_TIMEOUT) {
+            reliable->lost = 1;
+            return UINT64_MAX;
+        }
+        if (packet->retransmitAt <= now) {
+            if (!timedOut) {
+                // A timeout shrinks the window more than a loss detected by the acknowledgements
+                rudpLoss(reliable);
+                reliable->cwnd = 2;
+                timedOut = 1;
+            }
+            rudpRetransmit(peer, packet, now);
+        }
+        if (packet->retransmitAt < deadline) deadline = packet->retransmitAt;
+    }
+    rudpFlush(peer, now);
+
+    if (reliable->ackPending) {
+        uint8_t ack[RUDP_HEADER];
+        rudpHeader(ack, RUDP_ACK, 0, 0, 1, 0, 0);
+        rudpTransmit(peer, ack, RUDP_HEADER);
+    }
+    return deadline;
+}
+
+// Time (ms, rounded up) until the next retransmission of a connection, at most maxTimeout
+static int rudpTimeout(Client* peer, int maxTimeout) {
+    if (peer->extension->reliable->ackPending || peer->extension->reliable->lost) return 0;
+    uint64_t deadline = UINT64_MAX;
+    for (uint32_t seq = peer->extension->reliable->sendBase; seq != peer->extension->reliable->nextPacket; seq++) {
+        RudpPacket* packet = peer->extension->reliable->window[seq & (RUDP_WINDOW - 1)];
+        if (packet != NULL && packet->retransmitAt < deadline) deadline = packet->retransmitAt;
+    }
+    if (deadline == UINT64_MAX) return maxTimeout;
+    uint64_t now = rudpNow();
+    if (deadline <= now) return 0;
+    uint64_t timeout = (deadline - now + 999) / 1000;
+    return (maxTimeout >= 0 && timeout > (uint64_t)maxTimeout) ? maxTimeout : (int)timeout;
+}
+
+// Create the reliable UDP state of a connection
+static struct NSC_Reliable* rudpCreate(Client* peer, const NSC_ReliableOptions* options, int bufferSize) {
+    struct NSC_Reliable* reliable = (struct NSC_Reliable*)memCalloc(peer->allocator, 1, sizeof(struct NSC_Reliable));
+    if (!reliable) return NULL;
+    if (options != NULL) reliable->options = *options;
+    if (reliable->options.numChannels <= 0) {
+        reliable->options.numChannels = 1;
+        reliable->options.channelTypes[0] = ChannelReliableOrdered;
+    }
+    if (reliable->options.numChannels > NSC_MAX_CHANNELS) reliable->options.numChannels = NSC_MAX_CHANNELS;
+    if (reliable->options.mtu == 0) reliable->options.mtu = RUDP_DEFAULT_MTU;
+    if (reliable->options.mtu > (uint32_t)bufferSize - 1) reliable->options.mtu = (uint32_t)bufferSize - 1;
+    if (reliable->options.mtu > 65507) reliable->options.mtu = 65507; // Largest UDP payload
+    if (reliable->options.mtu <= RUDP_HEADER) {
+        memFree(peer->allocator, reliable);
+        return NULL;
+    }
+    reliable->fragmentSize = reliable->options.mtu - RUDP_HEADER;
+    reliable->maxMessage = (uint32_t)bufferSize - 1;
+    reliable->scratch = (uint8_t*)memAlloc(peer->allocator, reliable->options.mtu);
+    if (!reliable->scratch) {
+        memFree(peer->allocator, reliable);
+        return NULL;
+    }
+    reliable->random = (uint32_t)nscMonotonicNs() | 1;
+    reliable->cwnd = RUDP_INITIAL_WINDOW;
+    reliable->ssthresh = RUDP_WINDOW;
+    reliable->rto = RUDP_INITIAL_RTO;
+    statAdd(*peer->stats, allocations, 2);
+    return reliable;
+}
+
+// Free the reliable UDP state of a connection, the packets not acknowledged are lost
+static void freeReliable(Client* peer) {
+    struct NSC_Reliable* reliable = peer->extension->reliable;
+    if (reliable == NULL) return;
+    for (int i = 0; i < RUDP_WINDOW; i++) memFree(peer->allocator, reliable->window[i]);
+    while (reliable->queueHead != NULL) {
+        RudpPacket* next = reliable->queueHead->next;
+        memFree(peer->allocator, reliable->queueHead);
+        reliable->queueHead = next;
+    }
+    rudpFreeMessages(peer, reliable->partial);
+    rudpFreeMessages(peer, reliable->held);
+    rudpFreeMessages(peer, reliable->readyHead);
+    memFree(peer->allocator, reliable->scratch);
+    memFree(peer->allocator, reliable);
+    peer->extension->reliable = NULL;
+}
+
+/*
+    Parameters:
+        - SOCKET socket : The socket to configure
+        - const NSC_Options* options : The options
+        - int connType : The connection type (TCP or UDP)
+        - int ipType : The IP type (IPv4 or IPv6)
+    Description:
+        This function applies the options that every socket of a connection takes
+        (a server's listening socket and its accepted sockets, a client's socket), the unset ones are skipped.
+*/
+static void applySocketOptions(SOCKET socket, const NSC_Options* options, int connType, int ipType) {
+    int enabled = 1;
+    if (options->recvBufferSize > 0) {
+        setsockopt(socket, SOL_SOCKET, SO_RCVBUF, (const char*)&options->recvBufferSize, sizeof(int));
+    }
+    if (options->sendBufferSize > 0) {
+        setsockopt(socket, SOL_SOCKET, SO_SNDBUF, (const char*)&options->sendBufferSize, sizeof(int));
+    }
+    if (options->tos > 0 && ipType != UNIX) {
+        if (ipType == IPv4) {
+            setsockopt(socket, IPPROTO_IP, IP_TOS, (const char*)&options->tos, sizeof(int));
+        }
+#ifdef IPV6_TCLASS
+        else {
+            setsockopt(socket, IPPROTO_IPV6, IPV6_TCLASS, (const char*)&options->tos, sizeof(int));
+        }
+#endif
+    }
+#if defined (__linux__)
+    if (options->busyPoll > 0) {
+        setsockopt(socket, SOL_SOCKET, SO_BUSY_POLL, &options->busyPoll, sizeof(int));
+    }
+#endif
+
+    if (connType != TCP || ipType == UNIX) return; // The TCP options don't apply to a UNIX stream socket
+    if (options->noDelay) {
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&enabled, sizeof(enabled));
+    }
+#if defined (__linux__)
+    if (options->quickAck) {
+        setsockopt(socket, IPPROTO_TCP, TCP_QUICKACK, &enabled, sizeof(enabled));
+    }
+#endif
+}
+
+Server* createServer(const char* address, int port, int connType, int ipType) {
+    return createServerEx(address, port, connType, ipType, NULL);
+}
+
+Server* createServerEx(const char* address, int port, int connType, int ipType, const NSC_Options* options) {
+#if !defined (__linux__)
+    if (ipType == UNIX) {
+        fprintf(stderr, "UNIX domain sockets are not supported on this system\n");
+        return NULL;
+    }
+#endif
+    const NSC_Allocator* allocator = (options != NULL && options->allocator != NULL) ? options->allocator : &globalAllocator;
+    Server* server = (Server*)memAlloc(allocator, sizeof(Server)); // Create the server's structure
+    if (server == NULL) return NULL;
+    server->allocator = *allocator;
+    memset(&server->stats, 0, sizeof(NSC_Stats));
+    server->options = resolveOptions(options);
+
+    // Timers (no timeout by default)
+    nscTimerWheelInit(&server->timers);
+    server->expiredConnections.next = server->expiredConnections.prev = &server->expiredConnections;
+    server->idleTimeout = 0;
+    server->readTimeout = 0;
+    server->zeroCopyThreshold = 0;
+    server->compressionThreshold = 0;
+    server->compressionDictionary = NULL;
+    server->backlog = QueueLength;
+    server->acceptBudget = AcceptBudget;
+    server->maxConnections = server->options.maxClients;
+    server->admissionPolicy = AdmissionReject;
+    server->readBudgetFrames = ReadBudget;
+    server->readBudgetBytes = 0;
+
+    // Create the server's socket
+    int type = (connType == TCP) ? SOCK_STREAM : SOCK_DGRAM; // Support for TCP and UDP
+    int ip = addressFamily(ipType); // Support for IPv4, IPv6 and UNIX domain sockets
+
+    server->socket = socket(ip, type, 0);
+
+    // Set the socket in non-blocking mode
+#if defined (_WIN32)
+        u_long nonBlocking = 1; // 1 is for non-blocking mode
+        ioctlsocket(server->socket, FIONBIO, (u_long*)&nonBlocking);
+#elif defined (__linux__)
+        int flags = fcntl(server->socket, F_GETFL, 0);
+        fcntl(server->socket, F_SETFL, flags | O_NONBLOCK);
+#endif
+
+    // Check if the socket was created successfully
+    if (server->socket == INVALID_SOCKET) {
+        fprintf(stderr, "Error creating the server's socket\n");
+        return NULL;
+    }
+
+    // Apply the options before bind() and listen()
+    if (server->options.reuseAddress) {
+        int enabled = 1;
+        setsockopt(server->socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&enabled, sizeof(enabled));
+    }
+    applySocketOptions(server->socket, &server->options, connType, ipType);
+    if (connType == UDP) {
+        // Reception timestamps only : the sends of the sessions share the socket
+        server->options.timestamping = enableTimestamping(server->socket, server->options.timestamping & ~NSC_TIMESTAMP_TX, ipType);
+    }
+#if defined (__linux__)
+    if (connType == TCP && ipType != UNIX && server->options.fastOpen > 0) {
+        setsockopt(server->socket, IPPROTO_TCP, TCP_FASTOPEN, &server->options.fastOpen, sizeof(int));
+    }
+#endif
+
+    // Set the server's information (address, port, and IP type) according to the IP type
+    switch (ip) {
+        case AF_INET:
+            server->sin.in.sin_family = ip;
+            server->sin.in.sin_port = htons(port);
+            inet_pton(ip, address, &server->sin.in.sin_addr.s_addr);
+            break;
+        case AF_INET6:
+            server->sin.in6.sin6_family = ip;
+            server->sin.in6.sin6_port = htons(port);
+            inet_pton(ip, address, &server->sin.in6.sin6_addr);
+            break;
+    }
+#if defined (__linux__)
+    socklen_t unixLength = (ipType == UNIX) ? setUnixAddress(&server->sin.un, address) : 0;
+#endif
+
+    // Set the server's connection type and IP type
+    server->connType = connType;
+    server->ipType = ipType;
+
+    switch (ipType) {
+        case IPv4:
+            server->recSize = sizeof(server->sin.in);
+            break;
+        case IPv6:
+            server->recSize = sizeof(server->sin.in6);
+            server->sin.in6.sin6_scope_id = 0;
+            break;
+#if defined (__linux__)
+        case UNIX:
+            server->recSize = unixLength;
+            if (unixLength == 0) {
+                fprintf(stderr, "Invalid socket path\n");
+                closesocket(server->socket);
+                memFree(allocator, server);
+                return NULL;
+            }
+            break;
+#endif
+    }
+    
+
+    // Create the array of clients
+    server->clients = (Client*)memAlloc(&server->allocator, sizeof(Client) * server->options.maxClients);
+    server->numClients = 0;
+
+    // Create the poll set (the server's socket + one entry per client)
+    server->pollSet = (struct pollfd*)memAlloc(&server->allocator, sizeof(struct pollfd) * (server->options.maxClients + 2)); // + the wake-up of the async sends
+    server->bufferPool = (struct NSC_BufferPool*)memCalloc(&server->allocator, 1, sizeof(struct NSC_BufferPool));
+    server->connectionIds = createConnectionIds(&server->allocator, server->options.maxClients);
+    server->connectionStats = (NSC_Stats*)memAlloc(&server->allocator, sizeof(NSC_Stats) * server->options.maxClients);
+    if (server->clients == NULL || server->pollSet == NULL || server->bufferPool == NULL || server->connectionIds == NULL
+        || server->connectionStats == NULL) {
+        fprintf(stderr, "Error allocating the server's connections\n");
+        if (server->connectionIds != NULL) {
+            memFree(&server->allocator, server->connectionIds->index);
+            memFree(&server->allocator, server->connectionIds->generation);
+            memFree(&server->allocator, server->connectionIds->freeSlots);
+            memFree(&server->allocator, server->connectionIds);
+        }
+        memFree(&server->allocator, server->connectionStats);
+        memFree(&server->allocator, server->bufferPool);
+        memFree(&server->allocator, server->pollSet);
+        memFree(&server->allocator, server->clients);
+        closesocket(server->socket);
+        memFree(allocator, server);
+        return NULL;
+    }
+    server->topics = NULL;
+    server->udpSessions = NULL;
+    server->reliableOptions = NULL;
+    server->recorder = NULL;
+    server->flowEvents = 0;
+    server->flowBytes = 0;
+    server->flowTotalEvents = 0;
+    server->flowTotalBytes = 0;
+    server->flowControl = NULL;
+    server->flowPaused = 0;
+    server->asyncSends = NULL;
+    server->rateFrames = 0;
+    server->rateBytes = 0;
+    server->rateTotalFrames = 0;
+    server->rateTotalBytes = 0;
+    server->rateAction = RateDelay;
+    server->rateLimit = NULL;
+    server->ratePaused = 0;
+
+    // Bind the server's socket
+    if (ipType == IPv4) {
+        if (bind(server->socket, (SOCKADDR*)&server->sin.in, sizeof(server->sin.in)) == SOCKET_ERROR) {
+            fprintf(stderr,"Error binding the server's socket\n");
+            closeServer(server);
+            return NULL;
+        }
+    } 
+    else if (ipType == IPv6) {
+        if (bind(server->socket, (SOCKADDR*)&server->sin.in6, sizeof(server->sin.in6)) == SOCKET_ERROR) {
+            fprintf(stderr,"Error binding the server's socket\n");
+            closeServer(server);
+            return NULL;
+        }
+    }
+#if defined (__linux__)
+    else if (ipType == UNIX) {
+        // The socket file left by a dead server would make bind() fail (the abstract names disappear with their socket) :
+        // it is removed if nothing listens on it, a live server keeps it and bind() fails
+        struct stat info;
+        if (server->sin.un.sun_path[0] != '\0' && stat(server->sin.un.sun_path, &info) == 0 && S_ISSOCK(info.st_mode)) {
+            SOCKET probe = socket(AF_UNIX, type, 0);
+            if (probe != INVALID_SOCKET) {
+                if (connect(probe, (SOCKADDR*)&server->sin.un, server->recSize) == SOCKET_ERROR && errno == ECONNREFUSED) {
+                    unlink(server->sin.un.sun_path);
+                }
+                closesocket(probe);
+            }
+        }
+        if (bind(server->socket, (SOCKADDR*)&server->sin.un, server->recSize) == SOCKET_ERROR) {
+            fprintf(stderr,"Error binding the server's socket\n");
+            server->sin.un.sun_path[0] = '\0'; // The socket file is not the server's one, closeServer must not remove it
+            closeServer(server);
+            return NULL;
+        }
+    }
+#endif
+
+    // Listen on the server's socket
+    if (connType == TCP) {
+        if (listen(server->socket, server->backlog) == SOCKET_ERROR) {
+            fprintf(stderr,"Error listening on the server's socket\n");
+            closeServer(server);
+            return NULL;
+        }
+    }
+
+    return server;
+}
+
+// Recording of a server's events (see nscRecordStart) : serverListen copies them to a ring, a thread writes the ring to the file
+#define RECORD_DEFAULT_BUFFER (4u << 20)
+#define RECORD_MAP_CHUNK (4u << 20) // The capture file grows and is mapped by chunks of this size (Linux)
+struct NSC_Recorder {
+    uint8_t* ring;
+    uint64_t size; // Size of the ring (power of two)
+    uint64_t head; // Bytes written by serverListen
+    uint64_t tail; // Bytes written to the file by the writer
+    uint64_t stop; // 1 once the writer is to finish
+    uint64_t start; // Monotonic time (ns) of the start of the recording
+    uint64_t drops; // Events dropped because the ring was full
+    int failed; // 1 if the file could not be written
+    uint64_t fileSize; // Bytes written to the file
+#if defined (_WIN32)
+    HANDLE thread;
+    FILE* file;
+#else
+    pthread_t thread;
+    int fd;
+    uint8_t* map; // Chunk of the file being written
+    uint64_t mapOffset; // Its offset in the file
+#endif
+};
+
+// Write bytes at the end of the capture file (writer thread)
+static void recorderWrite(struct NSC_Recorder* recorder, const uint8_t* data, uint64_t len) {
+    if (recorder->failed) return;
+#if defined (_WIN32)
+    if (fwrite(data, 1, (size_t)len, recorder->file) != len) recorder->failed = 1;
+    recorder->fileSize += len;
+#else
+    while (len > 0) {
+        if (recorder->map == NULL || recorder->fileSize == recorder->mapOffset + RECORD_MAP_CHUNK) {
+            // Grow the file by a chunk and map it
+            if (recorder->map != NULL) munmap(recorder->map, RECORD_MAP_CHUNK);
+            recorder->mapOffset = recorder->fileSize;
+            recorder->map = NULL;
+            if (ftruncate(recorder->fd, (off_t)(recorder->mapOffset + RECORD_MAP_CHUNK)) != 0) {
+                recorder->failed = 1;
+                return;
+            }
+            void* map = mmap(NULL, RECORD_MAP_CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED, recorder->fd, (off_t)recorder->mapOffset);
+            if (map == MAP_FAILED) {
+                recorder->failed = 1;
+                return;
+            }
+            recorder->map = (uint8_t*)map;
+        }
+        uint64_t room = recorder->mapOffset + RECORD_MAP_CHUNK - recorder->fileSize;
+        uint64_t count = (len < room) ? len : room;
+        memcpy(recorder->map + (recorder->fileSize - recorder->mapOffset), data, (size_t)count);
+        recorder->fileSize += count;
+        data += count;
+        len -= count;
+    }
+#endif
+}
+
+// Writer thread : moves the ring's bytes to the file until the recording stops
+#if defined (_WIN32)
+static DWORD WINAPI recorderThread(LPVOID argument) {
+#else
+static void* recorderThread(void* argument) {
+#endif
+    struct NSC_Recorder* recorder = (struct NSC_Recorder*)argument;
+    while (1) {
+        uint64_t head = atomicLoadAcquire64(&recorder->head);
+        uint64_t tail = recorder->tail;
+        if (head == tail) {
+            // The last events may have been added right before the stop
+            if (atomicLoadAcquire64(&recorder->stop) && atomicLoadAcquire64(&recorder->head) == tail) break;
+#if defined (_WIN32)
+            Sleep(1);
+#else
+            usleep(1000);
+#endif
+            continue;
+        }
+        uint64_t offset = tail & (recorder->size - 1);
+        uint64_t first = (head - tail < recorder->size - offset) ? head - tail : recorder->size - offset;
+        recorderWrite(recorder, recorder->ring + offset, first);
+        if (head - tail > first) recorderWrite(recorder, recorder->ring, head - tail - first);
+        atomicStoreRelease64(&recorder->tail, head);
+    }
+    return 0;
+}
+
+// Copy bytes to the ring of the recorder (the room was checked)
+static void recorderCopy(struct NSC_Recorder* recorder, uint64_t* position, const void* data, uint64_t len) {
+    uint64_t offset = *position & (recorder->size - 1);
+    uint64_t first = (len < recorder->size - offset) ? len : recorder->size - offset;
+    memcpy(recorder->ring + offset, data, (size_t)first);
+    memcpy(recorder->ring, (const uint8_t*)data + first, (size_t)(len - first));
+    *position += len;
+}
+
+/*
+    Parameters:
+        - Server* server : A recording server
+        - const ServerEvent* event : An event serverListen just built
+    Description:
+        This function adds a Connection, DataReceived or Disconnection event to the recording, at the time it is built
+        (or its kernel reception time). It is dropped if it does not fit in the ring.
+*/
+static void recordEvent(Server* server, const ServerEvent* event) {
+    if (event->type != Connection && event->type != DataReceived && event->type != Disconnection) return;
+    struct NSC_Recorder* recorder = server->recorder;
+    uint64_t head = recorder->head;
+
+    NSC_CaptureRecord record;
+    memset(&record, 0, sizeof(record));
+    uint64_t received = (event->trace.kernelTime != 0) ? event->trace.kernelTime : nscMonotonicNs();
+    record.time = (received > recorder->start) ? received - recorder->start : 0;
+    record.connId = event->connId;
+    record.size = (event->type == DataReceived) ? event->dataSize : 0;
+    record.type = (uint16_t)event->type;
+    record.channel = (uint16_t)event->channel;
+    if (head + sizeof(record) + record.size - atomicLoadAcquire64(&recorder->tail) > recorder->size) {
+        recorder->drops++;
+        statAdd(server->stats, recordDrops, 1);
+        return;
+    }
+    recorderCopy(recorder, &head, &record, sizeof(record));
+    if (record.size != 0) recorderCopy(recorder, &head, event->data, record.size);
+    atomicStoreRelease64(&recorder->head, head);
+}
+
+int nscRecordStart(Server* server, const char* path, uint32_t bufferSize) {
+    if (server->recorder != NULL) return -1;
+    uint64_t size = 4096;
+    while (size < (bufferSize != 0 ? bufferSize : RECORD_DEFAULT_BUFFER)) size <<= 1;
+
+    struct NSC_Recorder* recorder = (struct NSC_Recorder*)memCalloc(&server->allocator, 1, sizeof(struct NSC_Recorder));
+    if (!recorder) return -1;
+    recorder->ring = (uint8_t*)memAlloc(&server->allocator, (size_t)size);
+    if (!recorder->ring) {
+        memFree(&server->allocator, recorder);
+        return -1;
+    }
+    recorder->size = size;
+    recorder->start = nscMonotonicNs();
+#if defined (_WIN32)
+    recorder->file = fopen(path, "wb");
+    int opened = recorder->file != NULL;
+#else
+    recorder->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int opened = recorder->fd >= 0;
+#endif
+    if (!opened) {
+        memFree(&server->allocator, recorder->ring);
+        memFree(&server->allocator, recorder);
+        return -1;
+    }
+
+    // The header leaves first, through the ring
+    NSC_CaptureHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = NSC_CAPTURE_MAGIC;
+    header.version = NSC_CAPTURE_VERSION;
+    header.connType = server->connType;
+    header.ipType = server->ipType;
+    header.startTime = (uint64_t)time(NULL) * 1000000000ULL;
+#if !defined (_WIN32)
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header.startTime = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+#endif
+    recorderCopy(recorder, &recorder->head, &header, sizeof(header));
+
+#if defined (_WIN32)
+    recorder->thread = CreateThread(NULL, 0, recorderThread, recorder, 0, NULL);
+    int started = recorder->thread != NULL;
+#else
+    int started = pthread_create(&recorder->thread, NULL, recorderThread, recorder) == 0;
+#endif
+    if (!started) {
+#if defined (_WIN32)
+        fclose(recorder->file);
+#else
+        close(recorder->fd);
+#endif
+        memFree(&server->allocator, recorder->ring);
+        memFree(&server->allocator, recorder);
+        return -1;
+    }
+    statAdd(server->stats, allocations, 2);
+    server->recorder = recorder;
+    return 0;
+}
+
+int nscRecordStop(Server* server) {
+    struct NSC_Recorder* recorder = server->recorder;
+    if (recorder == NULL) return -1;
+    atomicStoreRelease64(&recorder->stop, 1);
+#if defined (_WIN32)
+    WaitForSingleObject(recorder->thread, INFINITE);
+    CloseHandle(recorder->thread);
+    if (fclose(recorder->file) != 0) recorder->failed = 1;
+#else
+    pthread_join(recorder->thread, NULL);
+    if (recorder->map != NULL) munmap(recorder->map, RECORD_MAP_CHUNK);
+    if (ftruncate(recorder->fd, (off_t)recorder->fileSize) != 0) recorder->failed = 1; // The end of the last chunk is not used
+    if (close(recorder->fd) != 0) recorder->failed = 1;
+#endif
+    int status = (recorder->failed || recorder->drops != 0) ? -1 : 0;
+    memFree(&server->allocator, recorder->ring);
+    memFree(&server->allocator, recorder);
+    server->recorder = NULL;
+    return status;
+}
 
-    // Create the server's socket
-    int type = (connType == TCP) ? SOCK_STREAM : SOCK_DGRAM; // Support for TCP and UDP
-    int ip = (ipType == IPv4) ? AF_INET : AF_INET6; // Support for IPv4 and IPv6
+/*
+    Parameters:
+        - struct NSC_FlowControl* flow : The server's flow control
+        - uint32_t connId : The connection the messages belong to (0 : datagrams of a UDP server without sessions)
+        - int64_t events : Number of messages, negative when they are freed
+        - int64_t bytes : Their size
+    Description:
+        This function counts the messages handed out to the application, or given back by it.
+        The counters of a slot are reset when a new connection takes it : the old connection's messages
+        freed meanwhile can leave them lower than they are, never higher.
+*/
+static void flowCount(struct NSC_FlowControl* flow, uint32_t connId, int64_t events, int64_t bytes) {
+    atomicAdd64(&flow->totalEvents, (uint64_t)events);
+    atomicAdd64(&flow->totalBytes, (uint64_t)bytes);
+    uint32_t slot = connId & (NSC_ID_SLOTS - 1);
+    if (connId == 0 || slot >= flow->numSlots || atomicLoad64(&flow->ids[slot]) != connId) return;
+    atomicAdd64(&flow->events[slot], (uint64_t)events);
+    atomicAdd64(&flow->bytes[slot], (uint64_t)bytes);
+}
 
-    server->socket = socket(ip, type, 0);
+// Give the counters of a slot to a new connection
+static void flowReset(struct NSC_FlowControl* flow, uint32_t connId) {
+    uint32_t slot = connId & (NSC_ID_SLOTS - 1);
+    if (slot >= flow->numSlots) return;
+    atomicExchange64(&flow->ids[slot], (uint64_t)connId);
+    atomicExchange64(&flow->events[slot], 0);
+    atomicExchange64(&flow->bytes[slot], 0);
+}
+
+// 1 if the server's messages reached a total limit, or the connection's ones its limit (client NULL : the totals only)
+static int flowHeld(Server* server, const Client* client) {
+    struct NSC_FlowControl* flow = server->flowControl;
+    if ((server->flowTotalEvents != 0 && (int64_t)atomicLoad64(&flow->totalEvents) >= (int64_t)server->flowTotalEvents)
+        || (server->flowTotalBytes != 0 && (int64_t)atomicLoad64(&flow->totalBytes) >= (int64_t)server->flowTotalBytes)) return 1;
+    if (client == NULL) return 0;
+    uint32_t slot = client->id & (NSC_ID_SLOTS - 1);
+    if (slot >= flow->numSlots || atomicLoad64(&flow->ids[slot]) != client->id) return 0;
+    return (server->flowEvents != 0 && (int64_t)atomicLoad64(&flow->events[slot]) >= (int64_t)server->flowEvents)
+        || (server->flowBytes != 0 && (int64_t)atomicLoad64(&flow->bytes[slot]) >= (int64_t)server->flowBytes);
+}
+
+/*
+    Parameters:
+        - Server* server : The server, with flow control
+        - Client* client : A stream connection (NULL : the server's UDP socket)
+    Output:
+        - int : 1 if its reading is held by the flow control, 0 otherwise
+    Description:
+        This function updates the paused state of a connection (or of the UDP socket), counting the pauses.
+*/
+static int flowPause(Server* server, Client* client) {
+    int held = flowHeld(server, client);
+    int* paused = (client != NULL) ? &client->flowPaused : &server->flowPaused;
+    NSC_Stats* stats = (client != NULL) ? client->stats : &server->stats;
+    if (held && !*paused) statAdd(*stats, flowPauses, 1);
+    *paused = held;
+    return held;
+}
+
+static void freeFlowControl(Server* server) {
+    if (server->flowControl == NULL) return;
+    memFree(&server->allocator, server->flowControl->events);
+    memFree(&server->allocator, server->flowControl->bytes);
+    memFree(&server->allocator, server->flowControl->ids);
+    memFree(&server->allocator, server->flowControl);
+    server->flowControl = NULL;
+}
+
+// Messages sent to a server's connections by other threads (see sendAsyncMessage)
+#define ASYNC_VECTOR 64 // Messages written per vectored call
+
+// A message pushed on a connection's queue, with its frame header
+typedef struct AsyncMessage {
+    struct AsyncMessage* next;
+    uint32_t connId;
+    uint32_t len; // Length of the message
+    char frame[]; // [length : 4 bytes][message]
+} AsyncMessage;
+
+struct NSC_AsyncSends {
+    uint64_t* heads; // Last message pushed on the queue of each slot of connection id (a lock-free stack, 0 : empty)
+    uint32_t numSlots;
+#if defined (__linux__)
+    int wakeFd; // eventfd written when a queue stops being empty, polled by serverListen
+#endif
+};
 
-    // Set the socket in non-blocking mode
 #if defined (_WIN32)
-        u_long nonBlocking = 1; // 1 is for non-blocking mode
-        ioctlsocket(server->socket, FIONBIO, (u_long*)&nonBlocking);
-#elif defined (__linux__)
-        int flags = fcntl(server->socket, F_GETFL, 0);
-        fcntl(server->socket, F_SETFL, flags | O_NONBLOCK);
+typedef WSABUF IoVector;
+#define ioVectorSet(vector, data, size) ((vector).buf = (char*)(data), (vector).len = (ULONG)(size))
+#else
+typedef struct iovec IoVector;
+#define ioVectorSet(vector, data, size) ((vector).iov_base = (void*)(data), (vector).iov_len = (size_t)(size))
 #endif
 
-    // Check if the socket was created successfully
-    if (server->socket == INVALID_SOCKET) {
-        fprintf(stderr, "Error creating the server's socket\n");
-        return NULL;
+// Send several buffers with one call, returns the number of bytes sent or -1 like send()
+static int sendVector(SOCKET socket, IoVector* vectors, int count) {
+#if defined (_WIN32)
+    DWORD sent = 0;
+    if (WSASend(socket, vectors, (DWORD)count, &sent, 0, NULL, NULL) != 0) return -1;
+    return (int)sent;
+#else
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = vectors;
+    message.msg_iovlen = count;
+    return (int)sendmsg(socket, &message, MSG_NOSIGNAL);
+#endif
+}
+
+// Take the messages of a slot's queue, oldest first
+static AsyncMessage* takeAsyncMessages(struct NSC_AsyncSends* async, uint32_t slot) {
+    if (atomicLoad64(&async->heads[slot]) == 0) return NULL;
+    AsyncMessage* message = (AsyncMessage*)(uintptr_t)atomicExchangeAcquire64(&async->heads[slot], 0);
+    AsyncMessage* ordered = NULL;
+    while (message != NULL) {
+        AsyncMessage* next = message->next;
+        message->next = ordered;
+        ordered = message;
+        message = next;
     }
+    return ordered;
+}
 
-    // Set the server's information (address, port, and IP type) according to the IP type
-    switch (ip) {
-        case AF_INET:
-            server->sin.in.sin_family = ip;
-            server->sin.in.sin_port = htons(port);
-            inet_pton(ip, address, &server->sin.in.sin_addr.s_addr);
-            break;
-        case AF_INET6:
-            server->sin.in6.sin6_family = ip;
-            server->sin.in6.sin6_port = htons(port);
-            inet_pton(ip, address, &server->sin.in6.sin6_addr);
-            break;
+// Drop the messages waiting for a slot (its connection is closed)
+static void dropAsyncMessages(Server* server, uint32_t slot) {
+    AsyncMessage* message = takeAsyncMessages(server->asyncSends, slot);
+    while (message != NULL) {
+        AsyncMessage* next = message->next;
+        statAdd(server->stats, asyncDrops, 1);
+        memFree(&server->allocator, message);
+        message = next;
     }
+}
 
-    // Set the server's connection type and IP type
-    server->connType = connType;
-    server->ipType = ipType;
+/*
+    Parameters:
+        - Server* server : The server, with async sends
+        - Client* client : One of its connections
+    Description:
+        This function sends the messages other threads pushed for the connection (server's thread).
+        In TCP they are written with vectored calls, what the socket does not take goes to the outbound queue.
+        The messages pushed for the slot's previous connection are dropped.
+*/
+static void flushAsyncMessages(Server* server, Client* client) {
+    AsyncMessage* message = takeAsyncMessages(server->asyncSends, client->id & (NSC_ID_SLOTS - 1));
+    int vectored = (server->connType == TCP && client->extension->ring == NULL);
+    int failed = 0;
 
-    switch (ipType) {
-        case IPv4:
-            server->recSize = sizeof(server->sin.in);
-            break;
-        case IPv6:
-            server->recSize = sizeof(server->sin.in6);
-            server->sin.in6.sin6_scope_id = 0;
-            break;
+    // The messages of the slot's previous connection are dropped
+    AsyncMessage** link = &message;
+    while (*link != NULL) {
+        AsyncMessage* stale = *link;
+        if (stale->connId == client->id) {
+            link = &stale->next;
+            continue;
+        }
+        *link = stale->next;
+        statAdd(server->stats, asyncDrops, 1);
+        memFree(&server->allocator, stale);
     }
-    
 
-    // Initialize the server's socket set
-    FD_ZERO(&server->socketSet);
-    FD_SET(server->socket, &server->socketSet);
-
-    // Set the server's maximum socket
-    server->maxSocket = server->socket;
+    while (message != NULL) {
+        // Vectored write of the next messages, if nothing is queued before them
+        if (vectored && !failed && !outQueuePending(client)) {
+            IoVector vectors[ASYNC_VECTOR];
+            int count = 0;
+            for (AsyncMessage* item = message; item != NULL && count < ASYNC_VECTOR; item = item->next) {
+                ioVectorSet(vectors[count], item->frame, 4 + item->len);
+                count++;
+            }
+            int sent = sendVector(client->socket, vectors, count);
+            statAdd(*client->stats, sendCalls, 1);
+            if (sent < 0) {
+                if (wouldBlock()) statAdd(*client->stats, eagainHits, 1);
+                else failed = 1; // The reading reports the disconnection
+                sent = 0;
+            }
+            statAdd(*client->stats, bytesOut, sent);
 
-    // Create the array of clients
-    server->clients = (Client*)malloc(sizeof(Client) * MaxClients);
-    server->numClients = 0;
+            // Release the messages sent, queue the rest of the one cut
+            for (int i = 0; i < count; i++) {
+                AsyncMessage* item = message;
+                message = message->next;
+                uint32_t size = 4 + item->len;
+                if ((uint32_t)sent >= size) {
+                    sent -= size;
+                    statAdd(*client->stats, framesOut, 1);
+                }
+                else {
+                    // The rest of the message cut, and the messages after it, wait in the outbound queue
+                    if (!failed && queueSegment(client, item->frame + sent, size - sent, -1, 0, 1) != 0) failed = 1;
+                    if (failed) statAdd(*client->stats, partialSends, 1);
+                    sent = 0;
+                }
+                memFree(&server->allocator, item);
+            }
+            continue;
+        }
 
-    // Bind the server's socket
-    if (ipType == IPv4) {
-        if (bind(server->socket, (SOCKADDR*)&server->sin.in, sizeof(server->sin.in)) == SOCKET_ERROR) {
-            fprintf(stderr,"Error binding the server's socket\n");
-            return NULL;
+        AsyncMessage* next = message->next;
+        if (failed) {
+            statAdd(*client->stats, partialSends, 1);
         }
-    } 
-    else if (ipType == IPv6) {
-        if (bind(server->socket, (SOCKADDR*)&server->sin.in6, sizeof(server->sin.in6)) == SOCKET_ERROR) {
-            fprintf(stderr,"Error binding the server's socket\n");
-            return NULL;
+        else if (vectored) {
+            // Behind the outbound queue : queued whole
+            if (queueSegment(client, message->frame, 4 + message->len, -1, 0, 1) != 0) failed = 1;
         }
+        else {
+            sendClientMessage(client, message->frame + 4, message->len); // UDP session or shared-memory ring
+        }
+        memFree(&server->allocator, message);
+        message = next;
     }
+}
 
-    // Listen on the server's socket
-    if (connType == TCP) {
-        if (listen(server->socket, 65535) == SOCKET_ERROR) {
-            fprintf(stderr,"Error listening on the server's socket\n");
-            return NULL;
+static void freeAsyncSends(Server* server) {
+    struct NSC_AsyncSends* async = server->asyncSends;
+    if (async == NULL) return;
+    for (uint32_t i = 0; i < async->numSlots; i++) {
+        AsyncMessage* message = (AsyncMessage*)(uintptr_t)async->heads[i];
+        while (message != NULL) {
+            AsyncMessage* next = message->next;
+            memFree(&server->allocator, message);
+            message = next;
         }
     }
+#if defined (__linux__)
+    if (async->wakeFd >= 0) close(async->wakeFd);
+#endif
+    memFree(&server->allocator, async->heads);
+    memFree(&server->allocator, async);
+    server->asyncSends = NULL;
+}
 
-    return server;
+// Token buckets of the rate limits (see setServerRateLimit)
+// A bucket is kept as the time it is full again : taking tokens moves that time forward by their cost (count / rate seconds),
+// the bucket has room while it is less than RATE_BURST_NS ahead
+#define RATE_BURST_NS 1000000000ULL // The buckets hold one second of traffic
+
+struct NSC_RateLimit {
+    uint64_t totalFrames; // Times (ns, see nscMonotonicNs) the server's buckets are full again
+    uint64_t totalBytes;
+    uint64_t* frames; // Same for each slot of connection id
+    uint64_t* bytes;
+    uint32_t numSlots;
+};
+
+// Cost (ns) of count tokens at rate tokens per second (0 : no limit)
+#define rateCost(count, rate) (((rate) != 0) ? (uint64_t)(count) * 1000000000ULL / (rate) : 0)
+
+// 1 if a bucket has room for cost tokens (a full bucket takes a message larger than itself)
+static int rateRoom(uint64_t full, uint64_t cost, uint64_t now) {
+    return full <= now || full + cost <= now + RATE_BURST_NS;
+}
+
+static void rateTake(uint64_t* full, uint64_t cost, uint64_t now) {
+    if (cost != 0) *full = ((*full > now) ? *full : now) + cost;
+}
+
+// Give full buckets to a new connection
+static void rateReset(struct NSC_RateLimit* rate, uint32_t connId) {
+    uint32_t slot = connId & (NSC_ID_SLOTS - 1);
+    if (slot >= rate->numSlots) return;
+    rate->frames[slot] = 0;
+    rate->bytes[slot] = 0;
+}
+
+/*
+    Parameters:
+        - Server* server : The server, with rate limits
+        - Client* client : The connection the message comes from (NULL : a datagram of a UDP server without sessions)
+        - uint32_t bytes : The size of the message
+        - uint64_t now : nscMonotonicNs()
+    Output:
+        - int : 1 if the message is within the limits (its tokens are taken), 0 otherwise
+    Description:
+        This function takes the tokens of a message received. With RateDrop and RateDisconnect (and for the datagrams
+        of a UDP server's sessions whatever the action), a message is refused over the limits of its own connection only. The server's tokens are always taken, like the connection's ones
+        with RateDelay : the reading waits for them before the next message instead (see ratePause).
+*/
+static int rateAdmit(Server* server, const Client* client, uint32_t bytes, uint64_t now) {
+    struct NSC_RateLimit* rate = server->rateLimit;
+    uint64_t frameCost = rateCost(1, server->rateFrames);
+    uint64_t byteCost = rateCost(bytes, server->rateBytes);
+    uint64_t totalFrameCost = rateCost(1, server->rateTotalFrames);
+    uint64_t totalByteCost = rateCost(bytes, server->rateTotalBytes);
+    uint32_t slot = (client != NULL) ? (client->id & (NSC_ID_SLOTS - 1)) : rate->numSlots;
+    int own = slot < rate->numSlots;
+
+    // A UDP server's sessions share its socket : their datagrams are refused instead of delayed
+    int refuse = server->rateAction != RateDelay || server->connType == UDP;
+    if (refuse && own && (!rateRoom(rate->frames[slot], frameCost, now) || !rateRoom(rate->bytes[slot], byteCost, now))) {
+        return 0;
+    }
+    rateTake(&rate->totalFrames, totalFrameCost, now);
+    rateTake(&rate->totalBytes, totalByteCost, now);
+    if (own) {
+        rateTake(&rate->frames[slot], frameCost, now);
+        rateTake(&rate->bytes[slot], byteCost, now);
+    }
+    return 1;
+}
+
+/*
+    Parameters:
+        - Server* server : The server, with rate limits
+        - Client* client : A stream connection (NULL : the server's UDP socket, the server's buckets only)
+        - uint64_t now : nscMonotonicNs()
+    Output:
+        - uint64_t : The time (ns) its reading must wait for tokens, 0 if it can go on
+    Description:
+        This function updates the delayed state of a connection (or of the UDP socket), counting the delays.
+        The reading waits for the server's tokens whatever the action, for the connection's ones with RateDelay only.
+*/
+static uint64_t ratePause(Server* server, Client* client, uint64_t now) {
+    struct NSC_RateLimit* rate = server->rateLimit;
+    uint64_t full = (rate->totalFrames > rate->totalBytes) ? rate->totalFrames : rate->totalBytes;
+    uint32_t slot = (client != NULL) ? (client->id & (NSC_ID_SLOTS - 1)) : rate->numSlots;
+    if (slot < rate->numSlots && server->rateAction == RateDelay) {
+        if (rate->frames[slot] > full) full = rate->frames[slot];
+        if (rate->bytes[slot] > full) full = rate->bytes[slot];
+    }
+    uint64_t wait = (full > now + RATE_BURST_NS) ? full - now - RATE_BURST_NS : 0;
+
+    int* paused = (client != NULL) ? &client->ratePaused : &server->ratePaused;
+    NSC_Stats* stats = (client != NULL) ? client->stats : &server->stats;
+    if (wait != 0 && !*paused) statAdd(*stats, rateDelays, 1);
+    *paused = (wait != 0);
+    return wait;
+}
+
+// 1 if the rate limits delay the reading of a connection (client NULL : of a UDP server's socket), wake set to the shortest delay
+static int rateHeld(Server* server, Client* client, uint64_t now, uint64_t* wake) {
+    if (server->rateLimit == NULL) return 0;
+    uint64_t wait = ratePause(server, client, now);
+    if (wait != 0 && (*wake == 0 || wait < *wake)) *wake = wait;
+    return wait != 0;
+}
+
+static void freeRateLimit(Server* server) {
+    if (server->rateLimit == NULL) return;
+    memFree(&server->allocator, server->rateLimit->frames);
+    memFree(&server->allocator, server->rateLimit->bytes);
+    memFree(&server->allocator, server->rateLimit);
+    server->rateLimit = NULL;
 }
 
 void closeServer(Server* server) {
+    if (server->recorder != NULL) nscRecordStop(server);
     closesocket(server->socket);
-    free(server->clients);
-    free(server);
+#if defined (__linux__)
+    if (server->ipType == UNIX && server->sin.un.sun_path[0] != '\0') unlink(server->sin.un.sun_path);
+#endif
+    for (int i = 0; i < server->numClients; i++) {
+        freeSubscriptions(server, &server->clients[i]);
+        freeReliable(&server->clients[i]);
+        freeSendTimestamps(&server->clients[i]);
+        freeStreams(&server->clients[i]);
+        freeZeroCopy(&server->clients[i]);
+        freeCompression(&server->clients[i]);
+        freeSharedRing(&server->clients[i]);
+        freeOutQueue(&server->clients[i]); // Or with bytes left to send
+        releaseBuffer(&server->clients[i]); // A connection can be closed with messages left in its buffer
+        freeExtension(&server->clients[i]);
+    }
+    freeTopics(server->topics);
+    freeUdpSessions(server);
+    freeFlowControl(server);
+    freeAsyncSends(server);
+    freeRateLimit(server);
+    memFree(&server->allocator, server->reliableOptions);
+    memFree(&server->allocator, server->clients);
+    memFree(&server->allocator, server->pollSet);
+    for (int i = 0; i < server->bufferPool->numFree; i++) {
+        memFree(&server->allocator, server->bufferPool->buffers[i]);
+    }
+    memFree(&server->allocator, server->bufferPool);
+    memFree(&server->allocator, server->connectionIds->index);
+    memFree(&server->allocator, server->connectionIds->generation);
+    memFree(&server->allocator, server->connectionIds->freeSlots);
+    memFree(&server->allocator, server->connectionIds);
+    memFree(&server->allocator, server->connectionStats);
+    NSC_Allocator allocator = server->allocator; // The structure holds its own allocator
+    memFree(&allocator, server);
 }
 
-Client* acceptClient(Server* server) {
+// 1 if the server does not admit new connections for now
+#define serverFull(server) ((server)->numClients >= (server)->maxConnections || (server)->numClients >= (server)->options.maxClients)
+
+/*
+    Parameters:
+        - Server* server : The server
+        - const Client* client : The new connection (socket, address, buffer, statistics and extension set)
+    Output:
+        - Client* : The connection, in the server's list
+    Description:
+        This function adds a connection (an accepted socket or a UDP session) to the server's clients,
+        with its poll entry, timer, id and the server's per-connection settings.
+*/
+static Client* addConnection(Server* server, const Client* client) {
+    // Add the client to the server's list of clients and to the poll set (a UDP session has no socket of its own)
+    server->clients[server->numClients] = *client;
+    server->pollSet[server->numClients + 1].fd = (server->connType == TCP) ? client->socket : INVALID_SOCKET;
+    server->pollSet[server->numClients + 1].events = POLLIN;
+    server->pollSet[server->numClients + 1].revents = 0;
+    server->numClients++;
+
+    // The timer is initialized in place, its address must not change while it is linked
+    Client* added = &server->clients[server->numClients - 1];
+    nscTimerInit(&added->timer, connectionTimerExpired, server);
+    added->lastActivity = currentTick();
+    added->partialSince = 0;
+    added->readPending = 0;
+    added->eventBlock = server->options.eventBlock;
+    added->pollTimeout = server->options.pollTimeout;
+    if (server->idleTimeout != 0) scheduleConnectionTimer(server, added, added->lastActivity);
+
+    added->id = takeConnectionId(server->connectionIds, server->numClients - 1);
+    added->stats = &server->connectionStats[added->id & (NSC_ID_SLOTS - 1)]; // The slot's statistics, stable while the clients move
+    *added->stats = *client->stats;
+    added->flowPaused = 0;
+    if (server->flowControl != NULL) flowReset(server->flowControl, added->id);
+    added->ratePaused = 0;
+    if (server->rateLimit != NULL) rateReset(server->rateLimit, added->id);
+    added->timestamping = 0;
+    if (server->connType == TCP) {
+        added->timestamping = enableTimestamping(added->socket, server->options.timestamping, server->ipType);
+        // Not with shared-memory rings, whose data does not go through the socket
+        if (server->options.streamChunk > 0 && !(server->ipType == UNIX && server->options.sharedMemory > 0)) {
+            enableStreams(added, (uint32_t)server->options.streamChunk);
+        }
+        if (server->compressionThreshold != 0 || server->compressionDictionary != NULL) {
+            enableCompression(added, server->compressionThreshold, server->compressionDictionary);
+        }
+        if (server->zeroCopyThreshold != 0) enableZeroCopy(added, server->zeroCopyThreshold);
+    }
+
+    return added;
+}
+
+/*
+    Parameters:
+        - Server* server : The server to accept the client from
+        - int* consumed : Set to 1 if a pending connection was taken (accepted or rejected), 0 otherwise
+    Output:
+        - Client* : The client that was accepted (NULL if none)
+    Description:
+        This function accepts a pending connection, applying the admission policy.
+*/
+static Client* acceptPending(Server* server, int* consumed) {
     Client client; // Create the client's structure
+    NSC_Stats stats; // Its statistics until it takes its slot
+    *consumed = 0;
+
+    // Admission control : a deferred connection stays in the backlog
+    int full = serverFull(server);
+    if (full && server->admissionPolicy == AdmissionDefer) return NULL;
     
     // Accept the connection to the server's socket
     if (server->ipType == IPv4) {
@@ -104,236 +3815,1271 @@ Client* acceptClient(Server* server) {
     } else if (server->ipType == IPv6) {
         client.recSize = sizeof(client.sin.in6);
     }
+#if defined (__linux__)
+    else {
+        memset(&client.sin, 0, sizeof(client.sin)); // The peer of a UNIX socket is usually unnamed
+        client.recSize = sizeof(client.sin.un);
+    }
+#endif
+#if defined (__linux__)
+    // The socket is created non-blocking (readMessage relies on it) in the same call
+    client.socket = accept4(server->socket, (SOCKADDR*)&client.sin, &client.recSize, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
     client.socket = accept(server->socket, (SOCKADDR*)&client.sin, &client.recSize);
+#endif
+    statAdd(server->stats, acceptCalls, 1);
 
     // Check if the client was accepted successfully
     if (client.socket == INVALID_SOCKET) {
+        if (wouldBlock()) statAdd(server->stats, eagainHits, 1);
         return NULL;
     }
+    *consumed = 1;
+
+    // Refuse the connection if the server is full
+    if (full) {
+        closesocket(client.socket);
+        statAdd(server->stats, rejectedConnections, 1);
+        return NULL;
+    }
+
+#if defined (_WIN32)
+    // Set the client's socket in non-blocking mode (readMessage relies on it)
+    u_long nonBlocking = 1; // 1 is for non-blocking mode
+    ioctlsocket(client.socket, FIONBIO, &nonBlocking);
+#endif
+    applySocketOptions(client.socket, &server->options, server->connType, server->ipType);
 
     // Set the client's connection type and IP type
     client.connType = server->connType;
     client.ipType = server->ipType;
     
-    // Init the client's buffer
-    client.bufferData.buffer = malloc(BufferSize);
+    // Init the client's buffer (taken from the pool when data arrives) and statistics
+    memset(&stats, 0, sizeof(NSC_Stats));
+    client.stats = &stats;
+    client.bufferData.buffer = NULL;
+    client.bufferData.size = server->options.bufferSize;
     client.bufferData.len = 0;
     client.bufferData.pos = 0;
+    client.bufferData.skipping = 0;
+    client.bufferData.readTime = 0;
+    client.bufferData.kernelTime = 0;
+    client.bufferData.hardwareTime = 0;
+    client.bufferPool = server->bufferPool;
+    client.allocator = &server->allocator;
 
-    // Add the client to the server's list of clients
-    server->clients[server->numClients] = client;
-    server->numClients++;
+    // Give the shared memory of its rings to a UNIX stream connection
+    client.extension = &noExtension;
+#if defined (__linux__)
+    if (server->ipType == UNIX && server->connType == TCP && server->options.sharedMemory > 0
+        && offerSharedRing(&client, (uint32_t)server->options.sharedMemory, server->options.ringSpin) != 0) {
+        freeExtension(&client);
+        closesocket(client.socket);
+        statAdd(server->stats, rejectedConnections, 1);
+        return NULL;
+    }
+#endif
+
+    return addConnection(server, &client);
+}
+
+Client* acceptClient(Server* server) {
+    int consumed;
+    return acceptPending(server, &consumed);
+}
+
+/*
+    Parameters:
+        - ServerEvent* events : The lists of actual events
+        - int numEvents : The number of events
+        - int* eventMemory : The size of the list
+        - int eventBlock : The number of events added at once
+        - NSC_Stats* stats : The statistics in which the reallocation is counted
+        - const NSC_Allocator* allocator : The allocator of the list
+    Output:
+        - ServerEvent* : The new address of the events' list if creation succeeded, the old address otherwise
+    Description:
+        This function reallocate space of the server's events list if needed.
+*/
+ServerEvent* eventReallocServer(ServerEvent* events, int numEvents, int* eventMemory, int eventBlock, NSC_Stats* stats, const NSC_Allocator* allocator) {
+    if (numEvents >= *eventMemory) {
+        *eventMemory += eventBlock;
+        statAdd(*stats, allocations, 1);
+        ServerEvent* temp = memRealloc(allocator, events, sizeof(ServerEvent) * *eventMemory);
+        if (!temp) {
+            fprintf(stderr, "Memory allocation failed for events\n");
+        }
+        events = temp;
+    }
+    return events;
+}
+
+/*
+    Parameters:
+        - Server* server : The UDP server
+        - const SIN* address : The address of the peer that sent a datagram
+        - socklen_t addressLen : Its length
+        - ServerEventsList* eventsList : The events list being built by serverListen
+        - int* eventMemory : The size of the list
+    Output:
+        - Client* : The session of the peer (NULL if the server is full)
+    Description:
+        This function finds the session of a peer, or opens one with a Connection event.
+*/
+static Client* takeUdpSession(Server* server, const SIN* address, socklen_t addressLen, ServerEventsList* eventsList, int* eventMemory) {
+    uint32_t hash = peerHash(address, server->ipType);
+    uint32_t entry;
+    Client* session = findSession(server, address, hash, &entry);
+    if (session != NULL) return session;
+
+    if (serverFull(server)) {
+        statAdd(server->stats, rejectedConnections, 1);
+        return NULL;
+    }
+
+    Client client;
+    NSC_Stats stats;
+    memset(&client, 0, sizeof(client));
+    memset(&stats, 0, sizeof(stats));
+    client.stats = &stats;
+    client.extension = &noExtension;
+    client.socket = server->socket;
+    client.sin = *address;
+    client.recSize = addressLen;
+    client.connType = UDP;
+    client.ipType = server->ipType;
+    client.bufferData.size = server->options.bufferSize; // Never used : a datagram is a whole message
+    client.allocator = &server->allocator;
+    session = addConnection(server, &client);
+    if (server->reliableOptions != NULL) {
+        struct NSC_ClientExtension* extension = clientExtension(session);
+        if (extension != NULL) extension->reliable = rudpCreate(session, server->reliableOptions, server->options.bufferSize);
+        if (extension == NULL || extension->reliable == NULL) {
+            clientDisconnect(server, server->numClients - 1);
+            return NULL;
+        }
+    }
+    server->udpSessions->ids[entry] = session->id;
+    server->udpSessions->hashes[entry] = hash;
+
+    eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, eventMemory, server->options.eventBlock, &server->stats, &server->allocator);
+
+    // New connection event
+    eventsList->events[eventsList->numEvents].type = Connection;
+    eventsList->events[eventsList->numEvents].channel = 0;
+    traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
+    eventsList->events[eventsList->numEvents].socket = server->socket;
+    eventsList->events[eventsList->numEvents].connId = session->id;
+    eventsList->events[eventsList->numEvents].sin = session->sin;
+    eventsList->events[eventsList->numEvents].ipType = server->ipType;
+    eventsList->events[eventsList->numEvents].data = NULL;
+    eventsList->numEvents++;
+    if (server->recorder != NULL) recordEvent(server, &eventsList->events[eventsList->numEvents - 1]);
+    return session;
+}
+
+/*
+    Parameters:
+        - Server* server : The server
+        - ServerEventsList* eventsList : The events list being built by serverListen
+        - int* eventMemory : The size of the list
+    Description:
+        This function sends the retransmissions, queued packets and acknowledgements of the reliable UDP sessions,
+        and disconnects the sessions whose peer stopped acknowledging, adding a Disconnection event for each of them.
+*/
+static void updateReliableSessions(Server* server, ServerEventsList* eventsList, int* eventMemory) {
+    if (server->reliableOptions == NULL) return;
+    for (int i = 0; i < server->numClients; i++) {
+        if (server->clients[i].extension->reliable == NULL) continue;
+        rudpUpdate(&server->clients[i]);
+        if (!server->clients[i].extension->reliable->lost) continue;
+
+        eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, eventMemory, server->options.eventBlock, &server->stats, &server->allocator);
+
+        // Disconnection event
+        eventsList->events[eventsList->numEvents].type = Disconnection;
+        eventsList->events[eventsList->numEvents].channel = 0;
+        traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
+        eventsList->events[eventsList->numEvents].socket = server->socket;
+        eventsList->events[eventsList->numEvents].connId = server->clients[i].id;
+        eventsList->events[eventsList->numEvents].sin = server->clients[i].sin;
+        eventsList->events[eventsList->numEvents].ipType = server->ipType;
+        eventsList->events[eventsList->numEvents].data = NULL;
+        eventsList->numEvents++;
+        if (server->recorder != NULL) recordEvent(server, &eventsList->events[eventsList->numEvents - 1]);
+
+        clientDisconnect(server, i);
+        i--; // replaced the current i-th client by the last one
+    }
+}
+
+/*
+    Parameters:
+        - Server* server : The server
+        - ServerEventsList* eventsList : The events list being built by serverListen
+        - int* eventMemory : The size of the list
+    Description:
+        This function runs the server's expired timers and disconnects the clients that timed out,
+        adding a Disconnection event for each of them.
+*/
+static void processTimers(Server* server, ServerEventsList* eventsList, int* eventMemory) {
+    nscTimerWheelAdvance(&server->timers);
+    uint64_t now = server->timers.now;
 
-    FD_SET(client.socket, &server->socketSet); // Add the client's socket to the server's socket set
-    return &server->clients[server->numClients - 1];
+    while (server->expiredConnections.next != &server->expiredConnections) {
+        NSC_Timer* timer = server->expiredConnections.next;
+        timerUnlink(timer);
+        Client* client = (Client*)((char*)timer - offsetof(Client, timer));
+
+        // The activity isn't rescheduled on every message, so check the actual deadlines
+        int idle = server->idleTimeout != 0 && now >= client->lastActivity + server->idleTimeout;
+        int slowRead = server->readTimeout != 0 && client->partialSince != 0 && now >= client->partialSince + server->readTimeout;
+        if (!idle && !slowRead) {
+            scheduleConnectionTimer(server, client, now);
+            continue;
+        }
+
+        eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, eventMemory, server->options.eventBlock, &server->stats, &server->allocator);
+
+        // Disconnection event
+        eventsList->events[eventsList->numEvents].type = Disconnection;
+        eventsList->events[eventsList->numEvents].channel = 0;
+        traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
+        eventsList->events[eventsList->numEvents].socket = client->socket;
+        eventsList->events[eventsList->numEvents].connId = client->id;
+        eventsList->events[eventsList->numEvents].sin = client->sin;
+        eventsList->events[eventsList->numEvents].ipType = server->ipType;
+        eventsList->events[eventsList->numEvents].data = NULL;
+        eventsList->numEvents++;
+        if (server->recorder != NULL) recordEvent(server, &eventsList->events[eventsList->numEvents - 1]);
+
+        clientDisconnect(server, (int)(client - server->clients));
+    }
+}
+
+/*
+    Parameters:
+        - Server* server : The server
+        - Client* client : One of the server's clients, whose socket has no more data for now
+        - uint64_t tick : The current tick
+    Description:
+        This function keeps track of the incomplete message left in the client's buffer for the read timeout.
+*/
+static void trackPartialMessage(Server* server, Client* client, uint64_t tick) {
+    if (client->bufferData.len > client->bufferData.pos) {
+        if (client->partialSince == 0) {
+            client->partialSince = tick;
+            if (server->readTimeout != 0) scheduleConnectionTimer(server, client, tick);
+        }
+    }
+    else {
+        client->partialSince = 0;
+    }
 }
 
+#define READ_SERVICED 2 // readPending : already read during this serverListen call
+
 /*
     Parameters:
-        - ServerEvent* events : The lists of actual events
-        - int numEvents : The number of events
+        - Server* server : The server
+        - int index : The index of the connection to read
+        - ServerEventsList* eventsList : The events list being built by serverListen
         - int* eventMemory : The size of the list
+        - uint64_t tick : The current tick (0 if no timeout is set)
+        - uint64_t pollStart : Start of the poll() call (tracing)
+        - uint64_t pollEnd : Its end
     Output:
-        - ServerEvent* : The new address of the events' list if creation succeeded, the old address otherwise
+        - int : 1 if the connection was closed (the last connection took its index), 0 otherwise
     Description:
-        This function reallocate space of the server's events list if needed.
+        This function reads the messages of a connection within the read budget, adding their events to the list.
 */
-ServerEvent* eventReallocServer(ServerEvent* events, int numEvents, int* eventMemory) {
-    if (numEvents >= *eventMemory) {
-        *eventMemory += EventBlock;
-        ServerEvent* temp = realloc(events, sizeof(ServerEvent) * *eventMemory);
-        if (!temp) {
-            fprintf(stderr, "Memory allocation failed for events\n");
+static int readConnection(Server* server, int index, ServerEventsList* eventsList, int* eventMemory, uint64_t tick, uint64_t pollStart, uint64_t pollEnd) {
+    Client* client = &server->clients[index];
+    client->lastActivity = tick;
+    client->readPending = 0;
+    uint32_t numFrames = 0;
+    uint32_t numBytes = 0;
+    while (1) {
+        // Read budget reached : the rest is read in the next call
+        if ((server->readBudgetFrames != 0 && numFrames >= server->readBudgetFrames)
+            || (server->readBudgetBytes != 0 && numBytes >= server->readBudgetBytes)) {
+            client->readPending = 1;
+            statAdd(*client->stats, readBudgetHits, 1);
+            break;
+        }
+        // Too many messages undelivered : the rest is read once the application frees them
+        if (server->flowControl != NULL && flowPause(server, client)) {
+            client->readPending = 1; // Complete messages can wait in its buffer, poll() would not report them
+            break;
+        }
+        // Over its rate limits : the rest is read once its tokens are back
+        if (server->rateLimit != NULL && ratePause(server, client, nscMonotonicNs()) != 0) {
+            client->readPending = 1;
+            break;
+        }
+
+        char* buffer = NULL;
+        int bytesReceived = readMessage(client, &buffer);
+
+        // Over its rate limits : the message is dropped, or the connection closed
+        int limited = bytesReceived > 0 && server->rateLimit != NULL && !rateAdmit(server, client, (uint32_t)bytesReceived, nscMonotonicNs());
+        if (limited && server->rateAction == RateDrop) {
+            statAdd(*client->stats, rateDrops, 1);
+            if (buffer != NULL) memFree(&server->allocator, buffer);
+            numFrames++;
+            continue;
+        }
+        if (limited) statAdd(*client->stats, rateDisconnects, 1);
+
+        if (bytesReceived == READMSG_NO_DATA) {
+            if (buffer != NULL) memFree(&server->allocator, buffer);
+            if (tick != 0) trackPartialMessage(server, client, tick);
+            break; // No more data available
+        }
+        else if (limited ||
+                bytesReceived == READMSG_CONN_CLOSED ||
+                bytesReceived == READMSG_ALLOC_FAILED || 
+                bytesReceived == READMSG_SOCKET_ERROR) {
+            eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, eventMemory, server->options.eventBlock, &server->stats, &server->allocator);
+            
+            // Disconnection event
+            eventsList->events[eventsList->numEvents].type = Disconnection;
+            eventsList->events[eventsList->numEvents].channel = 0;
+            traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
+            eventsList->events[eventsList->numEvents].socket = client->socket;
+            eventsList->events[eventsList->numEvents].connId = client->id;
+            eventsList->events[eventsList->numEvents].sin = client->sin;
+            eventsList->events[eventsList->numEvents].ipType = server->ipType;
+            eventsList->events[eventsList->numEvents].data = NULL;
+            eventsList->numEvents++;
+            if (server->recorder != NULL) recordEvent(server, &eventsList->events[eventsList->numEvents - 1]);
+
+            if (buffer != NULL) memFree(&server->allocator, buffer);
+            clientDisconnect(server, index);
+            return 1;
+        }
+        else if (bytesReceived == READMSG_MSG_TOO_LARGE) {
+            if (buffer != NULL) memFree(&server->allocator, buffer);
+            numFrames++; // Invalid messages count in the budget too
+            continue; // tenter de lire un autre message
+        }
+        else if (bytesReceived > 0) {
+            bytesReceived = (bytesReceived < server->options.bufferSize) ? bytesReceived : server->options.bufferSize - 1;
+
+            eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, eventMemory, server->options.eventBlock, &server->stats, &server->allocator);
+
+            // DataReceived event
+            eventsList->events[eventsList->numEvents].type = DataReceived;
+            eventsList->events[eventsList->numEvents].channel = messageStream(client);
+            traceEvent(&eventsList->events[eventsList->numEvents].trace, pollStart, pollEnd, client->bufferData.readTime);
+            traceKernel(&eventsList->events[eventsList->numEvents].trace, client->bufferData.kernelTime, client->bufferData.hardwareTime);
+            eventsList->events[eventsList->numEvents].socket = client->socket;
+            eventsList->events[eventsList->numEvents].connId = client->id;
+            eventsList->events[eventsList->numEvents].sin = client->sin;
+            eventsList->events[eventsList->numEvents].ipType = server->ipType;
+            eventsList->events[eventsList->numEvents].dataSize = bytesReceived;
+            eventsList->events[eventsList->numEvents].data = (char*)memAlloc(&server->allocator, bytesReceived);
+            memcpy(eventsList->events[eventsList->numEvents].data, buffer, bytesReceived);
+            eventsList->numEvents++;
+            if (server->recorder != NULL) recordEvent(server, &eventsList->events[eventsList->numEvents - 1]);
+            statAdd(server->stats, allocations, 1);
+            if (server->flowControl != NULL) flowCount(server->flowControl, client->id, 1, bytesReceived);
+            numFrames++;
+            numBytes += bytesReceived;
+
+            if (buffer != NULL) memFree(&server->allocator, buffer);
+            continue; // Try to continue the reading of other messages
+        }
+        else {
+            if (buffer != NULL) memFree(&server->allocator, buffer);
+            break;
         }
-        events = temp;
     }
-    return events;
+    return 0;
 }
 
 ServerEventsList* serverListen(Server* server) {
-    ServerEventsList* eventsList = (ServerEventsList*)malloc(sizeof(ServerEventsList)); // Create the list of events
+    ServerEventsList* eventsList = (ServerEventsList*)memAlloc(&server->allocator, sizeof(ServerEventsList)); // Create the list of events
 
     eventsList->numEvents = 0;
-    int eventMemory = EventBlock;
-    eventsList->events = (ServerEvent*)malloc(sizeof(ServerEvent) * eventMemory);
-
-    // Rebuild socket set and maxSocket for select()
-    FD_ZERO(&server->socketSet);
-    FD_SET(server->socket, &server->socketSet);
-    server->maxSocket = server->socket;
+    eventsList->allocator = &server->allocator;
+    eventsList->flowControl = server->flowControl;
+    int eventMemory = server->options.eventBlock;
+    eventsList->events = (ServerEvent*)memAlloc(&server->allocator, sizeof(ServerEvent) * eventMemory);
+    statAdd(server->stats, allocations, 2);
 
+    // Rebuild the poll set : entry 0 is the server's socket, entry i + 1 is the i-th client
+    // (poll has no FD_SETSIZE limit, unlike select)
+    int numPolled = server->numClients + 1;
+    server->pollSet[0].fd = server->socket;
+    // The deferred connections wait in the backlog, the listening socket is not polled meanwhile
+    int deferring = server->connType == TCP && server->admissionPolicy == AdmissionDefer && serverFull(server);
+    // So is a UDP server's socket while the application holds too many messages, or while the server is over its rates
+    uint64_t rateNow = (server->rateLimit != NULL) ? nscMonotonicNs() : 0;
+    uint64_t rateWake = 0; // Shortest delay of a reading held by the rate limits (ns)
+    int udpHeld = server->connType == UDP && ((server->flowControl != NULL && flowPause(server, NULL)) || rateHeld(server, NULL, rateNow, &rateWake));
+    server->pollSet[0].events = (deferring || udpHeld) ? 0 : POLLIN;
+    server->pollSet[0].revents = 0;
+    int numPending = 0; // Connections left with data by the read budget (or with data in their shared-memory ring)
+#if defined (__linux__)
+    // Shared-memory connections : their rings are checked for a while before sleeping
+    int pureSpin = server->options.sharedMemory > 0 && server->options.ringSpin < 0;
+    if (server->options.sharedMemory > 0 && server->options.ringSpin != 0) {
+        serverRingsSpinWait(server, ringSpinBudget(server->options.ringSpin, server->options.pollTimeout));
+    }
+#else
+    int pureSpin = 0;
+#endif
     for (int i = 0; i < server->numClients; i++) {
-        FD_SET(server->clients[i].socket, &server->socketSet);
-        server->maxSocket = server->clients[i].socket;
+        int held = server->connType == TCP && ((server->flowControl != NULL && flowPause(server, &server->clients[i]))
+            || rateHeld(server, &server->clients[i], rateNow, &rateWake));
+        server->pollSet[i + 1].fd = (server->connType == TCP) ? server->clients[i].socket : INVALID_SOCKET; // Not the sessions
+        server->pollSet[i + 1].events = outQueuePending(&server->clients[i]) ? (POLLIN | POLLOUT) : POLLIN;
+        server->pollSet[i + 1].revents = 0;
+#if defined (__linux__)
+        if (server->clients[i].extension->ring != NULL) {
+            // The socket is always writable, the outbound queue waits for a doorbell of the consumer instead
+            server->pollSet[i + 1].events = POLLIN;
+            if (!held && !server->clients[i].readPending && ringArm(server->clients[i].extension->ring)) server->clients[i].readPending = 1;
+        }
+#endif
+        if (held) {
+            // Not read until the application frees its messages (or its tokens are back), polled for its outbound queue only
+            server->pollSet[i + 1].events &= ~POLLIN;
+            if (server->pollSet[i + 1].events == 0) server->pollSet[i + 1].fd = INVALID_SOCKET;
+        }
+        else numPending += server->clients[i].readPending;
+    }
+#if defined (__linux__)
+    // The threads sending to the connections wake poll() up
+    if (server->asyncSends != NULL) {
+        server->pollSet[numPolled].fd = server->asyncSends->wakeFd;
+        server->pollSet[numPolled].events = POLLIN;
+        server->pollSet[numPolled].revents = 0;
+        numPolled++;
+    }
+#endif
+
+    // Wait at most 10 ms, less if a timer expires before, not at all if connections have data left
+    int timeout = (numPending != 0 || pureSpin) ? 0 : nscTimerWheelNextTimeout(&server->timers, server->options.pollTimeout);
+    if (server->reliableOptions != NULL) {
+        // Or until the next retransmission of a reliable session
+        for (int i = 0; i < server->numClients && timeout != 0; i++) {
+            if (server->clients[i].extension->reliable != NULL) timeout = rudpTimeout(&server->clients[i], timeout);
+        }
+    }
+    if (rateWake != 0) {
+        // Or until the tokens of a delayed reading are back
+        int rateTimeout = (int)((rateWake + 999999) / 1000000);
+        if (timeout < 0 || rateTimeout < timeout) timeout = rateTimeout;
     }
 
-    // Define the timeout for the select function
-    struct timeval timeout;
-    timeout.tv_sec = 0; // 0 seconds
-    timeout.tv_usec = 10000; // 10 ms
+    uint64_t pollStart = traceEnabled ? nscMonotonicNs() : 0;
+    int numReady = pollSockets(server->pollSet, numPolled, timeout);
+    uint64_t pollEnd = traceEnabled ? nscMonotonicNs() : 0;
+    statAdd(server->stats, pollCalls, 1);
 
-    fd_set copySet = server->socketSet;
-    int numReady = select(server->maxSocket + 1, &copySet, NULL, NULL, &timeout);
+    if (server->asyncSends != NULL) {
+#if defined (__linux__)
+        if (server->pollSet[server->numClients + 1].revents & POLLIN) {
+            // Cleared before the queues are read : a message pushed meanwhile wakes the next poll() up
+            uint64_t wakes;
+            if (read(server->asyncSends->wakeFd, &wakes, sizeof(wakes)) < 0) statAdd(server->stats, eagainHits, 1);
+            numReady--;
+        }
+#endif
+        // The messages of the other threads go before the outbound queues are flushed
+        for (int i = 0; i < server->numClients; i++) flushAsyncMessages(server, &server->clients[i]);
+    }
 
-    if (numReady <= 0) {
-        // timeout or error
+    if (numReady <= 0 && numPending == 0) {
+        // timeout or error : only the timers and the retransmissions can have something to do
+        updateReliableSessions(server, eventsList, &eventMemory);
+        processTimers(server, eventsList, &eventMemory);
         return eventsList;
     }
 
+    uint64_t tick = (server->idleTimeout != 0 || server->readTimeout != 0) ? currentTick() : 0;
+
     // Check if the main server socket is ready (for new connections or UDP data)
-    if (FD_ISSET(server->socket, &copySet)) {
+    if (server->pollSet[0].revents & (POLLIN | POLLERR | POLLHUP)) {
         if (server->connType == TCP) {
-            Client* client = acceptClient(server);
-            while (client != NULL) {
-                // Add the client socket to the socketSet
-                FD_SET(client->socket, &server->socketSet);
-                if (client->socket > server->maxSocket) {
-                    server->maxSocket = client->socket;
+            // Accept at most acceptBudget connections, the others wait for the next call
+            int numAccepted = 0;
+            while (1) {
+                if (server->acceptBudget != 0 && numAccepted >= server->acceptBudget) {
+                    statAdd(server->stats, acceptBudgetHits, 1);
+                    break;
                 }
+                int consumed;
+                Client* client = acceptPending(server, &consumed);
+                if (!consumed) break; // No more pending connections (or deferred)
+                numAccepted++;
+                if (client == NULL) continue; // Rejected
 
-                eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, &eventMemory);
+                eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, &eventMemory, server->options.eventBlock, &server->stats, &server->allocator);
 
                 // New connection event
                 eventsList->events[eventsList->numEvents].type = Connection;
+                eventsList->events[eventsList->numEvents].channel = 0;
+                traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
                 eventsList->events[eventsList->numEvents].socket = client->socket;
+                eventsList->events[eventsList->numEvents].connId = client->id;
                 eventsList->events[eventsList->numEvents].sin = client->sin;
                 eventsList->events[eventsList->numEvents].ipType = client->ipType;
                 eventsList->events[eventsList->numEvents].data = NULL;
                 eventsList->numEvents++;
-
-                client = acceptClient(server);
+                if (server->recorder != NULL) recordEvent(server, &eventsList->events[eventsList->numEvents - 1]);
             }
         } else if (server->connType == UDP) {
-            // UDP socket is ready to receive
-            char* buffer = (char*)malloc(BufferSize);
-            SIN clientAddr;
-            socklen_t clientAddrLen = sizeof(clientAddr);
-
-            int bytesReceived = recvfrom(server->socket, buffer, BufferSize - 1, 0, (SOCKADDR*)&clientAddr, &clientAddrLen);
-
-            if (bytesReceived > 0) {
-                bytesReceived = (bytesReceived < BufferSize) ? bytesReceived : BufferSize - 1;
+            // UDP socket is ready to receive : the waiting datagrams are read, within the read budget
+            char* buffer = (char*)memAlloc(&server->allocator, server->options.bufferSize);
+            statAdd(server->stats, allocations, 1);
+            uint32_t numDatagrams = 0;
+            while (server->readBudgetFrames == 0 || numDatagrams < server->readBudgetFrames) {
+                if (server->flowControl != NULL && flowPause(server, NULL)) break; // The rest waits in the kernel
+                if (server->rateLimit != NULL && ratePause(server, NULL, nscMonotonicNs()) != 0) break;
+                SIN clientAddr;
+                socklen_t clientAddrLen = sizeof(clientAddr);
+                if (server->ipType == UNIX) memset(&clientAddr, 0, sizeof(clientAddr)); // The length of the address is not kept
 
-                eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, &eventMemory);
+                uint64_t kernelTime = 0;
+                uint64_t hardwareTime = 0;
+                int bytesReceived = (server->options.timestamping & NSC_TIMESTAMP_RX)
+                    ? recvTimestamped(server->socket, buffer, server->options.bufferSize - 1, &clientAddr, &clientAddrLen, &kernelTime, &hardwareTime)
+                    : recvfrom(server->socket, buffer, server->options.bufferSize - 1, 0, (SOCKADDR*)&clientAddr, &clientAddrLen);
+                uint64_t recvEnd = traceEnabled ? nscMonotonicNs() : 0;
+                statAdd(server->stats, recvCalls, 1);
+                if (bytesReceived < 0) {
+                    if (wouldBlock()) statAdd(server->stats, eagainHits, 1);
+                    break; // No more datagrams
+                }
+                numDatagrams++;
 
-                // Data received event (UDP)
-                eventsList->events[eventsList->numEvents].type = DataReceived;
-                eventsList->events[eventsList->numEvents].socket = server->socket;
-                eventsList->events[eventsList->numEvents].sin = clientAddr;
-                eventsList->events[eventsList->numEvents].ipType = server->ipType;
-                eventsList->events[eventsList->numEvents].dataSize = bytesReceived;
-                eventsList->events[eventsList->numEvents].data = (char*)malloc(bytesReceived);
-                memcpy(eventsList->events[eventsList->numEvents].data, buffer, bytesReceived);
-                eventsList->numEvents++;
-            }
+                // The datagram of a peer belongs to its session (opened by its first datagram), dropped if the server is full
+                Client* session = NULL;
+                if (bytesReceived > 0 && server->udpSessions != NULL) {
+                    session = takeUdpSession(server, &clientAddr, clientAddrLen, eventsList, &eventMemory);
+                    if (session == NULL) bytesReceived = 0;
+                }
 
-            free(buffer);
-        }
-    }
+                // Every datagram takes its tokens, the packets of reliable UDP included
+                int limited = bytesReceived > 0 && server->rateLimit != NULL && !rateAdmit(server, session, bytesReceived, nscMonotonicNs());
+                if (limited) {
+                    // Over the limits of its session : dropped (the reading of the others is not delayed), or its session closed
+                    if (session != NULL && server->rateAction == RateDisconnect) {
+                        statAdd(*session->stats, rateDisconnects, 1);
+                        eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, &eventMemory, server->options.eventBlock, &server->stats, &server->allocator);
 
-    // Check all connected clients for data (TCP)
-    for (int i = 0; i < server->numClients; i++) {
-        if (FD_ISSET(server->clients[i].socket, &copySet)) {
-            while (1) {
-                char* buffer = NULL;
-                int bytesReceived = readMessage(&server->clients[i], &buffer);
+                        // Disconnection event
+                        eventsList->events[eventsList->numEvents].type = Disconnection;
+                        eventsList->events[eventsList->numEvents].channel = 0;
+                        traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
+                        eventsList->events[eventsList->numEvents].socket = server->socket;
+                        eventsList->events[eventsList->numEvents].connId = session->id;
+                        eventsList->events[eventsList->numEvents].sin = session->sin;
+                        eventsList->events[eventsList->numEvents].ipType = server->ipType;
+                        eventsList->events[eventsList->numEvents].data = NULL;
+                        eventsList->numEvents++;
+                        if (server->recorder != NULL) recordEvent(server, &eventsList->events[eventsList->numEvents - 1]);
 
-                if (bytesReceived == READMSG_NO_DATA) {
-                    if (buffer != NULL) free(buffer);
-                    break; // No more data available
+                        clientDisconnect(server, (int)(session - server->clients));
+                    }
+                    else {
+                        NSC_Stats* stats = (session != NULL) ? session->stats : &server->stats;
+                        statAdd(*stats, rateDrops, 1);
+                    }
                 }
-                else if (bytesReceived == READMSG_CONN_CLOSED || 
-                        bytesReceived == READMSG_ALLOC_FAILED || 
-                        bytesReceived == READMSG_SOCKET_ERROR) {
-                    eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, &eventMemory);
-                    
-                    // Disconnection event
-                    eventsList->events[eventsList->numEvents].type = Disconnection;
-                    eventsList->events[eventsList->numEvents].socket = server->clients[i].socket;
-                    eventsList->events[eventsList->numEvents].sin = server->clients[i].sin;
-                    eventsList->events[eventsList->numEvents].ipType = server->ipType;
-                    eventsList->events[eventsList->numEvents].data = NULL;
-                    eventsList->numEvents++;
+                else if (bytesReceived > 0 && session != NULL && session->extension->reliable != NULL) {
+                    // A packet of reliable UDP : its complete messages are delivered with their channel
+                    statAdd(*session->stats, bytesIn, bytesReceived);
+                    if (tick != 0) session->lastActivity = tick;
+                    rudpReceive(session, buffer, bytesReceived);
+                    int channel;
+                    char* data;
+                    uint32_t len;
+                    while (rudpTakeMessage(session, &channel, &data, &len)) {
+                        if (server->flowControl != NULL) flowCount(server->flowControl, session->id, 1, len);
+                        eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, &eventMemory, server->options.eventBlock, &server->stats, &server->allocator);
 
-                    if (buffer != NULL) free(buffer);
-                    clientDisconnect(server, i);
-                    i--; // replaced the current i-th client by the last one, so we go back to check it
-                    break;
-                }
-                else if (bytesReceived == READMSG_MSG_TOO_LARGE) {
-                    if (buffer != NULL) free(buffer);
-                    continue; // tenter de lire un autre message
+                        // Data received event (reliable UDP), the message is handed over
+                        eventsList->events[eventsList->numEvents].type = DataReceived;
+                        eventsList->events[eventsList->numEvents].channel = channel;
+                        traceEvent(&eventsList->events[eventsList->numEvents].trace, pollStart, pollEnd, recvEnd);
+                        traceKernel(&eventsList->events[eventsList->numEvents].trace, kernelTime, hardwareTime);
+                        eventsList->events[eventsList->numEvents].socket = server->socket;
+                        eventsList->events[eventsList->numEvents].connId = session->id;
+                        eventsList->events[eventsList->numEvents].sin = session->sin;
+                        eventsList->events[eventsList->numEvents].ipType = server->ipType;
+                        eventsList->events[eventsList->numEvents].dataSize = len;
+                        eventsList->events[eventsList->numEvents].data = data;
+                        eventsList->numEvents++;
+                        if (server->recorder != NULL) recordEvent(server, &eventsList->events[eventsList->numEvents - 1]);
+                    }
                 }
                 else if (bytesReceived > 0) {
-                    bytesReceived = (bytesReceived < BufferSize) ? bytesReceived : BufferSize - 1;
+                    NSC_Stats* stats = (session != NULL) ? session->stats : &server->stats;
+                    statAdd(*stats, bytesIn, bytesReceived);
+                    statAdd(*stats, framesIn, 1);
+                    statAdd(server->stats, allocations, 1);
+                    bytesReceived = (bytesReceived < server->options.bufferSize) ? bytesReceived : server->options.bufferSize - 1;
+                    if (session != NULL && tick != 0) session->lastActivity = tick;
+                    if (server->flowControl != NULL) flowCount(server->flowControl, (session != NULL) ? session->id : 0, 1, bytesReceived);
 
-                    eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, &eventMemory);
+                    eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, &eventMemory, server->options.eventBlock, &server->stats, &server->allocator);
 
-                    // DataReceived event
+                    // Data received event (UDP)
                     eventsList->events[eventsList->numEvents].type = DataReceived;
-                    eventsList->events[eventsList->numEvents].socket = server->clients[i].socket;
-                    eventsList->events[eventsList->numEvents].sin = server->clients[i].sin;
+                    eventsList->events[eventsList->numEvents].channel = 0;
+                    traceEvent(&eventsList->events[eventsList->numEvents].trace, pollStart, pollEnd, recvEnd);
+                    traceKernel(&eventsList->events[eventsList->numEvents].trace, kernelTime, hardwareTime);
+                    eventsList->events[eventsList->numEvents].socket = server->socket;
+                    eventsList->events[eventsList->numEvents].connId = (session != NULL) ? session->id : 0;
+                    eventsList->events[eventsList->numEvents].sin = clientAddr;
                     eventsList->events[eventsList->numEvents].ipType = server->ipType;
                     eventsList->events[eventsList->numEvents].dataSize = bytesReceived;
-                    eventsList->events[eventsList->numEvents].data = (char*)malloc(bytesReceived);
+                    eventsList->events[eventsList->numEvents].data = (char*)memAlloc(&server->allocator, bytesReceived);
                     memcpy(eventsList->events[eventsList->numEvents].data, buffer, bytesReceived);
                     eventsList->numEvents++;
-
-                    if (buffer != NULL) free(buffer);
-                    continue; // Try to continue the reading of other messages
-                }
-                else {
-                    if (buffer != NULL) free(buffer);
-                    break;
+                    if (server->recorder != NULL) recordEvent(server, &eventsList->events[eventsList->numEvents - 1]);
                 }
             }
+            memFree(&server->allocator, buffer);
+        }
+    }
+
+    // The connections left with data by the read budget are read first, so they are not starved by the others
+    for (int i = 0; i < server->numClients; i++) {
+        if (!(server->clients[i].readPending & 1) || server->clients[i].flowPaused || server->clients[i].ratePaused) continue;
+#if defined (__linux__)
+        if (server->clients[i].extension->ring != NULL && (server->pollSet[i + 1].revents & (POLLIN | POLLERR | POLLHUP))) server->clients[i].extension->ring->checkSocket = 1;
+#endif
+        if (readConnection(server, i, eventsList, &eventMemory, tick, pollStart, pollEnd)) {
+            i--; // The last connection took its index
+            continue;
+        }
+        server->clients[i].readPending |= READ_SERVICED;
+    }
+
+    // Check all connected clients for data (TCP)
+    // Clients accepted during this call have no revents yet, they are polled next time
+    for (int i = 0; i < server->numClients; i++) {
+        short revents = server->pollSet[i + 1].revents;
+
+        // Zero-copy completions and send timestamps are signaled by POLLERR, report them
+        if (server->clients[i].extension->zeroCopy != NULL || (server->clients[i].timestamping & NSC_TIMESTAMP_TX)) {
+            if (revents & POLLERR) readErrorQueue(&server->clients[i]);
+            const char* sentBuffer;
+            uint32_t sentLen;
+            while (takeZeroCopyCompleted(&server->clients[i], &sentBuffer, &sentLen)) {
+                eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, &eventMemory, server->options.eventBlock, &server->stats, &server->allocator);
+
+                // SendComplete event
+                eventsList->events[eventsList->numEvents].type = SendComplete;
+                eventsList->events[eventsList->numEvents].channel = 0;
+                traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
+                eventsList->events[eventsList->numEvents].socket = server->clients[i].socket;
+                eventsList->events[eventsList->numEvents].connId = server->clients[i].id;
+                eventsList->events[eventsList->numEvents].sin = server->clients[i].sin;
+                eventsList->events[eventsList->numEvents].ipType = server->ipType;
+                eventsList->events[eventsList->numEvents].data = (char*)sentBuffer;
+                eventsList->events[eventsList->numEvents].dataSize = sentLen;
+                eventsList->numEvents++;
+            }
+            uint32_t sendId;
+            uint64_t kernelTime;
+            uint64_t hardwareTime;
+            while (takeSendTimestamp(&server->clients[i], &sendId, &kernelTime, &hardwareTime)) {
+                eventsList->events = eventReallocServer(eventsList->events, eventsList->numEvents, &eventMemory, server->options.eventBlock, &server->stats, &server->allocator);
+
+                // SendTimestamp event
+                eventsList->events[eventsList->numEvents].type = SendTimestamp;
+                eventsList->events[eventsList->numEvents].channel = 0;
+                traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
+                traceKernel(&eventsList->events[eventsList->numEvents].trace, kernelTime, hardwareTime);
+                eventsList->events[eventsList->numEvents].socket = server->clients[i].socket;
+                eventsList->events[eventsList->numEvents].connId = server->clients[i].id;
+                eventsList->events[eventsList->numEvents].sin = server->clients[i].sin;
+                eventsList->events[eventsList->numEvents].ipType = server->ipType;
+                eventsList->events[eventsList->numEvents].data = NULL;
+                eventsList->events[eventsList->numEvents].dataSize = sendId;
+                eventsList->numEvents++;
+            }
+            revents &= ~POLLERR; // A socket error also comes with POLLIN or POLLHUP
+        }
+
+#if defined (__linux__)
+        if (server->clients[i].extension->ring != NULL) {
+            if (revents & (POLLIN | POLLERR | POLLHUP)) server->clients[i].extension->ring->checkSocket = 1;
+            if (outQueuePending(&server->clients[i])) revents |= POLLOUT; // The consumer may have made room
+        }
+#endif
+
+        // Send the outbound queue (an error is reported by the reading below)
+        if (revents & POLLOUT) flushConnection(&server->clients[i]);
+
+        if ((revents & (POLLIN | POLLERR | POLLHUP)) && !(server->clients[i].readPending & READ_SERVICED)
+            && !server->clients[i].flowPaused && !server->clients[i].ratePaused) {
+            if (readConnection(server, i, eventsList, &eventMemory, tick, pollStart, pollEnd)) {
+                i--; // The last connection took its index
+                continue;
+            }
+        }
+        server->clients[i].readPending &= ~READ_SERVICED;
+    }
+
+    updateReliableSessions(server, eventsList, &eventMemory);
+    processTimers(server, eventsList, &eventMemory);
+
+    if (pollStart != 0) {
+        uint64_t delivered = nscMonotonicNs();
+        for (int i = 0; i < eventsList->numEvents; i++) {
+            traceDeliver(&eventsList->events[i].trace, delivered, 1);
         }
     }
 
     return eventsList;
 }
 
+void nscFreeServerEvents(ServerEventsList* eventsList) {
+    if (eventsList == NULL) return;
+    const NSC_Allocator* allocator = eventsList->allocator;
+    for (int i = 0; i < eventsList->numEvents; i++) {
+        if (eventsList->events[i].type != SendComplete) memFree(allocator, eventsList->events[i].data);
+        if (eventsList->flowControl != NULL && eventsList->events[i].type == DataReceived) {
+            flowCount(eventsList->flowControl, eventsList->events[i].connId, -1, -(int64_t)eventsList->events[i].dataSize);
+        }
+    }
+    memFree(allocator, eventsList->events);
+    memFree(allocator, eventsList);
+}
+
 void clientDisconnect(Server* server, int index) {
-    FD_CLR(server->clients[index].socket, &server->socketSet); // Remove the client's socket from the server's socket set
-    closesocket(server->clients[index].socket); // Close the client's socket
+    if (server->connType == TCP) {
+        closesocket(server->clients[index].socket); // Close the client's socket
+    }
+    else if (server->udpSessions != NULL) {
+        removeSession(server, &server->clients[index]); // A session shares the server's socket
+    }
+    releaseBuffer(&server->clients[index]);
+    if (server->clients[index].timer.next != NULL) timerUnlink(&server->clients[index].timer);
+    freeZeroCopy(&server->clients[index]);
+    freeOutQueue(&server->clients[index]);
+    freeCompression(&server->clients[index]);
+    freeReliable(&server->clients[index]);
+    freeSendTimestamps(&server->clients[index]);
+    freeStreams(&server->clients[index]);
+    if (server->asyncSends != NULL) dropAsyncMessages(server, server->clients[index].id & (NSC_ID_SLOTS - 1));
+    freeSubscriptions(server, &server->clients[index]);
+    freeSharedRing(&server->clients[index]);
+    freeExtension(&server->clients[index]);
+    releaseConnectionId(server->connectionIds, server->clients[index].id);
 
-    // replace the disconnected client with the last client in the list
+    // Keep the statistics of the disconnected client in the server's ones
+    addStats(&server->stats, server->clients[index].stats);
+
+    // replace the disconnected client with the last client in the list (and its poll entry)
     server->clients[index] = server->clients[server->numClients - 1];
+    server->pollSet[index + 1] = server->pollSet[server->numClients];
+    timerMoved(&server->clients[index].timer);
+    if (index != server->numClients - 1) {
+        server->connectionIds->index[server->clients[index].id & (NSC_ID_SLOTS - 1)] = index;
+    }
 
     server->numClients--; // Decrement the number of clients connected to the server
 }
 
+int setServerBacklog(Server* server, int backlog) {
+    if (server->connType != TCP) return -1;
+    if (listen(server->socket, backlog) == SOCKET_ERROR) return -1;
+    server->backlog = backlog;
+    return 0;
+}
+
+void setServerAdmission(Server* server, int acceptBudget, int maxConnections, int policy) {
+    server->acceptBudget = (acceptBudget > 0) ? acceptBudget : 0;
+    server->maxConnections = (maxConnections > 0 && maxConnections < server->options.maxClients) ? maxConnections : server->options.maxClients;
+    server->admissionPolicy = policy;
+}
+
+void setServerReadBudget(Server* server, uint32_t frames, uint32_t bytes) {
+    server->readBudgetFrames = frames;
+    server->readBudgetBytes = bytes;
+}
+
+int setServerFlowControl(Server* server, uint32_t connectionEvents, uint32_t connectionBytes, uint32_t totalEvents, uint64_t totalBytes) {
+    int enabled = connectionEvents != 0 || connectionBytes != 0 || totalEvents != 0 || totalBytes != 0;
+    if (enabled && server->flowControl == NULL) {
+        struct NSC_FlowControl* flow = (struct NSC_FlowControl*)memCalloc(&server->allocator, 1, sizeof(struct NSC_FlowControl));
+        if (!flow) return -1;
+        server->flowControl = flow;
+        flow->numSlots = (uint32_t)server->options.maxClients;
+        flow->events = (uint64_t*)memCalloc(&server->allocator, flow->numSlots, sizeof(uint64_t));
+        flow->bytes = (uint64_t*)memCalloc(&server->allocator, flow->numSlots, sizeof(uint64_t));
+        flow->ids = (uint64_t*)memCalloc(&server->allocator, flow->numSlots, sizeof(uint64_t));
+        if (!flow->events || !flow->bytes || !flow->ids) {
+            freeFlowControl(server);
+            return -1;
+        }
+        statAdd(server->stats, allocations, 4);
+        // The messages handed out before are not counted
+        for (int i = 0; i < server->numClients; i++) flowReset(flow, server->clients[i].id);
+    }
+    server->flowEvents = connectionEvents;
+    server->flowBytes = connectionBytes;
+    server->flowTotalEvents = totalEvents;
+    server->flowTotalBytes = totalBytes;
+    return 0;
+}
+
+int setServerRateLimit(Server* server, uint32_t connectionFrames, uint32_t connectionBytes, uint32_t totalFrames, uint64_t totalBytes, int action) {
+    if (action != RateDelay && action != RateDrop && action != RateDisconnect) return -1;
+    int enabled = connectionFrames != 0 || connectionBytes != 0 || totalFrames != 0 || totalBytes != 0;
+    if (!enabled) {
+        // The delayed connections are read again
+        freeRateLimit(server);
+        for (int i = 0; i < server->numClients; i++) server->clients[i].ratePaused = 0;
+        server->ratePaused = 0;
+    }
+    else if (server->rateLimit == NULL) {
+        struct NSC_RateLimit* rate = (struct NSC_RateLimit*)memCalloc(&server->allocator, 1, sizeof(struct NSC_RateLimit));
+        if (!rate) return -1;
+        server->rateLimit = rate;
+        rate->numSlots = (uint32_t)server->options.maxClients;
+        rate->frames = (uint64_t*)memCalloc(&server->allocator, rate->numSlots, sizeof(uint64_t));
+        rate->bytes = (uint64_t*)memCalloc(&server->allocator, rate->numSlots, sizeof(uint64_t));
+        if (!rate->frames || !rate->bytes) {
+            freeRateLimit(server);
+            return -1;
+        }
+        statAdd(server->stats, allocations, 3);
+    }
+    server->rateFrames = connectionFrames;
+    server->rateBytes = connectionBytes;
+    server->rateTotalFrames = totalFrames;
+    server->rateTotalBytes = totalBytes;
+    server->rateAction = action;
+    return 0;
+}
+
+int enableServerAsyncSend(Server* server) {
+    if (server->asyncSends != NULL) return 0;
+    struct NSC_AsyncSends* async = (struct NSC_AsyncSends*)memCalloc(&server->allocator, 1, sizeof(struct NSC_AsyncSends));
+    if (!async) return -1;
+    async->numSlots = (uint32_t)server->options.maxClients;
+    async->heads = (uint64_t*)memCalloc(&server->allocator, async->numSlots, sizeof(uint64_t));
+#if defined (__linux__)
+    async->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+    server->asyncSends = async;
+#if defined (__linux__)
+    if (async->wakeFd < 0) {
+        freeAsyncSends(server);
+        return -1;
+    }
+#endif
+    if (!async->heads) {
+        freeAsyncSends(server);
+        return -1;
+    }
+    statAdd(server->stats, allocations, 2);
+    return 0;
+}
+
+int sendAsyncMessage(Server* server, uint32_t connId, const char* msg, uint32_t len) {
+    struct NSC_AsyncSends* async = server->asyncSends;
+    uint32_t slot = connId & (NSC_ID_SLOTS - 1);
+    if (async == NULL || slot >= async->numSlots || len == 0 || len > NSC_FRAME_LENGTH_MASK) return -1;
+
+    // Framed by the sending thread, the server's thread only writes it
+    AsyncMessage* message = (AsyncMessage*)memAlloc(&server->allocator, sizeof(AsyncMessage) + 4 + len);
+    if (!message) return -1;
+    message->connId = connId;
+    message->len = len;
+    uint32_t header = htonl(len);
+    memcpy(message->frame, &header, 4);
+    memcpy(message->frame + 4, msg, len);
+
+    // Push on the slot's stack, the server's thread reverses it to send the messages in order
+    uint64_t head;
+    do {
+        head = atomicLoad64(&async->heads[slot]);
+        message->next = (AsyncMessage*)(uintptr_t)head;
+    } while (!atomicCasRelease64(&async->heads[slot], head, (uint64_t)(uintptr_t)message));
+
+#if defined (__linux__)
+    // The queue was empty : serverListen may be waiting in poll()
+    if (head == 0) {
+        uint64_t wake = 1;
+        if (write(async->wakeFd, &wake, sizeof(wake)) < 0 && errno != EAGAIN) return -1;
+    }
+#endif
+    return 0;
+}
+
+int getFlowControlStatus(Server* server, uint32_t connId, uint64_t* events, uint64_t* bytes) {
+    struct NSC_FlowControl* flow = server->flowControl;
+    if (flow == NULL) return -1;
+    int64_t numEvents;
+    int64_t numBytes;
+    if (connId == 0) {
+        numEvents = (int64_t)atomicLoad64(&flow->totalEvents);
+        numBytes = (int64_t)atomicLoad64(&flow->totalBytes);
+    }
+    else {
+        uint32_t slot = connId & (NSC_ID_SLOTS - 1);
+        if (getConnection(server, connId) == NULL || slot >= flow->numSlots) return -1;
+        numEvents = (int64_t)atomicLoad64(&flow->events[slot]);
+        numBytes = (int64_t)atomicLoad64(&flow->bytes[slot]);
+    }
+    *events = (numEvents > 0) ? (uint64_t)numEvents : 0;
+    *bytes = (numBytes > 0) ? (uint64_t)numBytes : 0;
+    return 0;
+}
+
+int enableUdpSessions(Server* server, uint32_t idleTimeout) {
+    if (server->connType != UDP) return -1;
+    if (server->udpSessions == NULL) {
+        uint32_t numEntries = 2;
+        while (numEntries < 2 * (uint32_t)server->options.maxClients) numEntries <<= 1;
+        struct NSC_UdpSessions* sessions = (struct NSC_UdpSessions*)memCalloc(&server->allocator, 1, sizeof(struct NSC_UdpSessions));
+        if (!sessions) return -1;
+        sessions->ids = (uint32_t*)memCalloc(&server->allocator, numEntries, sizeof(uint32_t));
+        sessions->hashes = (uint32_t*)memAlloc(&server->allocator, sizeof(uint32_t) * numEntries);
+        sessions->mask = numEntries - 1;
+        server->udpSessions = sessions;
+        if (!sessions->ids || !sessions->hashes) {
+            freeUdpSessions(server);
+            return -1;
+        }
+        statAdd(server->stats, allocations, 3);
+    }
+    setServerTimeouts(server, idleTimeout, server->readTimeout);
+    return 0;
+}
+
+int enableServerReliable(Server* server, const NSC_ReliableOptions* options) {
+    if (server->connType != UDP) return -1;
+    if (options != NULL && (options->numChannels < 0 || options->numChannels > NSC_MAX_CHANNELS)) return -1;
+    if (server->udpSessions == NULL && enableUdpSessions(server, server->idleTimeout) != 0) return -1;
+    if (server->reliableOptions == NULL) {
+        server->reliableOptions = (NSC_ReliableOptions*)memCalloc(&server->allocator, 1, sizeof(NSC_ReliableOptions));
+        if (!server->reliableOptions) return -1;
+        statAdd(server->stats, allocations, 1);
+    }
+    if (options != NULL) *server->reliableOptions = *options;
+    return 0;
+}
+
+int enableClientReliable(Client* client, const NSC_ReliableOptions* options) {
+    if (client->connType != UDP || client->extension->reliable != NULL) return -1;
+    if (options != NULL && (options->numChannels < 0 || options->numChannels > NSC_MAX_CHANNELS)) return -1;
+    struct NSC_ClientExtension* extension = clientExtension(client);
+    if (extension == NULL) return -1;
+    extension->reliable = rudpCreate(client, options, client->bufferData.size);
+    return (extension->reliable != NULL) ? 0 : -1;
+}
+
+int sendChannelMessage(Client* connection, int channel, const char* msg, uint32_t len) {
+    struct NSC_Reliable* reliable = connection->extension->reliable;
+    if (reliable == NULL || channel < 0 || channel >= reliable->options.numChannels || len > RUDP_MAX_MESSAGE) return -1;
+    uint32_t numFragments = (len + reliable->fragmentSize - 1) / reliable->fragmentSize;
+    if (numFragments == 0) numFragments = 1;
+    if (numFragments > 0xFFFF) return -1;
+    uint32_t seq = reliable->nextMessage[channel]++;
+
+    if (reliable->options.channelTypes[channel] == ChannelUnreliableSequenced) {
+        // Sent right away, never acknowledged nor retransmitted
+        for (uint32_t i = 0; i < numFragments; i++) {
+            uint32_t chunk = (i + 1 < numFragments) ? reliable->fragmentSize : len - i * reliable->fragmentSize;
+            rudpHeader(reliable->scratch, RUDP_DATA, channel, i, numFragments, reliable->fragmentSize, seq);
+            memcpy(reliable->scratch + RUDP_HEADER, msg + (size_t)i * reliable->fragmentSize, chunk);
+            rudpTransmit(connection, reliable->scratch, RUDP_HEADER + chunk);
+        }
+        statAdd(*connection->stats, framesOut, 1);
+        return 0;
+    }
+
+    // Reliable : the packets are queued, then sent within the congestion window
+    for (uint32_t i = 0; i < numFragments; i++) {
+        uint32_t chunk = (i + 1 < numFragments) ? reliable->fragmentSize : len - i * reliable->fragmentSize;
+        RudpPacket* packet = (RudpPacket*)memAlloc(connection->allocator, sizeof(RudpPacket) + RUDP_HEADER + chunk);
+        if (!packet) return -1;
+        statAdd(*connection->stats, allocations, 1);
+        memset(packet, 0, sizeof(RudpPacket));
+        packet->len = RUDP_HEADER + chunk;
+        rudpHeader(packet->data, RUDP_RELIABLE, channel, i, numFragments, reliable->fragmentSize, seq);
+        memcpy(packet->data + RUDP_HEADER, msg + (size_t)i * reliable->fragmentSize, chunk);
+        if (reliable->queueTail != NULL) reliable->queueTail->next = packet;
+        else reliable->queueHead = packet;
+        reliable->queueTail = packet;
+        reliable->queued++;
+    }
+    statAdd(*connection->stats, framesOut, 1);
+    rudpFlush(connection, rudpNow());
+    return 0;
+}
+
+int getReliableStatus(Client* connection, NSC_ReliableStatus* status) {
+    struct NSC_Reliable* reliable = connection->extension->reliable;
+    if (reliable == NULL) return -1;
+    status->rtt = (uint32_t)reliable->srtt;
+    status->rttVariation = (uint32_t)reliable->rttvar;
+    status->retransmitTimeout = (uint32_t)reliable->rto;
+    status->congestionWindow = reliable->cwnd;
+    status->inFlight = reliable->inFlight;
+    status->queued = reliable->queued;
+    return 0;
+}
+
+void setServerTimeouts(Server* server, uint32_t idleTimeout, uint32_t readTimeout) {
+    server->idleTimeout = idleTimeout;
+    server->readTimeout = readTimeout;
+
+    uint64_t now = currentTick();
+    for (int i = 0; i < server->numClients; i++) {
+        server->clients[i].lastActivity = now;
+        scheduleConnectionTimer(server, &server->clients[i], now);
+    }
+}
+
+Client* getConnection(Server* server, uint32_t connId) {
+    if (server->connectionIds == NULL) return NULL;
+    uint32_t slot = connId & (NSC_ID_SLOTS - 1);
+    if (slot >= (uint32_t)server->options.maxClients) return NULL;
+    int index = server->connectionIds->index[slot];
+    if (index < 0 || server->clients[index].id != connId) return NULL; // Free slot or older connection
+    return &server->clients[index];
+}
+
+// The server's topics, created on first use
+static struct NSC_Topics* serverTopics(Server* server) {
+    if (server->topics == NULL) {
+        struct NSC_Topics* topics = (struct NSC_Topics*)memCalloc(&server->allocator, 1, sizeof(struct NSC_Topics));
+        if (!topics) return NULL;
+        topics->buckets = (NSC_Topic**)memCalloc(&server->allocator, TOPIC_BUCKETS, sizeof(NSC_Topic*));
+        if (!topics->buckets) {
+            memFree(&server->allocator, topics);
+            return NULL;
+        }
+        topics->numBuckets = TOPIC_BUCKETS;
+        topics->allocator = &server->allocator;
+        server->topics = topics;
+        statAdd(server->stats, allocations, 2);
+    }
+    return server->topics;
+}
+
+int subscribe(Server* server, uint32_t connId, const char* topic) {
+    Client* client = getConnection(server, connId); // A TCP connection or a UDP session
+    if (client == NULL) return -1;
+
+    struct NSC_Topics* topics = serverTopics(server);
+    if (topics == NULL) return -1;
+
+    uint32_t hash = topicHash(topic);
+    NSC_Topic* found = findTopic(topics, topic, hash, NULL);
+    struct NSC_Subscriptions* subscriptions = client->extension->subscriptions;
+    if (found != NULL && subscriptions != NULL) {
+        for (int i = 0; i < subscriptions->numTopics; i++) {
+            if (subscriptions->topics[i] == found) return 0; // Already subscribed
+        }
+    }
+
+    // Room in the connection's subscriptions
+    if (subscriptions == NULL) {
+        struct NSC_ClientExtension* extension = clientExtension(client);
+        if (!extension) return -1;
+        subscriptions = (struct NSC_Subscriptions*)memCalloc(&server->allocator, 1, sizeof(struct NSC_Subscriptions));
+        if (!subscriptions) return -1;
+        statAdd(*client->stats, allocations, 1);
+        extension->subscriptions = subscriptions;
+    }
+    if (subscriptions->numTopics == subscriptions->capacity) {
+        int capacity = (subscriptions->capacity == 0) ? 4 : subscriptions->capacity * 2;
+        NSC_Topic** temp = (NSC_Topic**)memRealloc(&server->allocator, subscriptions->topics, sizeof(NSC_Topic*) * capacity);
+        if (!temp) return -1;
+        statAdd(*client->stats, allocations, 1);
+        subscriptions->topics = temp;
+        subscriptions->capacity = capacity;
+    }
+
+    // Create the topic on its first subscription
+    if (found == NULL) {
+        found = (NSC_Topic*)memCalloc(&server->allocator, 1, sizeof(NSC_Topic));
+        if (!found) return -1;
+        size_t nameLen = strlen(topic);
+        found->name = (char*)memAlloc(&server->allocator, nameLen + 1);
+        if (!found->name) {
+            memFree(&server->allocator, found);
+            return -1;
+        }
+        memcpy(found->name, topic, nameLen + 1);
+        found->hash = hash;
+        found->next = topics->buckets[hash & (topics->numBuckets - 1)];
+        topics->buckets[hash & (topics->numBuckets - 1)] = found;
+        topics->numTopics++;
+        statAdd(server->stats, allocations, 2);
+        if (topics->numTopics > topics->numBuckets) growTopics(topics);
+    }
+    if (found->numSubscribers == found->capacity) {
+        uint32_t capacity = (found->capacity == 0) ? 8 : found->capacity * 2;
+        uint32_t* temp = (uint32_t*)memRealloc(&server->allocator, found->subscribers, sizeof(uint32_t) * capacity);
+        if (!temp) {
+            if (found->numSubscribers == 0) removeSubscriber(topics, found, connId); // Frees the new topic
+            return -1;
+        }
+        statAdd(server->stats, allocations, 1);
+        found->subscribers = temp;
+        found->capacity = capacity;
+    }
+
+    found->subscribers[found->numSubscribers++] = connId;
+    subscriptions->topics[subscriptions->numTopics++] = found;
+    return 0;
+}
+
+int unsubscribe(Server* server, uint32_t connId, const char* topic) {
+    Client* client = getConnection(server, connId);
+    if (client == NULL || client->extension->subscriptions == NULL || server->topics == NULL) return -1;
+
+    NSC_Topic* found = findTopic(server->topics, topic, topicHash(topic), NULL);
+    if (found == NULL) return -1;
+
+    struct NSC_Subscriptions* subscriptions = client->extension->subscriptions;
+    for (int i = 0; i < subscriptions->numTopics; i++) {
+        if (subscriptions->topics[i] == found) {
+            subscriptions->topics[i] = subscriptions->topics[--subscriptions->numTopics];
+            removeSubscriber(server->topics, found, connId);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Send the frame built in topics->frame to the subscribers of a topic
+static int publishFrame(Server* server, NSC_Topic* found, uint32_t len) {
+    struct NSC_Topics* topics = server->topics;
+    uint32_t len_net = htonl(len);
+    memcpy(topics->frame, &len_net, 4);
+
+    // A failed connection is skipped, its disconnection comes with the next serverListen
+    int numSent = 0;
+    for (uint32_t i = 0; i < found->numSubscribers; i++) {
+        Client* client = getConnection(server, found->subscribers[i]);
+        if (client == NULL) continue;
+        if (client->connType == UDP) {
+            // A UDP session gets the message as one datagram, without the length
+            if (sendClientMessage(client, topics->frame + 4, len) != 0) continue;
+        }
+        else if (sendStream(client, topics->frame, len + 4, 1) != 0) {
+            statAdd(*client->stats, partialSends, 1);
+            continue;
+        }
+        numSent++;
+    }
+    return numSent;
+}
+
+char* nscPublishReserve(Server* server, uint32_t maxLen) {
+    if (maxLen > NSC_FRAME_LENGTH_MASK) return NULL;
+    struct NSC_Topics* topics = serverTopics(server);
+    if (topics == NULL) return NULL;
+
+    // The frame is built once : [length : 4 bytes][message]
+    if (topics->frameSize < maxLen + 4) {
+        char* temp = (char*)memRealloc(&server->allocator, topics->frame, maxLen + 4);
+        if (!temp) return NULL;
+        statAdd(server->stats, allocations, 1);
+        topics->frame = temp;
+        topics->frameSize = maxLen + 4;
+    }
+    return topics->frame + 4;
+}
+
+int nscPublishCommit(Server* server, const char* topic, uint32_t len) {
+    struct NSC_Topics* topics = server->topics;
+    if (topics == NULL || topics->frame == NULL || len > topics->frameSize - 4) return -1;
+    NSC_Topic* found = findTopic(topics, topic, topicHash(topic), NULL);
+    if (found == NULL) return 0;
+    return publishFrame(server, found, len);
+}
+
+int publish(Server* server, const char* topic, const char* msg, uint32_t len) {
+    if (len > NSC_FRAME_LENGTH_MASK) return -1;
+    if (server->topics == NULL) return 0;
+    NSC_Topic* found = findTopic(server->topics, topic, topicHash(topic), NULL);
+    if (found == NULL) return 0;
+
+    char* frame = nscPublishReserve(server, len);
+    if (frame == NULL) return -1;
+    memcpy(frame, msg, len);
+    return publishFrame(server, found, len);
+}
+
 Client* createClient(const char* address, int port, int connType, int ipType) {
-    Client* client = (Client*)calloc(1, sizeof(Client)); // Create the client's structure
-    if (!client) return NULL;
+    return createClientEx(address, port, connType, ipType, NULL);
+}
+
+Client* createClientEx(const char* address, int port, int connType, int ipType, const NSC_Options* options) {
+#if !defined (__linux__)
+    if (ipType == UNIX) {
+        fprintf(stderr, "UNIX domain sockets are not supported on this system\n");
+        return NULL;
+    }
+#endif
+    // Create the client's structure, followed by its copy of the allocator
+    const NSC_Allocator* allocator = (options != NULL && options->allocator != NULL) ? options->allocator : &globalAllocator;
+    StandaloneClient* standalone = (StandaloneClient*)memCalloc(allocator, 1, sizeof(StandaloneClient));
+    if (!standalone) return NULL;
+    Client* client = &standalone->client;
+    standalone->allocator = *allocator;
+    client->allocator = &standalone->allocator;
+    client->stats = &standalone->stats;
+    client->extension = &noExtension;
+
+    NSC_Options resolved = resolveOptions(options);
+    client->eventBlock = resolved.eventBlock;
+    client->pollTimeout = resolved.pollTimeout;
 
     client->recSize = sizeof(client->sin);
 
     // Create the client's socket
     int type = (connType == TCP) ? SOCK_STREAM : SOCK_DGRAM; // Support for TCP and UDP
-    int ip = (ipType == IPv4) ? AF_INET : AF_INET6; // Support for IPv4 and IPv6
+    int ip = addressFamily(ipType); // Support for IPv4, IPv6 and UNIX domain sockets
 
     client->socket = socket(ip, type, 0);
     if (client->socket == INVALID_SOCKET) {
         fprintf(stderr, "Invalid socket\n");
-        free(client);
+        memFree(allocator, client);
         return NULL;
     }
 
     client->connType = connType;
     client->ipType = ipType;
 
+    // Apply the options before connect()
+    applySocketOptions(client->socket, &resolved, connType, ipType);
+#if defined (__linux__)
+    if (connType == TCP && ipType != UNIX && resolved.fastOpen > 0) {
+        int enabled = 1;
+        setsockopt(client->socket, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &enabled, sizeof(enabled));
+    }
+#endif
+
     // Init the client's buffer
-    client->bufferData.buffer = malloc(BufferSize);
-    memset(client->bufferData.buffer, 0, BufferSize);
+    client->bufferData.size = resolved.bufferSize;
+    client->bufferData.buffer = memAlloc(allocator, client->bufferData.size);
     if (!client->bufferData.buffer) {
         closesocket(client->socket);
-        free(client);
+        memFree(allocator, client);
         fprintf(stderr, "Buffer malloc() failed\n");
         return NULL;
     }
+    memset(client->bufferData.buffer, 0, client->bufferData.size);
     client->bufferData.len = 0;
     client->bufferData.pos = 0;
+    statAdd(*client->stats, allocations, 2);
 
     int status = 0;
     // Set the client's information
@@ -348,32 +5094,60 @@ Client* createClient(const char* address, int port, int connType, int ipType) {
             client->sin.in6.sin6_port = htons(port);
             status = inet_pton(ip, address, &client->sin.in6.sin6_addr);
             break;
+#if defined (__linux__)
+        case AF_UNIX:
+            client->recSize = setUnixAddress(&client->sin.un, address);
+            status = (client->recSize != 0) ? 1 : 0;
+            if (status == 1 && connType == UDP) {
+                // A datagram socket needs an address of its own to get the answers : the kernel gives it one in the abstract namespace
+                struct sockaddr_un autoBind;
+                autoBind.sun_family = AF_UNIX;
+                bind(client->socket, (SOCKADDR*)&autoBind, sizeof(sa_family_t));
+            }
+            break;
+#endif
     }
 
     if (status != 1) {
-        fprintf(stderr, "Invalid IP address\n");
-        free(client->bufferData.buffer);
+        fprintf(stderr, (ipType == UNIX) ? "Invalid socket path\n" : "Invalid IP address\n");
+        memFree(allocator, client->bufferData.buffer);
         closesocket(client->socket);
-        free(client);
+        memFree(allocator, client);
         return NULL;
     }
 
     // Connect the client's socket
     if (connect(client->socket, (SOCKADDR*)&client->sin, client->recSize) == SOCKET_ERROR) {
         fprintf(stderr, "Error connecting the client's socket\n");
-        free(client->bufferData.buffer);
+        memFree(allocator, client->bufferData.buffer);
         closesocket(client->socket);
-        free(client);
+        memFree(allocator, client);
         return NULL;
     }
 
+    // The send timestamps of a stream socket are numbered from its connection
+    client->timestamping = enableTimestamping(client->socket, resolved.timestamping, ipType);
+
+#if defined (__linux__)
+    // The server sends the shared memory of the connection's rings first
+    if (ipType == UNIX && connType == TCP && resolved.sharedMemory > 0
+        && takeSharedRing(client, (uint32_t)resolved.sharedMemory, resolved.ringSpin) != 0) {
+        fprintf(stderr, "Error mapping the shared memory of the connection\n");
+        freeExtension(client);
+        memFree(allocator, client->bufferData.buffer);
+        closesocket(client->socket);
+        memFree(allocator, client);
+        return NULL;
+    }
+#endif
+
 // Set the socket to non-blocking mode
 #if defined(_WIN32)
     u_long nonBlocking = 1; // 1 is for non-blocking mode
     if (ioctlsocket(client->socket, FIONBIO, &nonBlocking) != 0) {
         fprintf(stderr, "Failed to set socket to non-blocking mode\n");
         closesocket(client->socket);
-        free(client);
+        memFree(allocator, client);
         return NULL;
     }
 #elif defined(__linux__)
@@ -381,23 +5155,29 @@ Client* createClient(const char* address, int port, int connType, int ipType) {
     if (flags == -1 || fcntl(client->socket, F_SETFL, flags | O_NONBLOCK) == -1) {
         fprintf(stderr, "Failed to set socket to non-blocking mode\n");
         close(client->socket);
-        free(client);
+        memFree(allocator, client);
         return NULL;
     }
 #endif
 
-
-    // Add the client to the set of sockets to listen to
-    FD_ZERO(&client->socketSet);
-    FD_SET(client->socket, &client->socketSet);
+    if (connType == TCP && resolved.streamChunk > 0 && client->extension->ring == NULL) enableStreams(client, (uint32_t)resolved.streamChunk);
 
     return client;
 }
 
 void closeClient(Client* client) {
-    free(client->bufferData.buffer);
+    memFree(client->allocator, client->bufferData.buffer);
+    freeZeroCopy(client);
+    freeOutQueue(client);
+    freeCompression(client);
+    freeSharedRing(client);
+    freeReliable(client);
+    freeSendTimestamps(client);
+    freeStreams(client);
+    freeExtension(client);
     closesocket(client->socket);
-    free(client);
+    NSC_Allocator allocator = *client->allocator; // The structure holds its own allocator
+    memFree(&allocator, client);
 }
 
 /*
@@ -405,15 +5185,19 @@ void closeClient(Client* client) {
         - ClientEvent* events : The lists of actual events
         - int numEvents : The number of events
         - int* eventMemory : The size of the list
+        - int eventBlock : The number of events added at once
+        - NSC_Stats* stats : The statistics in which the reallocation is counted
+        - const NSC_Allocator* allocator : The allocator of the list
     Output:
         - ClientEvent* : The new address of the events' list if creation succeeded, the old address otherwise
     Description:
         This function reallocate space of the client's events list if needed.
 */
-ClientEvent* eventReallocClient(ClientEvent* events, int numEvents, int* eventMemory) {
+ClientEvent* eventReallocClient(ClientEvent* events, int numEvents, int* eventMemory, int eventBlock, NSC_Stats* stats, const NSC_Allocator* allocator) {
     if (numEvents >= *eventMemory) {
-        *eventMemory += EventBlock;
-        ClientEvent* temp = realloc(events, sizeof(ClientEvent) * *eventMemory);
+        *eventMemory += eventBlock;
+        statAdd(*stats, allocations, 1);
+        ClientEvent* temp = memRealloc(allocator, events, sizeof(ClientEvent) * *eventMemory);
         if (!temp) {
             fprintf(stderr, "Memory allocation failed for events\n");
         }
@@ -423,39 +5207,113 @@ ClientEvent* eventReallocClient(ClientEvent* events, int numEvents, int* eventMe
 }
 
 ClientEventsList* clientListen(Client* client) {
-    ClientEventsList* eventsList = (ClientEventsList*)malloc(sizeof(ClientEventsList)); // Create the list of events
+    ClientEventsList* eventsList = (ClientEventsList*)memAlloc(client->allocator, sizeof(ClientEventsList)); // Create the list of events
 
     eventsList->numEvents = 0; // Initialize the number of events to 0
+    eventsList->allocator = client->allocator;
 
-    int eventMemory = EventBlock;
-    eventsList->events = (ClientEvent*)malloc(sizeof(ClientEvent) * eventMemory); // Create the array of events
+    int eventMemory = client->eventBlock;
+    eventsList->events = (ClientEvent*)memAlloc(client->allocator, sizeof(ClientEvent) * eventMemory); // Create the array of events
+    statAdd(*client->stats, allocations, 2);
 
+    int buffered = 0; // 1 after a message was read : the buffer may hold more messages, that poll() does not report
     while (1) {
-        // Define the timeout for the select function
-        struct timeval timeout;
-        timeout.tv_sec = 0; // 0 seconds
-        timeout.tv_usec = 10000; // 10 ms
-
-        // Copy the client's socket set
-        fd_set copySet;
-        FD_ZERO(&copySet);
-        FD_SET(client->socket, &copySet);
+        // Poll the client's socket for reading, and for writing if its outbound queue is not empty
+        // (poll has no FD_SETSIZE limit, unlike select)
+        struct pollfd pollEntry;
+        pollEntry.fd = client->socket;
+        pollEntry.events = outQueuePending(client) ? (POLLIN | POLLOUT) : POLLIN;
+        pollEntry.revents = 0;
 
-        // Select the sockets that are ready for reading
-        int numReady = select(client->socket + 1, &copySet, NULL, NULL, &timeout);
+        uint64_t pollStart = traceEnabled ? nscMonotonicNs() : 0;
+        int timeout = buffered ? 0 : client->pollTimeout; // 10 ms timeout by default
+        if (client->extension->reliable != NULL && timeout != 0) timeout = rudpTimeout(client, timeout); // Or until the next retransmission
+        int ringReady = 0;
+#if defined (__linux__)
+        struct NSC_SharedRing* ring = client->extension->ring;
+        if (ring != NULL) {
+            // A shared-memory connection skips poll() while its ring has data
+            if (buffered && client->bufferData.pos >= client->bufferData.len && !ring->checkSocket && !ringHasData(ring)) break;
+            if (!buffered && ring->spin != 0) ringSpinWait(ring, ringSpinBudget(ring->spin, client->pollTimeout));
+            ringReady = ringArm(ring);
+            if (ring->spin < 0) timeout = 0;
+            pollEntry.events = POLLIN; // The outbound queue waits for a doorbell of the consumer
+        }
+#endif
+        int numReady = 1;
+        if (ringReady) {
+            pollEntry.revents = POLLIN;
+        }
+        else {
+            numReady = pollSockets(&pollEntry, 1, timeout);
+            statAdd(*client->stats, pollCalls, 1);
+        }
+        uint64_t pollEnd = traceEnabled ? nscMonotonicNs() : 0;
 
         if (numReady <= 0) {
-            break; // Timeout or error
+            if (!buffered) break; // Timeout or error
+            pollEntry.revents = POLLIN; // Read the buffered messages
+        }
+        buffered = 0;
+
+        // Zero-copy completions and send timestamps are signaled by POLLERR, report them
+        if (client->extension->zeroCopy != NULL || (client->timestamping & NSC_TIMESTAMP_TX)) {
+            if (pollEntry.revents & POLLERR) readErrorQueue(client);
+            const char* sentBuffer;
+            uint32_t sentLen;
+            while (takeZeroCopyCompleted(client, &sentBuffer, &sentLen)) {
+                eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory, client->eventBlock, client->stats, client->allocator);
+                eventsList->events[eventsList->numEvents].type = SendComplete;
+                eventsList->events[eventsList->numEvents].channel = 0;
+                traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
+                eventsList->events[eventsList->numEvents].data = (char*)sentBuffer;
+                eventsList->events[eventsList->numEvents].dataSize = sentLen;
+                eventsList->numEvents++;
+            }
+            uint32_t sendId;
+            uint64_t kernelTime;
+            uint64_t hardwareTime;
+            while (takeSendTimestamp(client, &sendId, &kernelTime, &hardwareTime)) {
+                eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory, client->eventBlock, client->stats, client->allocator);
+                eventsList->events[eventsList->numEvents].type = SendTimestamp;
+                eventsList->events[eventsList->numEvents].channel = 0;
+                traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
+                traceKernel(&eventsList->events[eventsList->numEvents].trace, kernelTime, hardwareTime);
+                eventsList->events[eventsList->numEvents].data = NULL;
+                eventsList->events[eventsList->numEvents].dataSize = sendId;
+                eventsList->numEvents++;
+            }
+            pollEntry.revents &= ~POLLERR; // A socket error also comes with POLLIN or POLLHUP
+        }
+
+#if defined (__linux__)
+        if (ring != NULL) {
+            if (!ringReady && (pollEntry.revents & (POLLIN | POLLERR | POLLHUP))) ring->checkSocket = 1;
+            if (outQueuePending(client)) pollEntry.revents |= POLLOUT; // The consumer may have made room
         }
+#endif
+
+        // Send the outbound queue (an error is reported by the reading below)
+        if (pollEntry.revents & POLLOUT) flushConnection(client);
 
         // Check if the client's socket is ready for reading
-        if (FD_ISSET(client->socket, &copySet)) {
+        if (pollEntry.revents & (POLLIN | POLLERR | POLLHUP)) {
             // Handling data received from the server
             char* buffer = NULL;
             int bytesReceived = 0;
             if (client->connType == UDP) {
-                buffer = (char*)malloc(BufferSize);
-                bytesReceived = recvfrom(client->socket, buffer, BufferSize - 1, 0, (SOCKADDR*)&client->sin, &client->recSize);
+                buffer = (char*)memAlloc(client->allocator, client->bufferData.size);
+                bytesReceived = (client->timestamping & NSC_TIMESTAMP_RX)
+                    ? recvTimestamped(client->socket, buffer, client->bufferData.size - 1, &client->sin, &client->recSize,
+                                      &client->bufferData.kernelTime, &client->bufferData.hardwareTime)
+                    : recvfrom(client->socket, buffer, client->bufferData.size - 1, 0, (SOCKADDR*)&client->sin, &client->recSize);
+                if (traceEnabled) client->bufferData.readTime = nscMonotonicNs();
+                statAdd(*client->stats, recvCalls, 1);
+                statAdd(*client->stats, allocations, 1);
+                if (bytesReceived > 0) {
+                    statAdd(*client->stats, bytesIn, bytesReceived);
+                    if (client->extension->reliable == NULL) statAdd(*client->stats, framesIn, 1); // Reliable UDP counts the complete messages
+                }
             }
             else if (client->connType == TCP) {
                 // Receive the data from the server
@@ -466,10 +5324,12 @@ ClientEventsList* clientListen(Client* client) {
             if (client->connType == TCP) {
                 if (bytesReceived == READMSG_CONN_CLOSED) {
                     // Connection closed by peer
-                    eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory);
+                    eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory, client->eventBlock, client->stats, client->allocator);
 
                     // Add the event to the list
                     eventsList->events[eventsList->numEvents].type = Disconnection;
+                    eventsList->events[eventsList->numEvents].channel = 0;
+                    traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
                     eventsList->events[eventsList->numEvents].data = NULL;
 
                     eventsList->numEvents++; // Increment the number of events
@@ -477,13 +5337,15 @@ ClientEventsList* clientListen(Client* client) {
                 }
                 else if (bytesReceived == READMSG_MSG_TOO_LARGE) {
                     // Message too large - handle without disconnecting
-                    if (buffer != NULL) free(buffer);
+                    if (buffer != NULL) memFree(client->allocator, buffer);
                     continue; // Skip this iteration, try reading again next loop
                 }
                 else if (bytesReceived == READMSG_ALLOC_FAILED || bytesReceived == READMSG_SOCKET_ERROR) {
                     // Critical errors - treat as disconnection
-                    eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory);
+                    eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory, client->eventBlock, client->stats, client->allocator);
                     eventsList->events[eventsList->numEvents].type = Disconnection;
+                    eventsList->events[eventsList->numEvents].channel = 0;
+                    traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
                     eventsList->events[eventsList->numEvents].data = NULL;
                     eventsList->numEvents++;
                     break;
@@ -491,73 +5353,162 @@ ClientEventsList* clientListen(Client* client) {
                 else if (bytesReceived > 0) {
                     // Data received
                     // Limit the number of bytes received to the buffer size
-                    bytesReceived = (bytesReceived < BufferSize) ? bytesReceived : BufferSize - 1;
+                    bytesReceived = (bytesReceived < client->bufferData.size) ? bytesReceived : client->bufferData.size - 1;
 
-                    eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory);
+                    eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory, client->eventBlock, client->stats, client->allocator);
 
                     // Add the event to the list
                     eventsList->events[eventsList->numEvents].type = DataReceived;
+                    eventsList->events[eventsList->numEvents].channel = messageStream(client);
+                    traceEvent(&eventsList->events[eventsList->numEvents].trace, pollStart, pollEnd, client->bufferData.readTime);
+                    traceKernel(&eventsList->events[eventsList->numEvents].trace, client->bufferData.kernelTime, client->bufferData.hardwareTime);
                     eventsList->events[eventsList->numEvents].dataSize = bytesReceived;
-                    eventsList->events[eventsList->numEvents].data = (char*)malloc(bytesReceived * sizeof(char));
+                    eventsList->events[eventsList->numEvents].data = (char*)memAlloc(client->allocator, bytesReceived * sizeof(char));
+                    statAdd(*client->stats, allocations, 1);
 
                     // Copy the data received to the event
                     memcpy(eventsList->events[eventsList->numEvents].data, buffer, bytesReceived);
-                    if (buffer != NULL) free(buffer);
+                    if (buffer != NULL) memFree(client->allocator, buffer);
 
                     eventsList->numEvents++; // Increment the number of events
+                    buffered = 1;
                 }
                 else if (bytesReceived == READMSG_NO_DATA) {
-                    // No complete message available yet, just continue
-                    if (buffer != NULL) free(buffer);
+                    // No complete message available yet : wait for it, unless messages were already received
+                    if (buffer != NULL) memFree(client->allocator, buffer);
+                    if (eventsList->numEvents > 0) break;
                     continue;
                 }
             }
+            else if (client->extension->reliable != NULL) {
+                // Reliable UDP : the packet's complete messages are delivered with their channel
+                if (bytesReceived > 0) rudpReceive(client, buffer, bytesReceived);
+                if (buffer != NULL) memFree(client->allocator, buffer);
+                if (bytesReceived <= 0) break;
+                int channel;
+                char* data;
+                uint32_t len;
+                while (rudpTakeMessage(client, &channel, &data, &len)) {
+                    eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory, client->eventBlock, client->stats, client->allocator);
+                    eventsList->events[eventsList->numEvents].type = DataReceived;
+                    eventsList->events[eventsList->numEvents].channel = channel;
+                    traceEvent(&eventsList->events[eventsList->numEvents].trace, pollStart, pollEnd, client->bufferData.readTime);
+                    traceKernel(&eventsList->events[eventsList->numEvents].trace, client->bufferData.kernelTime, client->bufferData.hardwareTime);
+                    eventsList->events[eventsList->numEvents].dataSize = len;
+                    eventsList->events[eventsList->numEvents].data = data; // Handed over
+                    eventsList->numEvents++;
+                }
+                buffered = 1; // More packets may be waiting
+            }
             else {
                 // UDP case
                 if (bytesReceived > 0) {
-                    eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory);
+                    eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory, client->eventBlock, client->stats, client->allocator);
 
                     // Add the event to the list
                     eventsList->events[eventsList->numEvents].type = DataReceived;
+                    eventsList->events[eventsList->numEvents].channel = 0;
+                    traceEvent(&eventsList->events[eventsList->numEvents].trace, pollStart, pollEnd, client->bufferData.readTime);
+                    traceKernel(&eventsList->events[eventsList->numEvents].trace, client->bufferData.kernelTime, client->bufferData.hardwareTime);
                     eventsList->events[eventsList->numEvents].dataSize = bytesReceived;
-                    eventsList->events[eventsList->numEvents].data = (char*)malloc(bytesReceived * sizeof(char));
+                    eventsList->events[eventsList->numEvents].data = (char*)memAlloc(client->allocator, bytesReceived * sizeof(char));
+                    statAdd(*client->stats, allocations, 1);
 
                     memcpy(eventsList->events[eventsList->numEvents].data, buffer, bytesReceived);
                 }
-                if (buffer != NULL) free(buffer);
+                if (buffer != NULL) memFree(client->allocator, buffer);
                 if (bytesReceived <= 0) break; // UDP socket error or closed
                 eventsList->numEvents++; // Increment the number of events
+                buffered = 1; // More datagrams may be waiting
             }
         }
     }
 
+    // Reliable UDP : retransmissions, queued packets and acknowledgements
+    if (client->extension->reliable != NULL) {
+        rudpUpdate(client);
+        if (client->extension->reliable->lost) {
+            eventsList->events = eventReallocClient(eventsList->events, eventsList->numEvents, &eventMemory, client->eventBlock, client->stats, client->allocator);
+            eventsList->events[eventsList->numEvents].type = Disconnection;
+            eventsList->events[eventsList->numEvents].channel = 0;
+            traceEvent(&eventsList->events[eventsList->numEvents].trace, 0, 0, 0);
+            eventsList->events[eventsList->numEvents].data = NULL;
+            eventsList->numEvents++;
+        }
+    }
+
+    if (traceEnabled) {
+        uint64_t delivered = nscMonotonicNs();
+        for (int i = 0; i < eventsList->numEvents; i++) {
+            traceDeliver(&eventsList->events[i].trace, delivered, 0);
+        }
+    }
+
     return eventsList;
 }
 
+void nscFreeClientEvents(ClientEventsList* eventsList) {
+    if (eventsList == NULL) return;
+    const NSC_Allocator* allocator = eventsList->allocator;
+    for (int i = 0; i < eventsList->numEvents; i++) {
+        if (eventsList->events[i].type != SendComplete) memFree(allocator, eventsList->events[i].data);
+    }
+    memFree(allocator, eventsList->events);
+    memFree(allocator, eventsList);
+}
+
 int readMessage(Client* client, char **msg) {
     ClientBuffer* bfData = &client->bufferData;
-    int haveLen = 0;
+    if (client->extension->streams != NULL) client->extension->streams->received = 0;
 
     while (1) {
         // Check if we already have at least 4 bytes to read the message length
         if (bfData->len - bfData->pos >= 4) {
             uint32_t lenNet;
             memcpy(&lenNet, bfData->buffer + bfData->pos, 4);
-            uint32_t msgLen = ntohl(lenNet); // Convert length from network byte order
-            haveLen = 1;
+            uint32_t header = ntohl(lenNet); // Convert length from network byte order
+            uint32_t msgLen = header & NSC_FRAME_LENGTH_MASK;
+            uint32_t flags = header & ~NSC_FRAME_LENGTH_MASK;
+
+            // The peer reads streams too
+            if (header == NSC_FRAME_HELLO && client->extension->streams != NULL) {
+                client->extension->streams->peer = 1;
+                bfData->pos += 4;
+                continue;
+            }
+            int chunk = (flags == NSC_FRAME_STREAM && client->extension->streams != NULL);
 
-            // Validate message length
-            if (msgLen == 0 || msgLen > BufferSize - 4) {
+            // Validate message length (a dictionary without compression is invalid too, but for the chunks of a stream)
+            if (msgLen == 0 || msgLen > (uint32_t)bfData->size - 4 || (flags == NSC_FRAME_DICTIONARY && !chunk)
+                || (chunk && msgLen <= STREAM_CHUNK_HEADER)) {
+                if (!bfData->skipping) statAdd(*client->stats, oversizeDrops, 1); // Count each invalid header once
+                bfData->skipping = 1;
+                statAdd(*client->stats, resyncBytes, 1);
                 bfData->pos += 1; // Resynchronize by advancing 1 byte at a time
                 continue;         // Try to find a valid header later
             }
+            bfData->skipping = 0;
 
             // Check if the full message has been received
             if (bfData->len - bfData->pos - 4 >= (int)msgLen) {
-                *msg = malloc(msgLen + 1); // Allocate space for message + null terminator
+                if (chunk) {
+                    int status = takeStreamChunk(client, (const uint8_t*)bfData->buffer + bfData->pos + 4, msgLen, msg);
+                    bfData->pos += 4 + msgLen;
+                    if (status == 0) continue; // The message is not complete yet
+                    return status;
+                }
+                if (flags != 0) {
+                    int status = decompressFrame(client, flags, bfData->buffer + bfData->pos + 4, msgLen, msg);
+                    bfData->pos += 4 + msgLen; // Move position past this message, even if it is invalid
+                    return status;
+                }
+
+                *msg = memAlloc(client->allocator, msgLen + 1); // Allocate space for message + null terminator
                 if (!*msg) {
                     return READMSG_ALLOC_FAILED;
                 }
+                statAdd(*client->stats, allocations, 1);
+                statAdd(*client->stats, framesIn, 1);
 
                 memcpy(*msg, bfData->buffer + bfData->pos + 4, msgLen);
                 (*msg)[msgLen] = '\0';
@@ -569,36 +5520,42 @@ int readMessage(Client* client, char **msg) {
         }
 
         // Compact remaining unread data to buffer start
-        if (bfData->len > 0 && bfData->pos < bfData->len) {
+        if (bfData->pos >= bfData->len) {
+            bfData->len = 0;
+            bfData->pos = 0;
+        }
+        else if (bfData->pos > 0) {
             memmove(bfData->buffer, bfData->buffer + bfData->pos, bfData->len - bfData->pos);
             bfData->len -= bfData->pos;
             bfData->pos = 0;
         }
 
+        // A server's connection only holds a buffer while it has data pending
+        if (bfData->buffer == NULL && takeBuffer(client) == NULL) {
+            return READMSG_ALLOC_FAILED;
+        }
+
         // Read more data from the socket
-        int n = recv(client->socket, bfData->buffer + bfData->len, BufferSize - bfData->len, 0);
+        int n = streamRecv(client, bfData->buffer + bfData->len, bfData->size - bfData->len);
+        statAdd(*client->stats, recvCalls, 1);
         if (n < 0) {
 #ifdef _WIN32
             int err = WSAGetLastError();
             if (err == WSAEWOULDBLOCK) {
-                if (!haveLen) {
-                    return READMSG_NO_DATA;
-                } else {
-                    Sleep(10);
-                    continue;
-                }
+                // The incomplete message (if any) stays in the buffer until the next call
+                statAdd(*client->stats, eagainHits, 1);
+                if (bfData->len == 0) releaseBuffer(client);
+                return READMSG_NO_DATA;
             } 
             else {
                 return READMSG_SOCKET_ERROR;
             }
 #else
             if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                if (!haveLen) {
-                    return READMSG_NO_DATA;
-                } else {
-                    usleep(10 * 1000);
-                    continue;
-                }
+                // The incomplete message (if any) stays in the buffer until the next call
+                statAdd(*client->stats, eagainHits, 1);
+                if (bfData->len == 0) releaseBuffer(client);
+                return READMSG_NO_DATA;
             } else {
                 return READMSG_SOCKET_ERROR;
             }
@@ -609,44 +5566,437 @@ int readMessage(Client* client, char **msg) {
         }
 
         bfData->len += n;
+        if (traceEnabled) bfData->readTime = nscMonotonicNs();
+        statAdd(*client->stats, bytesIn, n);
+        statMax(*client->stats, peakBufferUsage, bfData->len);
+    }
+}
+
+/*
+    Parameters:
+        - SOCKET socket : The socket to send the data to
+        - const char* data : The bytes to send
+        - uint32_t len : The number of bytes
+        - NSC_Stats* stats : The statistics to update
+    Output:
+        - int : 0 if every byte was sent, -1 otherwise
+    Description:
+        This function sends len bytes on a stream socket, calling send() until everything is sent or an error occurs.
+        A non-blocking socket (the server's connections) is waited for when it is full : a frame is never left cut.
+*/
+static int sendAll(SOCKET socket, const char* data, uint32_t len, NSC_Stats* stats) {
+    uint32_t totalSent = 0;
+    while (totalSent < len) {
+        int sent = send(socket, data + totalSent, len - totalSent, 0);
+        statAdd(*stats, sendCalls, 1);
+        if (sent < 0 && wouldBlock()) {
+            statAdd(*stats, eagainHits, 1);
+            struct pollfd pollEntry;
+            pollEntry.fd = socket;
+            pollEntry.events = POLLOUT;
+            pollEntry.revents = 0;
+            int numReady = pollSockets(&pollEntry, 1, -1);
+            statAdd(*stats, pollCalls, 1);
+            if ((numReady > 0 && (pollEntry.revents & POLLOUT)) || (numReady < 0 && errno == EINTR)) continue;
+            return -1;
+        }
+        if (sent <= 0) return -1;
+        totalSent += sent;
+        statAdd(*stats, bytesOut, sent);
+    }
+    return 0;
+}
+
+/*
+    Parameters:
+        - SOCKET socket : The socket to send the data to
+        - const char *msg : The data to send
+        - uint32_t len : The length of the data
+        - int connType : The connection type (TCP or UDP)
+        - int ipType : The IP type (IPv4 or IPv6)
+        - SIN* sin : The address to send the data to (UDP only)
+        - NSC_Stats* stats : The statistics to update
+    Output:
+        - int : 0 if the whole message was sent, -1 otherwise
+    Description:
+        This function sends a message : framed with its length in TCP, as a single datagram in UDP.
+*/
+static int sendFrame(SOCKET socket, const char *msg, uint32_t len, int connType, int ipType, SIN* sin, NSC_Stats* stats) {
+    int status = 0;
+    if (connType == TCP) {
+        uint32_t len_net = htonl(len);
+        status = sendAll(socket, (const char*)&len_net, 4, stats);
+        if (status == 0) status = sendAll(socket, msg, len, stats);
+    }
+    else {
+        if (!sin) return -1; // NULL address
+        status = sendDatagram(socket, msg, len, ipType, sin, stats);
+    }
+
+    if (status == 0) {
+        statAdd(*stats, framesOut, 1);
+    }
+    else {
+        statAdd(*stats, partialSends, 1);
     }
+    return status;
 }
 
-void sendMessage(SOCKET* socket, const char *msg, uint32_t len, int connType, int ipType, SIN* sin) {
+int sendMessage(SOCKET* socket, const char *msg, uint32_t len, int connType, int ipType, SIN* sin) {
     int realType = 0;
     socklen_t length = sizeof(realType);
     getsockopt(*socket, SOL_SOCKET, SO_TYPE, (char*)&realType, &length);
-    if (connType == TCP && realType == SOCK_STREAM) {
-        uint32_t len_net = htonl(len);
-        int totalSent = 0;
-        while (totalSent < 4) {
-            int sent = send(*socket, ((char *)&len_net) + totalSent, 4 - totalSent, 0);
-            if (sent <= 0) {
-                break;
-            }
+    if ((connType == TCP && realType == SOCK_STREAM) || (connType == UDP && realType == SOCK_DGRAM)) {
+        NSC_Stats ignored = {0}; // sendMessage doesn't know the connection, nothing is counted
+        return sendFrame(*socket, msg, len, connType, ipType, sin, &ignored);
+    }
+    fprintf(stderr, "Error : connType and socket type are not matching.\n");
+    return -1;
+}
+
+/*
+    Parameters:
+        - Client* client : A TCP connection in zero-copy mode
+        - const char *msg : The message, referenced by the kernel until its completion
+        - uint32_t len : The length of the message
+    Output:
+        - int : 0 if the whole message was sent, -1 otherwise
+    Description:
+        This function sends the header of the message normally and its body with MSG_ZEROCOPY,
+        then keeps the message in the pending ones until the kernel completes all its send() calls.
+        When the socket is full, the rest of the message is copied in the outbound queue (it does not wait).
+*/
+static int sendZeroCopy(Client* client, const char *msg, uint32_t len) {
+#if defined (__linux__)
+    struct NSC_ZeroCopy* zeroCopy = client->extension->zeroCopy;
+    if (zeroCopy->numPending == zeroCopy->capacity) {
+        int capacity = (zeroCopy->capacity == 0) ? 8 : zeroCopy->capacity * 2;
+        ZeroCopySend* temp = (ZeroCopySend*)memRealloc(client->allocator, zeroCopy->pending, sizeof(ZeroCopySend) * capacity);
+        if (!temp) return -1;
+        statAdd(*client->stats, allocations, 1);
+        zeroCopy->pending = temp;
+        zeroCopy->capacity = capacity;
+    }
+
+    // The header goes like any bytes : what the socket does not take is queued
+    uint32_t len_net = htonl(len);
+    if (sendStream(client, (const char*)&len_net, 4, 0) != 0) {
+        statAdd(*client->stats, partialSends, 1);
+        return -1;
+    }
+
+    // The body is sent in zero-copy while the socket takes it
+    uint32_t firstId = zeroCopy->nextId;
+    uint32_t totalSent = 0;
+    int status = 0;
+    while (totalSent < len && !outQueuePending(client)) {
+        int sent = send(client->socket, msg + totalSent, len - totalSent, MSG_ZEROCOPY);
+        statAdd(*client->stats, sendCalls, 1);
+        if (sent > 0) {
             totalSent += sent;
+            zeroCopy->nextId++;
+            statAdd(*client->stats, bytesOut, sent);
+            continue;
         }
-        totalSent = 0;
-        while (totalSent < len) {
-            int sent = send(*socket, msg + totalSent, len - totalSent, 0);
+        if (sent < 0 && wouldBlock()) {
+            statAdd(*client->stats, eagainHits, 1);
+            break;
+        }
+        if (sent < 0 && errno == ENOBUFS) break; // Too many notifications pending for the socket
+        status = -1;
+        break;
+    }
+    // The rest is copied (in the outbound queue if the socket is full), the event loop never waits for the socket
+    int copied = status == 0 && totalSent < len;
+    if (copied) status = sendStream(client, msg + totalSent, len - totalSent, 1);
+
+    // Keep the message until the kernel releases it : reported by a SendComplete event even if nothing went in zero-copy
+    ZeroCopySend* pending = &zeroCopy->pending[zeroCopy->numPending++];
+    pending->buffer = msg;
+    pending->len = len;
+    pending->firstId = firstId;
+    pending->lastId = zeroCopy->nextId - 1; // An empty range when every byte was copied : completed right away
+    pending->completed = 0;
+    if (zeroCopy->nextId == firstId) zeroCopy->numCompleted++;
+
+    if (status == 0) {
+        if (!copied) statAdd(*client->stats, framesOut, 1); // Counted by sendStream otherwise
+        if (zeroCopy->nextId != firstId) statAdd(*client->stats, zeroCopySends, 1);
+    }
+    else {
+        statAdd(*client->stats, partialSends, 1);
+    }
+    return status;
+#else
+    return sendFrame(client->socket, msg, len, client->connType, client->ipType, &client->sin, client->stats);
+#endif
+}
+
+/*
+    Parameters:
+        - Client* client : A TCP connection with compression enabled
+        - const char *msg : The message to compress
+        - uint32_t len : The length of the message
+    Output:
+        - int : 0 if the compressed message was sent or queued, -1 on error,
+                1 if compressing does not make it smaller (nothing was sent)
+    Description:
+        This function compresses a message in the connection's scratch buffer and sends it as one frame :
+        [flags | length : 4 bytes][original length : 4 bytes][dictionary id : 4 bytes, if any][LZ data]
+*/
+static int sendCompressed(Client* client, const char *msg, uint32_t len) {
+    struct NSC_Compression* compression = client->extension->compression;
+    NSC_Dictionary* dictionary = compression->dictionary;
+    uint32_t headerSize = (dictionary != NULL) ? 12 : 8;
+    if (len > NSC_FRAME_LENGTH_MASK - headerSize) return 1;
+
+    // The compressed frame must be smaller than the plain one (len + 4)
+    if (len + 4 <= headerSize + 1) {
+        statAdd(*client->stats, compressSkipped, 1);
+        return 1;
+    }
+    uint32_t capacity = len + 4 - headerSize - 1;
+    if (compression->scratchSize < headerSize + capacity) {
+        uint8_t* temp = (uint8_t*)memRealloc(client->allocator, compression->scratch, headerSize + capacity);
+        if (!temp) return 1;
+        statAdd(*client->stats, allocations, 1);
+        compression->scratch = temp;
+        compression->scratchSize = headerSize + capacity;
+    }
+
+    uint64_t start = statClock();
+    uint32_t compressedLen = lzCompress(dictionary, (const uint8_t*)msg, len, compression->scratch + headerSize, capacity);
+    statAdd(*client->stats, compressNs, nscMonotonicNs() - start);
+    if (compressedLen == 0) {
+        statAdd(*client->stats, compressSkipped, 1);
+        return 1;
+    }
+
+    uint32_t flags = NSC_FRAME_COMPRESSED | ((dictionary != NULL) ? NSC_FRAME_DICTIONARY : 0);
+    uint32_t field = htonl(flags | (headerSize - 4 + compressedLen));
+    memcpy(compression->scratch, &field, 4);
+    field = htonl(len);
+    memcpy(compression->scratch + 4, &field, 4);
+    if (dictionary != NULL) {
+        field = htonl(dictionary->id);
+        memcpy(compression->scratch + 8, &field, 4);
+    }
+
+    statAdd(*client->stats, compressedFrames, 1);
+    statAdd(*client->stats, compressInput, len);
+    statAdd(*client->stats, compressOutput, headerSize - 4 + compressedLen);
+    if (sendStream(client, (const char*)compression->scratch, headerSize + compressedLen, 1) != 0) {
+        statAdd(*client->stats, partialSends, 1);
+        return -1;
+    }
+    return 0;
+}
+
+int sendClientMessage(Client* client, const char *msg, uint32_t len) {
+    if (client->extension->reliable != NULL) return sendChannelMessage(client, 0, msg, len);
+    if (client->connType != TCP) {
+        return sendFrame(client->socket, msg, len, client->connType, client->ipType, &client->sin, client->stats);
+    }
+
+    if (client->extension->compression != NULL && client->extension->compression->threshold != 0 && len >= client->extension->compression->threshold) {
+        int status = sendCompressed(client, msg, len);
+        if (status != 1) return status; // 1 : sent as is
+    }
+
+    // Behind queued bytes the message is copied, its SendComplete event comes all the same
+    if (client->extension->zeroCopy != NULL && client->extension->zeroCopy->threshold != 0 && len >= client->extension->zeroCopy->threshold) {
+        return sendZeroCopy(client, msg, len);
+    }
+
+    uint32_t len_net = htonl(len);
+    if (sendStream(client, (const char*)&len_net, 4, 0) != 0 || sendStream(client, msg, len, 1) != 0) {
+        statAdd(*client->stats, partialSends, 1);
+        return -1;
+    }
+    return 0;
+}
+
+int sendStreamMessage(Client* client, int stream, const char *msg, uint32_t len) {
+    if (stream < 0 || stream >= NSC_MAX_STREAMS || len == 0 || len > NSC_FRAME_LENGTH_MASK) return -1;
+    struct NSC_Streams* streams = client->extension->streams;
+    if (streams == NULL || !streams->peer) return sendClientMessage(client, msg, len);
+
+    StreamMessage* message = (StreamMessage*)memAlloc(client->allocator, sizeof(StreamMessage) + len);
+    if (!message) return -1;
+    statAdd(*client->stats, allocations, 1);
+    message->next = NULL;
+    message->len = len;
+    message->sent = 0;
+    memcpy(message->data, msg, len);
+    if (streams->tail[stream] != NULL) streams->tail[stream]->next = message;
+    else streams->head[stream] = message;
+    streams->tail[stream] = message;
+    streams->queuedBytes += len;
+    return sendStreamChunks(client);
+}
+
+int sendFileMessage(Client* client, int fd, int64_t offset, uint32_t len) {
+    if (client->connType != TCP || len == 0 || len > NSC_FRAME_LENGTH_MASK || offset < 0) return -1;
+
+    // Once its header is sent the message cannot be cut : the file must hold the whole body
+    int64_t size = fileSize(fd);
+    if (size < 0 || offset + (int64_t)len > size) return -1;
+
+    int file = dupFile(fd);
+    if (file < 0) return -1;
+
+    uint32_t len_net = htonl(len);
+    if (sendStream(client, (const char*)&len_net, 4, 0) != 0) {
+        closeFile(file);
+        statAdd(*client->stats, partialSends, 1);
+        return -1;
+    }
+    if (queueSegment(client, NULL, len, file, offset, 1) != 0) {
+        closeFile(file);
+        statAdd(*client->stats, partialSends, 1);
+        return -1;
+    }
+
+    // Send what the socket can take now, the rest goes when it is writable
+    return (flushConnection(client) < 0) ? -1 : 0;
+}
+
+char* nscSendReserve(Client* client, uint32_t maxLen) {
+    if (maxLen > NSC_FRAME_LENGTH_MASK) return NULL;
+    if (client->extension->outQueue == NULL) {
+        struct NSC_ClientExtension* extension = clientExtension(client);
+        if (!extension) return NULL;
+        extension->outQueue = (struct NSC_OutQueue*)memCalloc(client->allocator, 1, sizeof(struct NSC_OutQueue));
+        if (!extension->outQueue) return NULL;
+        statAdd(*client->stats, allocations, 1);
+    }
+    struct NSC_OutQueue* queue = client->extension->outQueue;
+
+    // The frame is [length : 4 bytes][message] : the message is written right after the room of its header
+    uint32_t capacity = maxLen + 4;
+    OutSegment* segment = queue->reserved; // A reservation not committed is handed out again
+    if (segment == NULL) {
+        segment = queue->spare;
+        queue->spare = NULL;
+    }
+    if (segment != NULL && segment->capacity < capacity) {
+        memFree(client->allocator, segment);
+        segment = NULL;
+    }
+    if (segment == NULL) {
+        segment = (OutSegment*)memAlloc(client->allocator, sizeof(OutSegment) + capacity);
+        if (!segment) {
+            queue->reserved = NULL;
+            return NULL;
+        }
+        segment->capacity = capacity;
+        statAdd(*client->stats, allocations, 1);
+    }
+    queue->reserved = segment;
+    queue->reservedLen = maxLen;
+    return segment->data + 4;
+}
+
+int nscSendCommit(Client* client, uint32_t len) {
+    struct NSC_OutQueue* queue = client->extension->outQueue;
+    if (queue == NULL || queue->reserved == NULL) return -1;
+    OutSegment* segment = queue->reserved;
+    queue->reserved = NULL;
+    if (len > queue->reservedLen) {
+        keepSpareSegment(client, segment);
+        return -1;
+    }
+    const char* msg = segment->data + 4;
+
+    int status = 1;
+    if (client->extension->reliable != NULL) {
+        status = sendChannelMessage(client, 0, msg, len);
+    }
+    else if (client->connType != TCP) {
+        status = sendFrame(client->socket, msg, len, client->connType, client->ipType, &client->sin, client->stats);
+    }
+    else if (client->extension->compression != NULL && client->extension->compression->threshold != 0 && len >= client->extension->compression->threshold) {
+        status = sendCompressed(client, msg, len); // 1 : sent as is
+    }
+    if (status != 1) {
+        keepSpareSegment(client, segment);
+        return status;
+    }
+
+    // Header and message leave in one call, from the segment the caller wrote in
+    uint32_t len_net = htonl(len);
+    memcpy(segment->data, &len_net, 4);
+    uint32_t totalSent = 0;
+    if (!outQueuePending(client)) {
+        while (totalSent < len + 4) {
+            int sent = streamSend(client, segment->data + totalSent, len + 4 - totalSent);
+            statAdd(*client->stats, sendCalls, 1);
             if (sent <= 0) {
-                break;
+                if (sent < 0 && wouldBlock()) {
+                    statAdd(*client->stats, eagainHits, 1);
+                    break; // The rest is queued
+                }
+                keepSpareSegment(client, segment);
+                statAdd(*client->stats, partialSends, 1);
+                return -1;
             }
             totalSent += sent;
+            statAdd(*client->stats, bytesOut, sent);
         }
-    }
-    else if (connType == UDP && realType == SOCK_DGRAM) {
-        if (!sin) return; // NULL address
-        if (ipType == IPv4) {
-            sendto(*socket, msg, len, 0, (SOCKADDR*)&sin->in, sizeof(sin->in));
-        }
-        else if (ipType == IPv6) {
-            sendto(*socket, msg, len, 0, (SOCKADDR*)&sin->in6, sizeof(sin->in6));
+        if (totalSent == len + 4) {
+            statAdd(*client->stats, framesOut, 1);
+            keepSpareSegment(client, segment);
+            return 0;
         }
     }
-    else {
-        fprintf(stderr, "Error : connType and socket type are not matching.\n");
+
+    // The segment itself joins the queue, the rest of the frame is not copied
+    appendSegment(queue, segment, -1, totalSent, len + 4 - totalSent, 1);
+    return 0;
+}
+
+int enableCompression(Client* client, uint32_t threshold, NSC_Dictionary* dictionary) {
+    if (client->connType != TCP) return -1;
+    if (threshold == 0 && dictionary == NULL) {
+        freeCompression(client);
+        return 0;
+    }
+
+    if (client->extension->compression == NULL) {
+        struct NSC_ClientExtension* extension = clientExtension(client);
+        if (!extension) return -1;
+        extension->compression = (struct NSC_Compression*)memCalloc(client->allocator, 1, sizeof(struct NSC_Compression));
+        if (!extension->compression) return -1;
+        statAdd(*client->stats, allocations, 1);
+    }
+    client->extension->compression->threshold = threshold;
+    client->extension->compression->dictionary = dictionary;
+    return 0;
+}
+
+void setServerCompression(Server* server, uint32_t threshold, NSC_Dictionary* dictionary) {
+    server->compressionThreshold = threshold;
+    server->compressionDictionary = dictionary;
+    for (int i = 0; i < server->numClients; i++) {
+        enableCompression(&server->clients[i], threshold, dictionary);
+    }
+}
+
+uint64_t getQueuedBytes(Client* client) {
+    uint64_t streamed = (client->extension->streams != NULL) ? client->extension->streams->queuedBytes : 0;
+    return ((client->extension->outQueue != NULL) ? client->extension->outQueue->queuedBytes : 0) + streamed;
+}
+
+NSC_Stats getServerStats(Server* server) {
+    NSC_Stats total = server->stats;
+    for (int i = 0; i < server->numClients; i++) {
+        addStats(&total, server->clients[i].stats);
     }
+    return total;
+}
+
+NSC_Stats getClientStats(Client* client) {
+    return *client->stats;
 }
 
 char* resolveDomainName(const char* domainName) {
@@ -684,7 +6034,7 @@ char* resolveDomainName(const char* domainName) {
             return NULL;
         }
 
-        ipstr = malloc(strlen(buf) + 1);
+        ipstr = memAlloc(&globalAllocator, strlen(buf) + 1);
         if (ipstr == NULL) {
             fprintf(stderr, "Memory allocation failed\n");
             freeaddrinfo(res);
@@ -697,4 +6047,358 @@ char* resolveDomainName(const char* domainName) {
 
     freeaddrinfo(res);
     return ipstr;
-}
\ No newline at end of file
+}
+
+void nscSetAllocator(const NSC_Allocator* allocator) {
+    if (allocator == NULL) {
+        globalAllocator.allocate = stdAllocate;
+        globalAllocator.reallocate = stdReallocate;
+        globalAllocator.release = stdRelease;
+        globalAllocator.context = NULL;
+    }
+    else {
+        globalAllocator = *allocator;
+    }
+}
+
+void nscFree(void* memory) {
+    memFree(&globalAllocator, memory);
+}
+
+void nscTraceEnable(int enabled) {
+    traceEnabled = enabled;
+}
+
+void nscTraceHandled(const NSC_EventTrace* trace) {
+    if (trace->delivered == 0) return; // Not traced
+    traceRecord(StageHandler, trace->delivered, nscMonotonicNs());
+}
+
+void nscGetTraceHistograms(NSC_TraceHistogram* histograms, int reset) {
+    for (int stage = 0; stage < StageCount; stage++) {
+        NSC_TraceHistogram* histogram = &traceHistograms[stage];
+        if (reset) {
+            histograms[stage].count = atomicExchange64(&histogram->count, 0);
+            histograms[stage].sumNs = atomicExchange64(&histogram->sumNs, 0);
+            histograms[stage].maxNs = atomicExchange64(&histogram->maxNs, 0);
+            for (int i = 0; i < NSC_TRACE_BUCKETS; i++) {
+                histograms[stage].buckets[i] = atomicExchange64(&histogram->buckets[i], 0);
+            }
+        }
+        else {
+            histograms[stage].count = atomicLoad64(&histogram->count);
+            histograms[stage].sumNs = atomicLoad64(&histogram->sumNs);
+            histograms[stage].maxNs = atomicLoad64(&histogram->maxNs);
+            for (int i = 0; i < NSC_TRACE_BUCKETS; i++) {
+                histograms[stage].buckets[i] = atomicLoad64(&histogram->buckets[i]);
+            }
+        }
+    }
+}
+
+void nscSetTraceHook(void (*hook)(const NSC_EventTrace* trace, int fromServer, void* context), void* context) {
+    traceHookContext = context;
+    traceHook = hook;
+}
+
+int enableZeroCopy(Client* client, uint32_t threshold) {
+#if defined (__linux__)
+    if (client->extension->zeroCopy == NULL) {
+        if (threshold == 0) return 0;
+        if (client->connType != TCP || client->extension->ring != NULL) return -1;
+
+        int enabled = 1;
+        if (setsockopt(client->socket, SOL_SOCKET, SO_ZEROCOPY, &enabled, sizeof(enabled)) != 0) return -1;
+
+        struct NSC_ClientExtension* extension = clientExtension(client);
+        if (!extension) return -1;
+        extension->zeroCopy = (struct NSC_ZeroCopy*)memCalloc(client->allocator, 1, sizeof(struct NSC_ZeroCopy));
+        if (!extension->zeroCopy) return -1;
+        statAdd(*client->stats, allocations, 1);
+    }
+    // Disabling keeps the state : the pending messages are still reported
+    client->extension->zeroCopy->threshold = threshold;
+    return 0;
+#else
+    return (threshold == 0) ? 0 : -1;
+#endif
+}
+
+void setServerZeroCopy(Server* server, uint32_t threshold) {
+    server->zeroCopyThreshold = threshold;
+    for (int i = 0; i < server->numClients; i++) {
+        enableZeroCopy(&server->clients[i], threshold);
+    }
+}
+
+// Number of buckets of the RPC calls' table (ids are sequential, id % buckets spreads them evenly)
+#define RPC_BUCKETS 256
+
+// A pending RPC call
+typedef struct NSC_RpcCall {
+    NSC_Timer timer; // Deadline of the call (first member : the timer's address is the call's)
+    struct NSC_RpcCall* next; // Next call of the bucket
+    uint32_t id;
+    NSC_RpcCallback callback; // NULL for a call completed with nscRpcWait
+    void* context;
+    int done; // 1 once a call without callback completed
+    int status;
+    char* response;
+    uint32_t responseLen;
+} NSC_RpcCall;
+
+// RPC channel over a client's connection
+struct NSC_Rpc {
+    Client* client;
+    uint32_t nextId;
+    uint32_t inFlight; // Calls sent and not completed
+    int closed; // 1 once the connection was closed
+    int completed; // Calls completed during the current nscRpcPoll
+    NSC_RpcCall* buckets[RPC_BUCKETS];
+    NSC_TimerWheel timers; // Deadlines of the calls
+    NSC_Timer expired; // Head of the list of calls whose deadline expired
+    char* scratch; // Buffer of the requests' messages
+    uint32_t scratchSize;
+};
+
+// Find a pending call, removing it from its bucket if remove is 1
+static NSC_RpcCall* rpcFind(NSC_Rpc* rpc, uint32_t id, int remove) {
+    NSC_RpcCall** link = &rpc->buckets[id % RPC_BUCKETS];
+    while (*link != NULL) {
+        NSC_RpcCall* call = *link;
+        if (call->id == id) {
+            if (remove) *link = call->next;
+            return call;
+        }
+        link = &call->next;
+    }
+    return NULL;
+}
+
+// Callback of the calls' deadlines : the call is completed by nscRpcPoll, out of the wheel's advance
+static void rpcDeadline(NSC_Timer* timer, void* context) {
+    NSC_Rpc* rpc = (NSC_Rpc*)context;
+    timerLink(&rpc->expired, timer);
+}
+
+/*
+    Parameters:
+        - NSC_Rpc* rpc : The RPC channel
+        - NSC_RpcCall* call : A pending call
+        - int status : The result of the call
+        - const char* response : The response (RPC_OK only)
+        - uint32_t len : The length of the response
+    Description:
+        This function completes a call : its callback is called and the call freed,
+        or the result is kept for nscRpcWait.
+*/
+static void rpcComplete(NSC_Rpc* rpc, NSC_RpcCall* call, int status, const char* response, uint32_t len) {
+    if (call->timer.next != NULL) timerUnlink(&call->timer);
+    rpc->inFlight--;
+    rpc->completed++;
+
+    if (call->callback != NULL) {
+        rpcFind(rpc, call->id, 1);
+        call->callback(call->id, status, response, len, call->context);
+        memFree(rpc->client->allocator, call);
+        return;
+    }
+
+    call->done = 1;
+    call->status = status;
+    call->response = NULL;
+    call->responseLen = 0;
+    if (status == RPC_OK) {
+        call->response = (char*)memAlloc(rpc->client->allocator, len + 1);
+        if (call->response != NULL) {
+            memcpy(call->response, response, len);
+            call->response[len] = '\0';
+            call->responseLen = len;
+        }
+    }
+}
+
+// Complete every pending call with a status (connection closed or channel destroyed)
+static void rpcFailAll(NSC_Rpc* rpc, int status) {
+    for (int i = 0; i < RPC_BUCKETS; i++) {
+        NSC_RpcCall* call = rpc->buckets[i];
+        while (call != NULL) {
+            NSC_RpcCall* next = call->next;
+            if (!call->done) rpcComplete(rpc, call, status, NULL, 0);
+            call = next;
+        }
+    }
+}
+
+NSC_Rpc* nscRpcCreate(Client* client) {
+    if (client->connType != TCP) return NULL;
+
+    NSC_Rpc* rpc = (NSC_Rpc*)memCalloc(client->allocator, 1, sizeof(NSC_Rpc));
+    if (!rpc) return NULL;
+    statAdd(*client->stats, allocations, 1);
+
+    rpc->client = client;
+    nscTimerWheelInit(&rpc->timers);
+    rpc->expired.next = rpc->expired.prev = &rpc->expired;
+    return rpc;
+}
+
+void nscRpcDestroy(NSC_Rpc* rpc) {
+    rpcFailAll(rpc, RPC_CLOSED);
+
+    // Results never waited for
+    for (int i = 0; i < RPC_BUCKETS; i++) {
+        NSC_RpcCall* call = rpc->buckets[i];
+        while (call != NULL) {
+            NSC_RpcCall* next = call->next;
+            memFree(rpc->client->allocator, call->response);
+            memFree(rpc->client->allocator, call);
+            call = next;
+        }
+    }
+    memFree(rpc->client->allocator, rpc->scratch);
+    memFree(rpc->client->allocator, rpc);
+}
+
+uint32_t nscRpcCall(NSC_Rpc* rpc, const char* request, uint32_t len, uint32_t timeoutMs, NSC_RpcCallback callback, void* context) {
+    if (rpc->closed || len > NSC_FRAME_LENGTH_MASK - NSC_RPC_HEADER) return 0;
+
+    NSC_RpcCall* call = (NSC_RpcCall*)memCalloc(rpc->client->allocator, 1, sizeof(NSC_RpcCall));
+    if (!call) return 0;
+    statAdd(*rpc->client->stats, allocations, 1);
+
+    // Build the message : [NSC_RPC_REQUEST][id][request]
+    if (rpc->scratchSize < len + NSC_RPC_HEADER) {
+        char* temp = (char*)memRealloc(rpc->client->allocator, rpc->scratch, len + NSC_RPC_HEADER);
+        if (!temp) {
+            memFree(rpc->client->allocator, call);
+            return 0;
+        }
+        statAdd(*rpc->client->stats, allocations, 1);
+        rpc->scratch = temp;
+        rpc->scratchSize = len + NSC_RPC_HEADER;
+    }
+    if (++rpc->nextId == 0) rpc->nextId = 1; // 0 is the error value
+    uint32_t idNet = htonl(rpc->nextId);
+    rpc->scratch[0] = NSC_RPC_REQUEST;
+    memcpy(rpc->scratch + 1, &idNet, 4);
+    memcpy(rpc->scratch + NSC_RPC_HEADER, request, len);
+
+    if (sendClientMessage(rpc->client, rpc->scratch, len + NSC_RPC_HEADER) != 0) {
+        memFree(rpc->client->allocator, call);
+        return 0;
+    }
+
+    call->id = rpc->nextId;
+    call->callback = callback;
+    call->context = context;
+    call->next = rpc->buckets[call->id % RPC_BUCKETS];
+    rpc->buckets[call->id % RPC_BUCKETS] = call;
+    rpc->inFlight++;
+
+    nscTimerInit(&call->timer, rpcDeadline, rpc);
+    if (timeoutMs != 0) nscTimerSchedule(&rpc->timers, &call->timer, timeoutMs);
+    return call->id;
+}
+
+int nscRpcPoll(NSC_Rpc* rpc, int timeoutMs) {
+    Client* client = rpc->client;
+    if (rpc->closed) return RPC_CLOSED;
+    rpc->completed = 0;
+
+    // Wait for the responses, not past the next deadline
+    struct pollfd pollEntry;
+    pollEntry.fd = client->socket;
+    pollEntry.events = outQueuePending(client) ? (POLLIN | POLLOUT) : POLLIN;
+    pollEntry.revents = 0;
+    int numReady = pollSockets(&pollEntry, 1, nscTimerWheelNextTimeout(&rpc->timers, timeoutMs));
+    statAdd(*client->stats, pollCalls, 1);
+
+    if (numReady > 0 && (pollEntry.revents & POLLOUT)) flushConnection(client);
+    if (numReady > 0 && (pollEntry.revents & POLLERR) && (client->timestamping & NSC_TIMESTAMP_TX)) {
+        readErrorQueue(client); // The send timestamps of an RPC channel are not reported
+        freeSendTimestamps(client);
+    }
+    if (numReady > 0 && (pollEntry.revents & (POLLIN | POLLERR | POLLHUP))) {
+        while (1) {
+            char* message = NULL;
+            int len = readMessage(client, &message);
+            if (len == READMSG_NO_DATA) break;
+            if (len == READMSG_MSG_TOO_LARGE) continue;
+            if (len < 0) {
+                // Connection closed or broken : every pending call fails
+                rpc->closed = 1;
+                rpcFailAll(rpc, RPC_CLOSED);
+                break;
+            }
+
+            if (len >= NSC_RPC_HEADER && message[0] == NSC_RPC_RESPONSE) {
+                uint32_t id;
+                memcpy(&id, message + 1, 4);
+                NSC_RpcCall* call = rpcFind(rpc, ntohl(id), 0);
+                // A response after the deadline finds no call (callback), or a call already completed and kept until nscRpcWait
+                if (call != NULL && !call->done) rpcComplete(rpc, call, RPC_OK, message + NSC_RPC_HEADER, len - NSC_RPC_HEADER);
+            }
+            memFree(rpc->client->allocator, message); // The other messages are dropped : the connection carries RPC traffic only
+        }
+    }
+
+    // Expire the calls past their deadline
+    nscTimerWheelAdvance(&rpc->timers);
+    while (rpc->expired.next != &rpc->expired) {
+        NSC_RpcCall* call = (NSC_RpcCall*)rpc->expired.next;
+        rpcComplete(rpc, call, RPC_TIMEOUT, NULL, 0);
+    }
+
+    return rpc->closed ? RPC_CLOSED : rpc->completed;
+}
+
+int nscRpcWait(NSC_Rpc* rpc, uint32_t id, char** response, uint32_t* len) {
+    *response = NULL;
+    *len = 0;
+    NSC_RpcCall* call = rpcFind(rpc, id, 0);
+    if (call == NULL || call->callback != NULL) return RPC_UNKNOWN;
+
+    while (!call->done) {
+        nscRpcPoll(rpc, 10);
+    }
+
+    int status = call->status;
+    *response = call->response;
+    *len = call->responseLen;
+    rpcFind(rpc, id, 1);
+    memFree(rpc->client->allocator, call);
+    return status;
+}
+
+uint32_t nscRpcInFlight(NSC_Rpc* rpc) {
+    return rpc->inFlight;
+}
+
+int nscRpcParseRequest(const char* data, uint32_t len, uint32_t* id, const char** payload, uint32_t* payloadLen) {
+    if (len < NSC_RPC_HEADER || data[0] != NSC_RPC_REQUEST) return -1;
+    memcpy(id, data + 1, 4);
+    *id = ntohl(*id);
+    *payload = data + NSC_RPC_HEADER;
+    *payloadLen = len - NSC_RPC_HEADER;
+    return 0;
+}
+
+int nscRpcRespond(Client* connection, uint32_t id, const char* response, uint32_t len) {
+    if (len > NSC_FRAME_LENGTH_MASK - NSC_RPC_HEADER) return -1;
+
+    // Small responses are built on the stack
+    char local[512];
+    char* message = (len + NSC_RPC_HEADER <= sizeof(local)) ? local : (char*)memAlloc(connection->allocator, len + NSC_RPC_HEADER);
+    if (!message) return -1;
+    if (message != local) statAdd(*connection->stats, allocations, 1);
+
+    uint32_t idNet = htonl(id);
+    message[0] = NSC_RPC_RESPONSE;
+    memcpy(message + 1, &idNet, 4);
+    memcpy(message + NSC_RPC_HEADER, response, len);
+
+    int status = sendClientMessage(connection, message, len + NSC_RPC_HEADER);
+    if (message != local) memFree(connection->allocator, message);
+    return status;
+}